@@ -12,33 +12,13 @@
 #define _BMX280_H
 
 #include "main.h"
+#include "bmx280_comp.h"
 
 #ifdef __cplusplus
  extern "C" {
 #endif
 
 
-typedef struct {
-  uint8_t   ID;
-  uint16_t  T1;
-  int16_t   T2;
-  int16_t   T3;
-  uint16_t  P1;
-  int16_t   P2;
-  int16_t   P3;
-  int16_t   P4;
-  int16_t   P5;
-  int16_t   P6;
-  int16_t   P7;
-  int16_t   P8;
-  int16_t   P9;
-  uint8_t   H1;
-  int16_t   H2;
-  uint8_t   H3;
-  uint8_t   Lock;	
-} bmx280_t;
-
-
 /* Private defines -----------------------------------------------------------*/
 /* BMx280 registers */
 #define SensorID              0xd0
@@ -65,24 +45,62 @@ typedef struct {
 #define SleepMode             0x00
 #define ForceMode             0x01
 #define NormalMode            0x03
+/* Oversampling after reset, register codes: 0 - skipped, 1 - x1, 2 - x2, 3 - x4,
+   4 - x8, 5 - x16. BMP280_SetOversampling() changes it at run time */
+#define TemperatureOvs        1
+#define PressureOvs           1
+#define OvsMax                5
+#define OvsCount(code)        ((code) ? (1 << ((code) - 1)) : 0)
+#define CtrlMeasWord(t, p, mode) ((uint8_t)(((t) << TemperatureOvs_Pos) | ((p) << PressureOvs_Pos) | ((mode) << Mode_Pos)))
+/* Typical measurement time by datasheet, us */
+#define MeasureTime_us(t, p)  (1000 + (2000 * OvsCount(t)) + ((p) ? ((2000 * OvsCount(p)) + 500) : 0))
+#define StatusPoll_us         100
+/* A conversion that runs longer than that is given up, us */
+#define MeasureTimeout(time)  (2 * (time))
+/* Start-up time after a soft reset, ms */
+#define ResetTime_ms          2
+/* Definitions for Config register */
+#define StandbyMask           0xe0
+#define Standby_Pos           5
+#define FilterMask            0x1c
+#define Filter_Pos            2
+#define Spi3wMask             0x01
+#define Spi3w_Pos             0
+/* Control registers shadowed by the driver, CtrlHumidity..ConfigSensor */
+#define ShadowBase            CtrlHumidity
+#define ShadowLen             4
 /* Some other definitions */
 #define WriteMask             0x7f
 #define ResetValue            0xb6
 #define BMP280_ID             0x58
 #define BME280_ID             0x60
-/* Types demanded by BMx280 datasheet */
-typedef int32_t               BMP280_S32_t;
-typedef uint32_t              BMP280_U32_t;
+
+
+/* Exported types ------------------------------------------------------------*/
+typedef enum {
+  BMX280_OK       = 0,
+  BMX280_ERR_BUS  = 1,      // An SPI wait timed out
+  BMX280_ERR_CONV = 2,      // The conversion didn't end in MeasureTimeout()
+  BMX280_ERR_ID   = 3       // No BMP280 or BME280 answers
+} BMX280_Status_TypeDef;
 
 
 extern bmx280_t bmx280;
 
 /* Exported functions prototypes ---------------------------------------------*/
 uint8_t BMP280_Init(void);
+uint8_t BMP280_Recover(void);
+BMX280_Status_TypeDef BMP280_LastError(void);
+BMX280_Status_TypeDef BMP280_Measure(void);
 BMP280_S32_t* BMP280_ReadT(void);
 BMP280_U32_t* BMP280_ReadP(void);
-double* BMP280_ReadTP(void);
-double* BMP280_ReadPP(void);
+#ifdef BMX280_PRECISE
+  double* BMP280_ReadTP(void);
+  double* BMP280_ReadPP(void);
+#endif /* BMX280_PRECISE */
+uint8_t BMP280_SetOversampling(uint8_t temperatureOvs, uint8_t pressureOvs);
+uint32_t BMP280_MeasureTime(void);
+const bmx280_t* BMP280_Calibration(void);
 
 
 #ifdef __cplusplus
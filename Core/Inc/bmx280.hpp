@@ -0,0 +1,445 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280.hpp
+  * Description        : Header-only C++ driver of the BMx280 Bosch family.
+  *                      The sensor variant, the bus, the chip select pin
+  *                      and the compensation kernels are template
+  *                      parameters, so the code of the other variants
+  *                      isn't compiled in. It works as bmp280.c does:
+  *                      shadowed control registers, bounded waits, the
+  *                      recovery of a failed sample and the publication by
+  *                      Sample_Publish(). The register words come from
+  *                      the Settings of bmx280_regs.hpp, built at compile
+  *                      time. bmx280_cpp.cpp instantiates it for the
+  *                      board and gives bmx280.h functions to C.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BMX280_HPP
+#define __BMX280_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "bmx280_regs.hpp"
+
+namespace bmx {
+
+/* Sensor variants -----------------------------------------------------------*/
+/* BMP280, the control registers from ctrl_meas on */
+struct Bmp280 {
+  static constexpr uint8_t Id = BMP280_ID;
+  static constexpr bool Humidity = false;
+};
+
+/* BME280, ctrl_hum has to be written before ctrl_meas */
+struct Bme280 {
+  static constexpr uint8_t Id = BME280_ID;
+  static constexpr bool Humidity = true;
+};
+
+
+
+/* Compensation policies -----------------------------------------------------*/
+/* The integer kernels of bmx280_comp.c, 32-bit arithmetic only */
+struct CompInt32 {
+  static BMP280_S32_t Temperature(const bmx280_t &cal, BMP280_S32_t adc, BMP280_S32_t &tFine) {
+    return (bmp280_compensate_T_int32(&cal, adc, &tFine));
+  }
+  static BMP280_U32_t Pressure(const bmx280_t &cal, BMP280_S32_t adc, BMP280_S32_t tFine) {
+    return (bmp280_compensate_P_int32(&cal, adc, tFine));
+  }
+};
+
+/* The 64-bit pressure kernel of bmx280_comp.c, Q24.8 rounded to Pa. The
+   M0 multiplies 64-bit values by a libgcc call, it's slower and larger */
+struct CompInt64 {
+  static BMP280_S32_t Temperature(const bmx280_t &cal, BMP280_S32_t adc, BMP280_S32_t &tFine) {
+    return (bmp280_compensate_T_int32(&cal, adc, &tFine));
+  }
+  static BMP280_U32_t Pressure(const bmx280_t &cal, BMP280_S32_t adc, BMP280_S32_t tFine) {
+    return ((bmp280_compensate_P_int64(&cal, adc, tFine) + 128) >> 8);
+  }
+};
+
+
+
+/* Chip select ---------------------------------------------------------------*/
+/* GPIO output, the port by its base address, the pin by its mask */
+template <uint32_t PortBase, uint16_t Pin>
+struct ChipSelect {
+  static GPIO_TypeDef* Port(void) {
+    return (reinterpret_cast<GPIO_TypeDef*>(PortBase));
+  }
+  /* SPI1_Init() sets the board NSS pin up, others are set up here */
+  static void Init(void) {
+    if constexpr ((PortBase != GPIOA_BASE) || (Pin != NSS_0_Pin)) {
+      SET_BIT(RCC->AHBENR, RCC_AHBENR_GPIOAEN << ((PortBase - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE)));
+      Port()->MODER |= (_PU << (__builtin_ctz(Pin) * 2U));
+      Release();
+    }
+  }
+  static void Select(void) {
+    PIN_L(Port(), Pin);
+  }
+  static void Release(void) {
+    PIN_H(Port(), Pin);
+  }
+  static uint32_t Level(void) {
+    return (PIN_LEVEL(Port(), Pin));
+  }
+};
+
+
+
+/* Bus -----------------------------------------------------------------------*/
+/* SPI1 as spi.c sets it up, any chip select. Transactions are traced,
+   profiled and captured as SPI_Read()/SPI_Write() do it */
+struct Spi1Bus {
+  /**
+    * @brief  Resets SPI1 after a timed out transfer.
+    */
+  template <class Cs>
+  static void Recover(void) {
+    Cs::Release();
+    SPI1_Recover();
+  }
+
+  /**
+    * @brief  Reads cnt bytes after the command byte in buf[0], into buf.
+    * @retval SPI_OK or the wait that timed out, the chip select is
+    *         released anyway.
+    */
+  template <class Cs>
+  static SPI_Status_TypeDef Read(uint8_t *buf, uint8_t cnt) {
+    SPI_Status_TypeDef status;
+    uint8_t dummy;
+
+    PROF_ENTER(PROF_SPI_READ);
+    TRACE(TRACE_SPI_BEGIN, cnt, buf[0]);
+    #ifdef SPI_CAPTURE
+      uint8_t *data = buf;
+      uint8_t cmd = buf[0];
+      uint8_t len = cnt;
+      uint32_t time = (uint32_t)Clock_Micros();
+    #endif /* SPI_CAPTURE */
+    status = Select<Cs>();
+    if (status == SPI_OK) {
+      status = Transfer(buf[0], &dummy);
+    }
+    while ((status == SPI_OK) && cnt--) {
+      status = Transfer(0, buf++);
+    }
+    Cs::Release();
+    TRACE(TRACE_SPI_END, cnt, status);
+    #ifdef SPI_CAPTURE
+      SPI_Capture(SPI_CAPTURE_READ, cmd, data, len, time);
+    #endif /* SPI_CAPTURE */
+    PROF_EXIT(PROF_SPI_READ);
+    return (status);
+  }
+
+  /**
+    * @brief  Writes cnt bytes of buf.
+    * @retval SPI_OK or the wait that timed out, the chip select is
+    *         released anyway.
+    */
+  template <class Cs>
+  static SPI_Status_TypeDef Write(const uint8_t *buf, uint8_t cnt) {
+    SPI_Status_TypeDef status;
+    uint8_t dummy;
+
+    PROF_ENTER(PROF_SPI_WRITE);
+    TRACE(TRACE_SPI_BEGIN, cnt, buf[0]);
+    #ifdef SPI_CAPTURE
+      if (cnt) SPI_Capture(SPI_CAPTURE_WRITE, buf[0], buf + 1, cnt - 1, (uint32_t)Clock_Micros());
+    #endif /* SPI_CAPTURE */
+    status = Select<Cs>();
+    while ((status == SPI_OK) && cnt--) {
+      status = Transfer(*buf++, &dummy);
+    }
+    Cs::Release();
+    TRACE(TRACE_SPI_END, cnt, status);
+    PROF_EXIT(PROF_SPI_WRITE);
+    return (status);
+  }
+
+private:
+  template <class Cs>
+  static SPI_Status_TypeDef Select(void) {
+    uint8_t ok = 1;
+
+    Cs::Select();
+    BUSY_WAIT_TIMEOUT(WAIT_SPI_NSS, Cs::Level(), SPI_NSS_TIMEOUT_US, ok);
+    return (ok ? SPI_OK : SPI_ERR_NSS);
+  }
+
+  static SPI_Status_TypeDef Transfer(uint8_t out, uint8_t *in) {
+    uint8_t ok = 1;
+
+    SPI_DR_WRITE(SPI1, out);
+    BUSY_WAIT_TIMEOUT(WAIT_SPI_TXE, !(READ_BIT(SPI1->SR, SPI_SR_TXE)), SPI_TIMEOUT_US, ok);
+    if (!ok) {
+      return (SPI_ERR_TXE);
+    }
+    BUSY_WAIT_TIMEOUT(WAIT_SPI_RXNE, !(READ_BIT(SPI1->SR, SPI_SR_RXNE)), SPI_TIMEOUT_US, ok);
+    if (!ok) {
+      return (SPI_ERR_RXNE);
+    }
+    *in = SPI_DR_READ(SPI1);
+    return (SPI_OK);
+  }
+};
+
+
+
+/* Driver --------------------------------------------------------------------*/
+/* All state is static, an instantiation is one sensor */
+template <class Bus, class Cs, class Variant, class Comp = CompInt32,
+          class Settings = reg::Settings<Variant, reg::Ovs(TemperatureOvs), reg::Ovs(PressureOvs)>>
+class Bmx280 {
+  static_assert(Settings::Meas.mode == reg::Mode::Forced, "the driver triggers forced conversions");
+
+public:
+  /**
+    * @brief  Takes the identity, calibration and control registers.
+    * @retval uint8_t 1 when the sensor of the variant answers
+    */
+  static uint8_t Init(void) {
+    shadowValid = 0;
+    writeLen = 0;
+    Cs::Init();
+
+    /* Get family ID of a sensor */
+    uint8_t id = SensorID;
+    if (Bus::template Read<Cs>(&id, 1) != SPI_OK) {
+      return (Fail(BMX280_ERR_BUS));
+    }
+    cal.ID = id;
+    Delay(1);
+    if (id != Variant::Id) {
+      return (Fail(BMX280_ERR_ID));
+    }
+
+    /* Get calibration data, little endian T1..P9 */
+    uint8_t calib[26];
+    calib[0] = Calib1;
+    if (Bus::template Read<Cs>(calib, sizeof(calib)) != SPI_OK) {
+      return (Fail(BMX280_ERR_BUS));
+    }
+    Delay(1);
+    cal.T1 = Word(calib, 0);
+    cal.T2 = (int16_t)Word(calib, 1);
+    cal.T3 = (int16_t)Word(calib, 2);
+    cal.P1 = Word(calib, 3);
+    cal.P2 = (int16_t)Word(calib, 4);
+    cal.P3 = (int16_t)Word(calib, 5);
+    cal.P4 = (int16_t)Word(calib, 6);
+    cal.P5 = (int16_t)Word(calib, 7);
+    cal.P6 = (int16_t)Word(calib, 8);
+    cal.P7 = (int16_t)Word(calib, 9);
+    cal.P8 = (int16_t)Word(calib, 10);
+    cal.P9 = (int16_t)Word(calib, 11);
+
+    /* Load the shadow, the sensor keeps its registers over an MCU reset */
+    uint8_t ctrl[ShadowLen];
+    ctrl[0] = ShadowBase;
+    if (Bus::template Read<Cs>(ctrl, ShadowLen) == SPI_OK) {
+      for (uint8_t i = 0; i < ShadowLen; i++) {
+        shadow[i] = ctrl[i];
+      }
+      shadowValid = 1;
+    }
+
+    /* Filter, standby and humidity as the settings have them */
+    if constexpr (Variant::Humidity) {
+      Write(CtrlHumidity, Settings::Hum.Word());
+    }
+    Write(ConfigSensor, Settings::Conf.Word());
+    if (!shadowValid || (Commit() != SPI_OK)) {
+      return (Fail(BMX280_ERR_BUS));
+    }
+
+    lastError = BMX280_OK;
+    return (1);
+  }
+
+  /**
+    * @brief  Resets the bus and the sensor by its soft reset and runs Init().
+    * @retval uint8_t 1 when the sensor is back
+    */
+  static uint8_t Recover(void) {
+    const uint8_t reset[2] = { ReserSensor & WriteMask, ResetValue };
+
+    Bus::template Recover<Cs>();
+    if (Bus::template Write<Cs>(reset, 2) != SPI_OK) {
+      return (Fail(BMX280_ERR_BUS));
+    }
+    Delay(ResetTime_ms);
+    return (Init());
+  }
+
+  /**
+    * @brief  Takes a sample, compensates and publishes it, see
+    *         BMP280_Measure().
+    * @retval BMX280_OK or the error of the sample
+    */
+  static BMX280_Status_TypeDef Measure(void) {
+    Sample_TypeDef sample;
+    BMP280_S32_t tFine;
+    BMX280_Status_TypeDef status = Read();
+
+    if (status != BMX280_OK) {
+      TRACE(TRACE_SENSOR_RESET, 0, status);
+      if (Recover()) {
+        status = Read();
+      }
+    }
+    lastError = status;
+    if (status != BMX280_OK) {
+      return (status);
+    }
+
+    BMP280_S32_t adcP = ((data[0] << 16) | (data[1] << 8) | data[2]) >> 4;
+    BMP280_S32_t adcT = ((data[3] << 16) | (data[4] << 8) | data[5]) >> 4;
+
+    PROF_ENTER(PROF_COMPENSATE_T);
+    sample.temperature = Comp::Temperature(cal, adcT, tFine);
+    PROF_EXIT(PROF_COMPENSATE_T);
+    PROF_ENTER(PROF_COMPENSATE_P);
+    sample.pressure = Comp::Pressure(cal, adcP, tFine);
+    PROF_EXIT(PROF_COMPENSATE_P);
+    sample.time = (uint32_t)Clock_Millis();
+
+    Sample_Publish(&sample);
+    return (BMX280_OK);
+  }
+
+  static BMX280_Status_TypeDef LastError(void) {
+    return (lastError);
+  }
+
+  /**
+    * @brief  Replaces the oversampling of the settings, the ctrl_meas word
+    *         and the measurement time are computed here once.
+    * @retval uint8_t 1 when the codes were taken
+    */
+  static uint8_t SetOversampling(uint8_t temperatureOvs, uint8_t pressureOvs) {
+    const reg::CtrlMeas meas = { reg::Ovs(temperatureOvs), reg::Ovs(pressureOvs), reg::Mode::Forced };
+
+    if (!meas.Valid()) {
+      return (0);
+    }
+    measWord = meas.Word();
+    measTime = meas.Typical_us(Settings::Hum.humidity);
+    return (1);
+  }
+
+  static uint32_t MeasureTime(void) {
+    return (measTime);
+  }
+
+  static const bmx280_t& Calibration(void) {
+    return (cal);
+  }
+
+private:
+  static inline bmx280_t cal;
+  static inline uint8_t data[6];
+  static inline uint8_t measWord = Settings::Meas.Word();
+  static inline uint32_t measTime = Settings::Measure_us;
+  static inline uint8_t shadow[ShadowLen];
+  static inline uint8_t shadowValid = 0;
+  static inline uint8_t writeBuf[2 * ShadowLen];
+  static inline uint8_t writeLen = 0;
+  static inline BMX280_Status_TypeDef lastError = BMX280_OK;
+
+  static uint16_t Word(const uint8_t *buf, uint8_t index) {
+    return ((uint16_t)(buf[2 * index] | (buf[(2 * index) + 1] << 8)));
+  }
+
+  static uint8_t Fail(BMX280_Status_TypeDef error) {
+    lastError = error;
+    return (0);
+  }
+
+  /**
+    * @brief  Triggers a forced conversion, sleeps through its typical time,
+    *         polls the rest and reads pressure and temperature.
+    * @retval BMX280_OK, BMX280_ERR_BUS or BMX280_ERR_CONV
+    */
+  static BMX280_Status_TypeDef Read(void) {
+    BMX280_Status_TypeDef status = BMX280_OK;
+    SPI_Status_TypeDef bus;
+
+    PROF_ENTER(PROF_BMP280_READ);
+    Write(CtrlMeasure, measWord);
+    bus = Commit();
+
+    TRACE(TRACE_CONV_START, 0, 0);
+
+    WAIT_BEGIN(WAIT_BMP280_MEASURE);
+    if (bus == SPI_OK) {
+      uint32_t waited = measTime;
+      Delay_us(waited);
+      data[0] = StatusSensor;
+      bus = Bus::template Read<Cs>(data, 1);
+      while ((bus == SPI_OK) && reg::Status::IsMeasuring(data[0])) {
+        if (waited >= MeasureTimeout(measTime)) {
+          status = BMX280_ERR_CONV;
+          break;
+        }
+        Delay_us(StatusPoll_us);
+        waited += StatusPoll_us;
+        data[0] = StatusSensor;
+        bus = Bus::template Read<Cs>(data, 1);
+      }
+    }
+    WAIT_END(WAIT_BMP280_MEASURE);
+    shadow[CtrlMeasure - ShadowBase] &= ~reg::CtrlMeas::Mode::Mask;
+
+    if ((bus == SPI_OK) && (status == BMX280_OK)) {
+      data[0] = CollectData;
+      bus = Bus::template Read<Cs>(data, 6);
+    }
+    if (bus != SPI_OK) {
+      status = BMX280_ERR_BUS;
+    }
+    TRACE(TRACE_SAMPLE_READY, 0, status);
+
+    PROF_EXIT(PROF_BMP280_READ);
+    return (status);
+  }
+
+  /* Queues a control register write unless the shadow holds the value */
+  static void Write(uint8_t cmd, uint8_t value) {
+    uint8_t *reg = &shadow[cmd - ShadowBase];
+
+    if (shadowValid && (*reg == value)) {
+      return;
+    }
+    writeBuf[writeLen++] = cmd & WriteMask;
+    writeBuf[writeLen++] = value;
+    *reg = value;
+  }
+
+  /* Sends the queued writes in one transaction */
+  static SPI_Status_TypeDef Commit(void) {
+    SPI_Status_TypeDef status = SPI_OK;
+
+    if (writeLen) {
+      status = Bus::template Write<Cs>(writeBuf, writeLen);
+      writeLen = 0;
+    }
+    if (status != SPI_OK) {
+      shadowValid = 0;
+    }
+    return (status);
+  }
+};
+
+} /* namespace bmx */
+
+#endif /* __BMX280_HPP */
@@ -0,0 +1,70 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_comp.h
+  * Description        : This file provides the BMx280 calibration data and
+  *                      the Bosch compensation formulas. It's shared with
+  *                      the host tools, so it doesn't depend on the device
+  *                      headers.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BMX280_COMP_H
+#define __BMX280_COMP_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+
+typedef struct {
+  uint8_t   ID;
+  uint16_t  T1;
+  int16_t   T2;
+  int16_t   T3;
+  uint16_t  P1;
+  int16_t   P2;
+  int16_t   P3;
+  int16_t   P4;
+  int16_t   P5;
+  int16_t   P6;
+  int16_t   P7;
+  int16_t   P8;
+  int16_t   P9;
+  uint8_t   H1;
+  int16_t   H2;
+  uint8_t   H3;
+  uint8_t   Lock;
+} bmx280_t;
+
+
+/* Private defines -----------------------------------------------------------*/
+/* Types demanded by BMx280 datasheet */
+typedef int32_t               BMP280_S32_t;
+typedef uint32_t              BMP280_U32_t;
+typedef int64_t               BMP280_S64_t;
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+/* Temperature kernels give t_fine out, pressure kernels take it in */
+BMP280_S32_t bmp280_compensate_T_int32(const bmx280_t *cal, BMP280_S32_t adc_T, BMP280_S32_t *t_fine);
+BMP280_U32_t bmp280_compensate_P_int32(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine);
+/* Pressure in Pa Q24.8, 64-bit arithmetic, a libgcc call per multiply on the M0 */
+BMP280_U32_t bmp280_compensate_P_int64(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine);
+double bmp280_compensate_T_double(const bmx280_t *cal, BMP280_S32_t adc_T, BMP280_S32_t *t_fine);
+double bmp280_compensate_P_double(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine);
+
+/* Raw samples compensated in place, bit for bit as the kernels above: adc_T
+   into temperature, 0.01 DegC, adc_P into pressure, Pa. p could be null */
+void bmp280_compensate_TP_int32_batch(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __BMX280_COMP_H */
@@ -0,0 +1,220 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_regs.hpp
+  * Description        : Typed model of the BMx280 configuration registers,
+  *                      ctrl_hum, ctrl_meas, config and status. Register
+  *                      words, measurement times and the normal mode output
+  *                      data rate are constexpr, Settings<> checks a whole
+  *                      configuration for a sensor variant at compile time,
+  *                      so the driver stores precomputed constants only.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BMX280_REGS_HPP
+#define __BMX280_REGS_HPP
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+namespace bmx {
+namespace reg {
+
+/* Bit field of a register -------------------------------------------------*/
+template <uint8_t Pos, uint8_t Width>
+struct Field {
+  static constexpr uint8_t Mask = (uint8_t)(((1U << Width) - 1U) << Pos);
+
+  static constexpr bool Fits(uint8_t value) {
+    return (value < (1U << Width));
+  }
+  static constexpr uint8_t Put(uint8_t value) {
+    return ((uint8_t)(value << Pos));
+  }
+  static constexpr uint8_t Get(uint8_t word) {
+    return ((uint8_t)((word & Mask) >> Pos));
+  }
+};
+
+
+
+/* Field values --------------------------------------------------------------*/
+/* Oversampling of a measurement, register codes */
+enum class Ovs : uint8_t {
+  Skip = 0, X1 = 1, X2 = 2, X4 = 3, X8 = 4, X16 = 5
+};
+
+enum class Mode : uint8_t {
+  Sleep = 0, Forced = 1, Normal = 3
+};
+
+enum class Filter : uint8_t {
+  Off = 0, X2 = 1, X4 = 2, X8 = 3, X16 = 4
+};
+
+/* Normal mode standby. Codes 6 and 7 differ by variant, their values carry
+   the variant in bit 3 (BMP280) or bit 4 (BME280) above the code */
+enum class Standby : uint8_t {
+  Ms0_5 = 0, Ms62_5 = 1, Ms125 = 2, Ms250 = 3, Ms500 = 4, Ms1000 = 5,
+  Ms2000 = 0x08 | 6, Ms4000 = 0x08 | 7,
+  Ms10 = 0x10 | 6, Ms20 = 0x10 | 7
+};
+
+constexpr uint8_t Code(Ovs value) {
+  return ((uint8_t)value);
+}
+
+constexpr uint32_t Count(Ovs value) {
+  return (OvsCount(Code(value)));
+}
+
+constexpr bool Valid(Ovs value) {
+  return (Code(value) <= OvsMax);
+}
+
+
+
+/* ctrl_hum ------------------------------------------------------------------*/
+struct CtrlHum {
+  typedef Field<0, 3> Humidity;
+
+  Ovs humidity;
+
+  constexpr uint8_t Word() const {
+    return (Humidity::Put(Code(humidity)));
+  }
+  constexpr bool Valid() const {
+    return (reg::Valid(humidity));
+  }
+};
+
+
+
+/* ctrl_meas -----------------------------------------------------------------*/
+struct CtrlMeas {
+  typedef Field<TemperatureOvs_Pos, 3> Temperature;
+  typedef Field<PressureOvs_Pos, 3> Pressure;
+  typedef Field<Mode_Pos, 2> Mode;
+
+  Ovs temperature;
+  Ovs pressure;
+  reg::Mode mode;
+
+  constexpr uint8_t Word() const {
+    return (Temperature::Put(Code(temperature)) | Pressure::Put(Code(pressure)) | Mode::Put((uint8_t)mode));
+  }
+  /* Pressure compensation takes t_fine, the temperature can't be skipped */
+  constexpr bool Valid() const {
+    return (reg::Valid(temperature) && reg::Valid(pressure) && (temperature != Ovs::Skip)
+      && ((mode == reg::Mode::Sleep) || (mode == reg::Mode::Forced) || (mode == reg::Mode::Normal)));
+  }
+  /* Typical measurement time by datasheet, us */
+  constexpr uint32_t Typical_us(Ovs humidity = Ovs::Skip) const {
+    return (1000 + (2000 * Count(temperature))
+      + ((pressure != Ovs::Skip) ? ((2000 * Count(pressure)) + 500) : 0)
+      + ((humidity != Ovs::Skip) ? ((2000 * Count(humidity)) + 500) : 0));
+  }
+  /* Maximum measurement time by datasheet, us */
+  constexpr uint32_t Max_us(Ovs humidity = Ovs::Skip) const {
+    return (1250 + (2300 * Count(temperature))
+      + ((pressure != Ovs::Skip) ? ((2300 * Count(pressure)) + 575) : 0)
+      + ((humidity != Ovs::Skip) ? ((2300 * Count(humidity)) + 575) : 0));
+  }
+};
+
+
+
+/* config --------------------------------------------------------------------*/
+struct Config {
+  typedef Field<Standby_Pos, 3> Standby;
+  typedef Field<Filter_Pos, 3> Filter;
+  typedef Field<Spi3w_Pos, 1> Spi3w;
+
+  reg::Standby standby;
+  reg::Filter filter;
+  bool spi3w;
+
+  constexpr uint8_t Word() const {
+    return (Standby::Put((uint8_t)standby & 0x07) | Filter::Put((uint8_t)filter) | Spi3w::Put(spi3w));
+  }
+  template <class Variant>
+  constexpr bool Valid() const {
+    return ((((uint8_t)standby & 0x08) ? !Variant::Humidity : true)
+      && (((uint8_t)standby & 0x10) ? Variant::Humidity : true)
+      && ((uint8_t)filter <= (uint8_t)reg::Filter::X16));
+  }
+  constexpr uint32_t Standby_us() const {
+    switch (standby) {
+      case reg::Standby::Ms0_5:  return (500);
+      case reg::Standby::Ms62_5: return (62500);
+      case reg::Standby::Ms125:  return (125000);
+      case reg::Standby::Ms250:  return (250000);
+      case reg::Standby::Ms500:  return (500000);
+      case reg::Standby::Ms1000: return (1000000);
+      case reg::Standby::Ms2000: return (2000000);
+      case reg::Standby::Ms4000: return (4000000);
+      case reg::Standby::Ms10:   return (10000);
+      case reg::Standby::Ms20:   return (20000);
+    }
+    return (0);
+  }
+};
+
+
+
+/* status --------------------------------------------------------------------*/
+struct Status {
+  typedef Field<Measuring_Pos, 1> Busy;
+  typedef Field<ImUpdate_Pos, 1> Update;
+
+  /* A conversion is running */
+  static constexpr bool IsMeasuring(uint8_t word) {
+    return (Busy::Get(word) != 0);
+  }
+  /* The calibration is being copied from NVM */
+  static constexpr bool IsUpdating(uint8_t word) {
+    return (Update::Get(word) != 0);
+  }
+};
+
+
+
+/* Settings ------------------------------------------------------------------*/
+/* A whole configuration of a Variant sensor, it doesn't compile unless every
+   field fits and the combination is valid */
+template <class Variant, Ovs T, Ovs P, Mode M = Mode::Forced,
+          Standby Sb = Standby::Ms0_5, Filter F = Filter::Off, Ovs H = Ovs::Skip>
+struct Settings {
+  static constexpr CtrlMeas Meas = { T, P, M };
+  static constexpr Config Conf = { Sb, F, false };
+  static constexpr CtrlHum Hum = { H };
+
+  static_assert(Meas.Valid(), "ctrl_meas: oversampling out of range or temperature skipped");
+  static_assert(Conf.template Valid<Variant>(), "config: standby time or filter not available on this variant");
+  static_assert(Hum.Valid() && (Variant::Humidity || (H == Ovs::Skip)), "ctrl_hum: humidity needs a BME280");
+
+  static constexpr uint32_t Measure_us = Meas.Typical_us(H);
+  static constexpr uint32_t MaxMeasure_us = Meas.Max_us(H);
+  /* Output data rate in normal mode by datasheet, mHz, 0 in other modes */
+  static constexpr uint32_t Odr_mHz = (M == Mode::Normal) ? (uint32_t)(1000000000ULL / (Measure_us + Conf.Standby_us())) : 0;
+};
+
+
+
+/* The model is checked against the masks of bmx280.h */
+static_assert(CtrlMeas::Temperature::Mask == TemperatureOvsMask, "ctrl_meas osrs_t");
+static_assert(CtrlMeas::Pressure::Mask == PressureOvsMask, "ctrl_meas osrs_p");
+static_assert(CtrlMeas::Mode::Mask == ModeMask, "ctrl_meas mode");
+static_assert(Config::Standby::Mask == StandbyMask, "config t_sb");
+static_assert(Config::Filter::Mask == FilterMask, "config filter");
+static_assert(Config::Spi3w::Mask == Spi3wMask, "config spi3w_en");
+static_assert(Status::Busy::Mask == Measuring, "status measuring");
+static_assert(CtrlMeas{ Ovs::X1, Ovs::X1, Mode::Forced }.Typical_us() == MeasureTime_us(1, 1), "measurement time");
+static_assert(CtrlMeas{ Ovs::X16, Ovs::X16, Mode::Forced }.Max_us() == 75425, "maximum measurement time");
+
+} /* namespace reg */
+} /* namespace bmx */
+
+#endif /* __BMX280_REGS_HPP */
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * File Name          : clock.h
+  * Description        : This file provides code for the monotonic system
+  *                      clock driven by SysTick interrupt.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __CLOCK_H
+#define __CLOCK_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define CLOCK_TICK_FREQ     1000U                          // SysTick quantum is 1ms
+#define CLOCK_TICK_US       (1000000U / CLOCK_TICK_FREQ)
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Clock_Init(void);
+uint64_t Clock_Millis(void);
+uint64_t Clock_Micros(void);
+void Clock_Advance(uint32_t us);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ CLOCK_H */
+
@@ -23,12 +23,15 @@
 /* Exported types ------------------------------------------------------------*/
     
 /* Private typedef -----------------------------------------------------------*/
+/* C only, libc has __FILE as a typedef, which C++ doesn't take as a tag */
+#ifndef __cplusplus
 struct __FILE {
   int handle;
   /* Whatever you require here. If the only file you are using is */
   /* standard output using printf() for debugging, no file handling */
   /* is required. */
 };
+#endif /* __cplusplus */
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -92,8 +95,12 @@ struct __FILE {
 
 
 /* Exported macro ------------------------------------------------------------*/
-#define FLAG_SET(registry, flag)        SET_BIT(registry, (1 << flag))
-#define FLAG_CLR(registry, flag)        CLEAR_BIT(registry, (1 << flag))
+/* Read-modify-write with interrupts masked, Cortex-M0 has no LDREX/STREX */
+#define ATOMIC(statement)               do { uint32_t _primask = __get_PRIMASK(); \
+                                          __disable_irq(); statement; __set_PRIMASK(_primask); } while (0)
+
+#define FLAG_SET(registry, flag)        ATOMIC(SET_BIT(registry, (1 << flag)))
+#define FLAG_CLR(registry, flag)        ATOMIC(CLEAR_BIT(registry, (1 << flag)))
 #define FLAG_CHECK(registry, flag)      (READ_BIT(registry, (1 << flag)))
 
 #define PIN_H(port, pin)                SET_BIT(port->BSRR, pin)
@@ -115,6 +122,7 @@ struct __FILE {
 /* Exported functions prototypes ---------------------------------------------*/
 void Error_Handler(void);
 void LED_Blink(GPIO_TypeDef* port, uint16_t pinSource);
+int _write(int32_t file, char *ptr, int32_t len);
 
 
 
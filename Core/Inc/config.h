@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * File Name          : config.h
+  * Description        : Build features of the firmware, all in one place.
+  *                      A profile picks a set of them, CONFIG_MIN,
+  *                      CONFIG_DEFAULT (when none is given) or CONFIG_DEBUG,
+  *                      e.g. make CONFIG=MIN. Single features are added on
+  *                      top by -D, e.g. make DEFS=-DTRACE_ON, and
+  *                      make size-report prints what each one costs.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __CONFIG_H
+#define __CONFIG_H
+
+/*
+  Features, defined as 1 so that the same -D on the command line agrees:
+    LOG_PRINTF      LOG() by newlib printf(), otherwise by Log_Printf(),
+                    integer conversions only, no stdio is linked
+    LOG_DEFERRED    LOG() sends format string IDs instead of text, no
+                    formatting on the target at all, Tools/logdec
+    BMX280_PRECISE  BMP280_ReadTP()/BMP280_ReadPP() double output, links
+                    the soft-float library
+    BME280_SUPPORT  A BME280 is taken as well, ctrl_hum gets written
+    PROFILE         PROF_ENTER()/PROF_EXIT() probes, takes TIM3 and TIM1
+    WAIT_STATS      Busy-wait and main loop accounting, takes TIM3 and TIM1
+    TRACE_ON        TRACE() event records, 512 bytes of RAM
+    SPI_CAPTURE     SPI transactions to USART1 in binary, Host/replay
+    BMX280_CPP      bmx280.hpp template driver in place of bmp280.c
+    BMX280_BME      BMX280_CPP built for a BME280 instead of a BMP280
+*/
+
+#if defined(CONFIG_MIN)
+/* Float and stdio free, BMP280 only, text output by Log_Printf() */
+
+#elif defined(CONFIG_DEBUG)
+/* Everything to look inside */
+  #define LOG_PRINTF      1
+  #define BMX280_PRECISE  1
+  #define BME280_SUPPORT  1
+  #define PROFILE         1
+  #define WAIT_STATS      1
+  #define TRACE_ON        1
+
+#else
+/* CONFIG_DEFAULT */
+  #define LOG_PRINTF      1
+  #define BME280_SUPPORT  1
+  // #define LOG_DEFERRED  1
+  // #define PROFILE       1
+  // #define WAIT_STATS    1
+  // #define TRACE_ON      1
+  // #define SPI_CAPTURE   1
+  // #define BMX280_CPP    1
+  // #define BMX280_BME    1
+
+#endif /* CONFIG_MIN */
+
+#endif /* __CONFIG_H */
@@ -0,0 +1,36 @@
+/**
+  ******************************************************************************
+  * File Name          : console.h
+  * Description        : This file provides code for the command console
+  *                      over USART1.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __CONSOLE_H
+#define __CONSOLE_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define CMDBUF_LEN          32
+#define BENCH_LINE_LEN      64
+#define BENCH_DEFAULT_LEN   8192
+#define BENCH_MAX_LEN       65536
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Console_Handler(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ CONSOLE_H */
+
@@ -0,0 +1,48 @@
+/**
+  ******************************************************************************
+  * File Name          : delay.h
+  * Description        : This file provides code for the delay, timeout
+  *                      and sleep services on the delay timer.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __DELAY_H
+#define __DELAY_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define DELAY_MAX_STEP      0x8000U   // Longest single sleep, timer ticks
+
+/* Exported types ------------------------------------------------------------*/
+/* Timeout has to be polled at least once per the delay timer period */
+typedef struct {
+  uint32_t  elapsed;
+  uint32_t  limit;
+  uint16_t  last;
+} Timeout_TypeDef;
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Delay(uint32_t delay);
+void Delay_us(uint32_t us);
+void Timeout_Start(Timeout_TypeDef *timeout, uint32_t us);
+uint8_t Timeout_Expired(Timeout_TypeDef *timeout);
+void Sleep_Idle(void);
+void Sleep_Snapshot(void);
+uint32_t Sleep_IdlePermille(void);
+void Delay_Wakeup_Handler(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ DELAY_H */
+
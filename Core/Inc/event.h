@@ -0,0 +1,34 @@
+/**
+  ******************************************************************************
+  * File Name          : event.h
+  * Description        : This file provides code for the event flag register
+  *                      _EREG_ and the wait for any event service.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __EVENT_H
+#define __EVENT_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define EVENT_ANY           0xffffffffU   // All _EREG_ flags
+#define EVENT_FOREVER       0xffffffffU   // No wait timeout
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint32_t Event_Take(uint32_t mask);
+uint32_t Event_Wait(uint32_t mask, uint32_t timeout);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ EVENT_H */
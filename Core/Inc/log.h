@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * File Name          : log.h
+  * Description        : This file provides the logging macro. In text mode
+  *                      LOG() is printf() with LOG_PRINTF, otherwise the
+  *                      integer-only Log_Printf(). In deferred mode a format
+  *                      string is placed into the .logstr section, that is
+  *                      not loaded into the target, and its offset becomes
+  *                      the message ID. Only the ID and raw 32-bit arguments
+  *                      are sent, Tools/logdec formats them on a host.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __LOG_H
+#define __LOG_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+/*
+  Deferred frame:
+    0xf0 | nargs, ID low byte, ID high byte, nargs * 4 bytes of arguments (LE)
+  Text is 7-bit, so frames could be interleaved with plain text.
+*/
+#define LOG_SYNC            0xf0
+#define LOG_SYNC_MASK       0xf8
+#define LOG_MAX_ARGS        6
+/* Log_Printf() hands text to _write() in pieces of that many bytes */
+#define LOG_CHUNK_LEN       32
+
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef LOG_DEFERRED
+
+#define LOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, N, ...)  N
+#define LOG_NARGS(...)      LOG_NARGS_(_0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_CAT_(a, b)      a##b
+#define LOG_CAT(a, b)       LOG_CAT_(a, b)
+
+/* Integer arguments only, every one is sent as 32-bit word */
+#define LOG(fmt, ...) do { \
+    static const char logFmt[] __attribute__((section(".logstr"), used)) = fmt; \
+    LOG_CAT(Log_Emit, LOG_NARGS(__VA_ARGS__))((uint16_t)(uintptr_t)logFmt, ##__VA_ARGS__); \
+  } while (0)
+
+#elif defined(LOG_PRINTF)
+
+#define LOG(fmt, ...)       printf(fmt, ##__VA_ARGS__)
+
+#else
+
+#define LOG(fmt, ...)       Log_Printf(fmt, ##__VA_ARGS__)
+
+#endif /* LOG_DEFERRED */
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Log_Emit0(uint16_t id);
+void Log_Emit1(uint16_t id, uint32_t a0);
+void Log_Emit2(uint16_t id, uint32_t a0, uint32_t a1);
+void Log_Emit3(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2);
+void Log_Emit4(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3);
+void Log_Emit5(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4);
+void Log_Emit6(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5);
+int Log_Printf(const char *fmt, ...) __attribute__((format(__printf__, 1, 2)));
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ LOG_H */
+
@@ -18,9 +18,13 @@ extern "C" {
 #endif
 
 /* Includes ------------------------------------------------------------------*/
+#include "config.h"
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
+#include <inttypes.h>
 
 #include "stm32f0xx.h"
 #include "stm32f0xx_it.h"
@@ -28,24 +32,34 @@ extern "C" {
 /* Private includes ----------------------------------------------------------*/
 #include "common.h"
 #include "usart.h"
+#include "log.h"
 #include "tim.h"
+#include "prof.h"
+#include "wait.h"
+#include "trace.h"
+#include "clock.h"
+#include "event.h"
+#include "sched.h"
+#include "delay.h"
+#include "rtc.h"
+#include "power.h"
 #include "spi.h"
 #include "bmx280.h"
+#include "sample.h"
+#include "console.h"
 
 /* Exported types ------------------------------------------------------------*/
 
 /* Exported constants --------------------------------------------------------*/
 
 /* Exported variables --------------------------------------------------------*/
-extern uint32_t sysQuantum;
-extern uint32_t millis;
-extern uint32_t seconds;
-extern uint32_t minutes;
-extern uint32_t _EREG_;
+extern volatile uint64_t sysQuantum;
+extern volatile uint32_t _EREG_;
 extern uint32_t SystemCoreClock;
 
 /* Private defines -----------------------------------------------------------*/
 #define SWO_USART
+/* Build features are selected in config.h */
 
 // _EREG_ Flags    
 #define _BT6F_    0 // Basic Timer6 Flag
@@ -57,16 +71,14 @@ extern uint32_t SystemCoreClock;
 // #define _DBLF_    6 // Data Buffer is Locked Flag
 #define _U1RXF_   7 // USART1 RXNE Interrupt occurs Flag
 // #define _BLINKF_  8 // Blink Flaf
-#define _DELAYF_  9 // Delay Flag
+// #define _DELAYF_  9 // Delay Flag
 // #define _EWUPF_   10 // EXTI WakeUp PA0 Flag
 // #define _ETSF_    11 // EXTI Touch Screen PA15 Flag
 // #define _TBLF_    12 // Transfer Buffer is Locked Flag
-#define _SECF_    13 // Second clung Flag
+// #define _SECF_    13 // Second clung Flag
 
 /* Exported functions prototypes ---------------------------------------------*/
-extern void Delay_Handler(uint32_t delay);
-extern void Delay(uint32_t delay);
-extern void Cron_Handler(void);
+void SystemClock_Config(void);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * File Name          : power.h
+  * Description        : This file provides code for the low-power duty
+  *                      cycling in Stop mode.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __POWER_H
+#define __POWER_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define POWER_LP_AT_START   0         // Duty cycling is enabled at start
+#define POWER_STOP_MIN_MS   5         // Shorter idle periods are slept in WFI
+#define POWER_HOLD_MS       10000     // Console activity keeps the core awake
+
+/* Typical supply currents at 3.3V by datasheet, uA. Tune them for a board */
+#define POWER_RUN_UA        22000     // Run on 48MHz, peripherals enabled
+#define POWER_SLEEP_UA      14000     // Sleep on 48MHz, peripherals enabled
+#define POWER_WAKE_UA       3000      // Run on HSI 8MHz, while PLL is locking
+#define POWER_STOP_UA       6         // Stop, LP regulator, LSI, RTC and IWDG
+
+/* Power states */
+#define POWER_RUN           0
+#define POWER_SLEEP         1
+#define POWER_WAKE          2
+#define POWER_STOP          3
+#define POWER_STATES        4
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  uint32_t  permille[POWER_STATES];   // Share of the last window, 1/1000
+  uint32_t  averageUa;                // Estimated average current, uA
+  uint32_t  stops;                    // Stop entries in the last window
+} Power_Budget_TypeDef;
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Power_Init(void);
+void Power_Idle(void);
+void Power_SetLowPower(uint8_t enable);
+uint8_t Power_GetLowPower(void);
+void Power_Hold(uint32_t ms);
+void Power_Snapshot(void);
+const Power_Budget_TypeDef* Power_GetBudget(void);
+void Power_RxWakeup_Handler(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ POWER_H */
+
@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * File Name          : prof.h
+  * Description        : This file provides code for the cycle profiler.
+  *                      PROF_ENTER()/PROF_EXIT() probes compile to nothing
+  *                      unless PROFILE is defined in config.h.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __PROF_H
+#define __PROF_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+/* Probe list: id, name */
+#define PROF_PROBES(X) \
+  X(PROF_BMP280_READ,     "bmp280_read") \
+  X(PROF_COMPENSATE_T,    "compensate_t") \
+  X(PROF_COMPENSATE_P,    "compensate_p") \
+  X(PROF_SPI_READ,        "spi_read") \
+  X(PROF_SPI_WRITE,       "spi_write") \
+  X(PROF_WRITE,           "_write")
+
+#define PROF_CALIBRATE      8         // Empty probe runs to measure overhead
+
+/* Exported types ------------------------------------------------------------*/
+#define PROF_ID(id, name)   id,
+typedef enum {
+  PROF_PROBES(PROF_ID)
+  PROF_COUNT
+} Prof_Probe_TypeDef;
+#undef PROF_ID
+
+typedef struct {
+  uint32_t  start;
+  uint32_t  count;
+  uint32_t  min;
+  uint32_t  max;
+  uint64_t  total;
+} Prof_Entry_TypeDef;
+
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef PROFILE
+  #define PROF_ENTER(probe)   (profTable[probe].start = Cycles())
+  #define PROF_EXIT(probe)    Prof_Exit(&profTable[probe], Cycles())
+#else
+  #define PROF_ENTER(probe)   ((void)0)
+  #define PROF_EXIT(probe)    ((void)0)
+#endif /* PROFILE */
+
+
+/* Exported variables --------------------------------------------------------*/
+#ifdef PROFILE
+extern Prof_Entry_TypeDef profTable[PROF_COUNT];
+#endif /* PROFILE */
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+#ifdef PROFILE
+void Prof_Init(void);
+void Prof_Exit(Prof_Entry_TypeDef *entry, uint32_t end);
+void Prof_Reset(void);
+void Prof_Dump(void);
+#endif /* PROFILE */
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ PROF_H */
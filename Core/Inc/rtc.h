@@ -0,0 +1,51 @@
+/**
+  ******************************************************************************
+  * File Name          : rtc.h
+  * Description        : This file provides code for the configuration
+  *                      of the RTC on LSI clock.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __RTC_H
+#define __RTC_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#ifndef LSI_VALUE
+#define LSI_VALUE           40000     // Nominal LSI, Hz, the Makefile passes it too
+#endif /* LSI_VALUE */
+#define RTC_PREDIV_A        3         // ck_apre is LSI/4, ~10kHz, ~100us subsecond
+#define RTC_DAY_SECONDS     86400U
+#define RTC_LSI_EDGES       8         // RTCCLK edges per TIM14 capture
+#define RTC_LSI_CAPTURES    64        // Captures per LSI measurement
+#define RTC_LSI_TIMEOUT     1000U     // Single capture timeout, us
+#define RTC_SYNC_TIMEOUT    10000U    // RTC INITF/ALRAWF timeout, us
+
+#define RTC_KEY_1           0xca
+#define RTC_KEY_2           0x53
+#define RTC_KEY_LOCK        0xff
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+uint8_t RTC_Init(void);
+uint32_t RTC_Counts(void);
+uint32_t RTC_Elapsed(uint32_t from, uint32_t to);
+uint32_t RTC_CountsToUs(uint32_t counts);
+void RTC_SetAlarm(uint32_t ms);
+uint32_t RTC_LsiFreq(void);
+void RTC_Alarm_Handler(void);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ RTC_H */
+
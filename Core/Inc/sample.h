@@ -0,0 +1,39 @@
+/**
+  ******************************************************************************
+  * File Name          : sample.h
+  * Description        : This file provides code for the publication of the
+  *                      latest sensor sample to readers in any context.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SAMPLE_H
+#define __SAMPLE_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "bmx280_comp.h"
+
+
+/* Exported types ------------------------------------------------------------*/
+typedef struct {
+  uint32_t      time;               // Clock_Millis() at publication, ms
+  BMP280_S32_t  temperature;        // 0.01 DegC
+  BMP280_U32_t  pressure;           // Pa
+} Sample_TypeDef;
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Sample_Publish(const Sample_TypeDef *sample);
+uint32_t Sample_Latest(Sample_TypeDef *sample);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ SAMPLE_H */
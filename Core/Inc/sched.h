@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * File Name          : sched.h
+  * Description        : This file provides code for the cooperative task
+  *                      scheduler built on a hashed timer wheel.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SCHED_H
+#define __SCHED_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define SCHED_WHEEL_SLOTS       32                        // Power of two, one slot per ms
+#define SCHED_WHEEL_MASK        (SCHED_WHEEL_SLOTS - 1)
+#define SCHED_PRIO_LEVELS       4                         // 0 is the highest priority
+#define SCHED_DEFAULT_DEADLINE  10                        // One-shot and event tasks, ms
+
+/* Task states */
+#define SCHED_IDLE              0
+#define SCHED_TIMED             1
+#define SCHED_READY             2
+
+/* Exported types ------------------------------------------------------------*/
+typedef void (*Sched_Func_TypeDef)(void);
+
+typedef struct Sched_Task {
+  struct Sched_Task   *next;      // Wheel slot or ready queue link
+  struct Sched_Task   **pprev;    // Wheel slot back link, O(1) removal
+  struct Sched_Task   *link;      // List of all registered tasks
+  Sched_Func_TypeDef  func;
+  uint32_t            release;    // Release time, ms
+  uint32_t            period;     // 0 for one-shot tasks, ms
+  uint32_t            deadline;   // Relative deadline, ms
+  uint32_t            runs;
+  uint32_t            missed;     // Deadline miss count
+  uint8_t             prio;
+  uint8_t             state;
+  uint8_t             id;         // Registration order
+} Sched_Task_TypeDef;
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+void Sched_Init(void);
+void Sched_Add(Sched_Task_TypeDef *task, Sched_Func_TypeDef func, uint8_t prio, uint32_t deadline);
+void Sched_Start(Sched_Task_TypeDef *task, uint32_t delay, uint32_t period);
+void Sched_Stop(Sched_Task_TypeDef *task);
+void Sched_Post(Sched_Task_TypeDef *task);
+void Sched_Bind(uint8_t flag, Sched_Task_TypeDef *task);
+uint32_t Sched_Events(void);
+void Sched_Run(void);
+Sched_Task_TypeDef* Sched_Tasks(void);
+uint8_t Sched_NextRelease(uint32_t *release);
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ SCHED_H */
+
@@ -17,6 +17,7 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
+#include "spi_capture.h"
 
 /* Private defines -----------------------------------------------------------*/
 #define NSS_0_Pin       GPIO_PIN_4
@@ -29,6 +30,18 @@
 #define MOSI_Pin_Pos    GPIO_PIN_7_Pos
 #define SPI_Port        GPIOA
 
+/* Bounds of the waits. A byte takes 43us at the slowest prescaler */
+#define SPI_TIMEOUT_US      500
+#define SPI_NSS_TIMEOUT_US  10
+
+typedef enum {
+  SPI_OK        = 0,
+  SPI_ERR_NSS   = 1,        // NSS didn't read back low
+  SPI_ERR_TXE   = 2,
+  SPI_ERR_RXNE  = 3,
+  SPI_ERR_BSY   = 4
+} SPI_Status_TypeDef;
+
 typedef enum {
   NEUTRAL   = 2,
   READ      = 1,
@@ -37,15 +50,25 @@ typedef enum {
 
 
 /* Exported macro ------------------------------------------------------------*/
+/* Data register access, the host simulation replaces it with the bus model */
+#ifndef SPI_DR_WRITE
+  #define SPI_DR_WRITE(spi, data)   (*(__IO uint8_t*)&(spi)->DR = (data))
+#endif
+#ifndef SPI_DR_READ
+  #define SPI_DR_READ(spi)          ((uint8_t)(spi)->DR)
+#endif
+
 #define NSS_0_H         PIN_H(SPI_Port, NSS_0_Pin)
 #define NSS_0_L         PIN_L(SPI_Port, NSS_0_Pin)
 
 /* Exported functions prototypes ---------------------------------------------*/
 void SPI1_Init(void);
 void SPI1_Enable(void);
-void SPI1_Disable(void);
-void SPI_Read(uint8_t *buf, uint8_t cnt);
-void SPI_Write(uint8_t *buf, uint8_t cnt);
+SPI_Status_TypeDef SPI1_Disable(void);
+void SPI1_Recover(void);
+SPI_Status_TypeDef SPI_Read(uint8_t *buf, uint8_t cnt);
+SPI_Status_TypeDef SPI_Write(uint8_t *buf, uint8_t cnt);
+void SPI_Capture(uint8_t type, uint8_t cmd, const uint8_t *data, uint8_t len, uint32_t time);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,34 @@
+/**
+  ******************************************************************************
+  * File Name          : spi_capture.h
+  * Description        : This file provides the SPI capture frame format.
+  *                      It's shared with the host replay, so it doesn't
+  *                      depend on the device headers.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SPI_CAPTURE_H
+#define __SPI_CAPTURE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Private defines -----------------------------------------------------------*/
+/*
+  Capture frame, one per SPI_Read()/SPI_Write() transaction:
+    0xe8 read | 0xe9 write, command byte, payload length,
+    microsecond timestamp of the chip select (LE32), payload
+  A read payload is what was clocked in after the command, a write payload
+  is what was sent after it. Text is 7-bit and LOG frames are 0xf0..0xf7,
+  so captures could be interleaved with both.
+*/
+#define SPI_CAPTURE_READ        0xe8
+#define SPI_CAPTURE_WRITE       0xe9
+#define SPI_CAPTURE_SYNC_MASK   0xfe
+#define SPI_CAPTURE_HEADER_LEN  7
+
+
+#endif /* __SPI_CAPTURE_H */
@@ -34,6 +34,9 @@ void SVC_Handler(void);
 void PendSV_Handler(void);
 void SysTick_Handler(void);
 
+void RTC_IRQHandler(void);
+void EXTI4_15_IRQHandler(void);
+void TIM14_IRQHandler(void);
 void USART1_IRQHandler(void);
 
 
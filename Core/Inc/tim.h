@@ -18,10 +18,43 @@
 /* Includes ------------------------------------------------------------------*/
 #include "main.h"
 
+/* Private defines -----------------------------------------------------------*/
+/* Delay timer is free running on 1MHz, it wraps every 65.5ms */
+#define DELAY_TIM           TIM14
+#define DELAY_TIM_FREQ      1000000U
+
+/* Cycle counter is TIM3 on the core clock, its update clocks TIM1 by ITR2,
+   together they count 32-bit cycles and wrap every 89s on 48MHz */
+#if defined(PROFILE) || defined(WAIT_STATS)
+  #define CYCLE_COUNTER
+#endif
+#define CYCLE_TIM_LO        TIM3
+#define CYCLE_TIM_HI        TIM1
+
 
 /* Exported functions prototypes ---------------------------------------------*/
 void TIM6_Init(void);
 void BasicTimer_Handler(TIM_TypeDef *tim);
+void TIM14_Init(void);
+void TIM3_Init(void);
+
+
+/**
+  * @brief  Reads the cycle counter. The high half is read again to catch
+  *         the low half wrapping in between.
+  * @param  none
+  * @retval Core clock cycles.
+  */
+__STATIC_INLINE uint32_t Cycles(void) {
+  uint32_t hi, lo;
+
+  do {
+    hi = CYCLE_TIM_HI->CNT;
+    lo = CYCLE_TIM_LO->CNT;
+  } while (hi != CYCLE_TIM_HI->CNT);
+
+  return ((hi << 16) | lo);
+}
 
 
 #ifdef __cplusplus
@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * File Name          : trace.h
+  * Description        : This file provides code for the event trace ring.
+  *                      TRACE() records compile to nothing unless TRACE_ON
+  *                      is defined in config.h.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+#include "trace_events.h"
+
+/* Private defines -----------------------------------------------------------*/
+#define TRACE_LEN           64        // Records, power of 2
+#define TRACE_MASK          (TRACE_LEN - 1)
+
+
+/* Exported macro ------------------------------------------------------------*/
+#ifdef TRACE_ON
+  #define TRACE(event, arg, value)  Trace_Record((event), (uint8_t)(arg), (uint16_t)(value))
+#else
+  #define TRACE(event, arg, value)  ((void)0)
+#endif /* TRACE_ON */
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+#ifdef TRACE_ON
+void Trace_Record(uint8_t event, uint8_t arg, uint16_t value);
+void Trace_Dump(void);
+#endif /* TRACE_ON */
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ TRACE_H */
@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * File Name          : trace_events.h
+  * Description        : This file provides the trace event list and the
+  *                      dump format. It's shared with the host converter,
+  *                      so it doesn't depend on the device headers.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __TRACE_EVENTS_H
+#define __TRACE_EVENTS_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+/* Private defines -----------------------------------------------------------*/
+/* Event list: id, name, track, phase ('B' begin, 'E' end, 'i' instant) */
+#define TRACE_EVENTS(X) \
+  X(TRACE_SPI_BEGIN,      "spi",      "spi",    'B') \
+  X(TRACE_SPI_END,        "spi",      "spi",    'E') \
+  X(TRACE_CONV_START,     "conv",     "sensor", 'B') \
+  X(TRACE_SAMPLE_READY,   "conv",     "sensor", 'E') \
+  X(TRACE_UART_QUEUED,    "queued",   "uart",   'i') \
+  X(TRACE_UART_SENT,      "sent",     "uart",   'i') \
+  X(TRACE_TASK_BEGIN,     "task",     "sched",  'B') \
+  X(TRACE_TASK_END,       "task",     "sched",  'E') \
+  X(TRACE_SENSOR_RESET,   "reset",    "sensor", 'i')
+
+/* Dump: magic, version, record count, overwritten record count (LE16),
+   then records oldest first */
+#define TRACE_MAGIC         "TRC"
+#define TRACE_VERSION       1
+#define TRACE_HEADER_LEN    8
+
+/* Exported types ------------------------------------------------------------*/
+#define TRACE_ID(id, name, track, phase)   id,
+enum {
+  TRACE_EVENTS(TRACE_ID)
+  TRACE_EVENT_COUNT
+};
+#undef TRACE_ID
+
+/* 8 bytes, little-endian on both sides */
+typedef struct {
+  uint32_t  time;     // Clock_Micros(), low 32 bits
+  uint8_t   event;
+  uint8_t   arg;      // Task id, SPI length
+  uint16_t  value;    // SPI command, UART length, task priority
+} Trace_Record_TypeDef;
+
+
+#endif /*__ TRACE_EVENTS_H */
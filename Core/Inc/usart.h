@@ -29,12 +29,34 @@
 /* Circular buffer defines */
 #define RXBUF_LEN       64
 #define RXBUF_MASK      (RXBUF_LEN - 1)
+#define TXBUF_LEN       128
+#define TXBUF_MASK      (TXBUF_LEN - 1)
+
+/* Baud rate defines */
+#define USART_DEFAULT_BAUD      115200
+#define USART_BAUD_MAX_ERR      20000 // Highest acceptable baud rate error, ppm
+
+/* Data register access, the host simulation replaces it with the line model */
+#ifndef USART_TDR_WRITE
+  #define USART_TDR_WRITE(usart, data)  ((usart)->TDR = (data))
+#endif
+#ifndef USART_RDR_READ
+  #define USART_RDR_READ(usart)         ((uint8_t)(usart)->RDR)
+#endif
 
 
 /* Exported functions prototypes ---------------------------------------------*/
 void USART1_Init(void);
 void USART1_RX_Handler(void);
+void USART1_TX_Handler(void);
+void USART1_TX_Put(uint8_t ch);
+void USART1_TX_Write(const uint8_t *buf, uint16_t len);
+void USART1_TX_Flush(void);
+uint8_t USART1_TX_Pending(void);
 uint8_t USART_RxBufferRead(uint8_t *buf, uint16_t len);
+uint8_t USART1_CalcBRR(uint32_t baudRate, uint8_t over8, uint16_t *brr, int32_t *errorPpm);
+uint8_t USART1_SetBaudRate(uint32_t baudRate, uint8_t over8, int32_t *errorPpm);
+uint32_t USART1_GetBaudRate(void);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,130 @@
+/**
+  ******************************************************************************
+  * File Name          : wait.h
+  * Description        : This file provides code for the busy-wait and main
+  *                      loop accounting. BUSY_WAIT(), BUSY_WAIT_TIMEOUT(),
+  *                      WAIT_BEGIN()/WAIT_END() and LOOP_BEGIN()/LOOP_END()
+  *                      account nothing unless WAIT_STATS is defined in
+  *                      config.h.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __WAIT_H
+#define __WAIT_H
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private defines -----------------------------------------------------------*/
+/* Wait site list: id, name, spinning (1) or sleeping (0) */
+#define WAIT_SITES(X) \
+  X(WAIT_SPI_NSS,         "spi_nss",        1) \
+  X(WAIT_SPI_TXE,         "spi_txe",        1) \
+  X(WAIT_SPI_RXNE,        "spi_rxne",       1) \
+  X(WAIT_SPI_BSY,         "spi_bsy",        1) \
+  X(WAIT_USART_TXE,       "usart_txe",      1) \
+  X(WAIT_BMP280_MEASURE,  "bmp280_measure", 0) \
+  X(WAIT_DELAY,           "delay",          0)
+
+/* Exported types ------------------------------------------------------------*/
+#define WAIT_ID(id, name, spin)   id,
+typedef enum {
+  WAIT_SITES(WAIT_ID)
+  WAIT_COUNT
+} Wait_Site_TypeDef;
+#undef WAIT_ID
+
+typedef struct {
+  uint32_t  start;
+  uint32_t  count;
+  uint32_t  cycles;
+  uint32_t  max;
+} Wait_Entry_TypeDef;
+
+typedef struct {
+  uint32_t  start;
+  uint32_t  count;
+  uint32_t  cycles;
+  uint32_t  min;
+  uint32_t  max;
+} Wait_Loop_TypeDef;
+
+
+/* Exported macro ------------------------------------------------------------*/
+/* Called on every poll of a wait, the host simulation advances time by it */
+#ifndef WAIT_POLL
+  #define WAIT_POLL()         ((void)0)
+#endif
+
+/* Wait bounded by the microsecond clock, ok is cleared when it gave up after
+   timeout us. The clock is read only once the condition holds on entry */
+#define WAIT_BOUNDED(cond, timeout, ok) \
+  do { \
+    uint64_t _deadline = Clock_Micros() + (timeout); \
+    while ((cond) && ((ok) = (Clock_Micros() < _deadline))) WAIT_POLL(); \
+  } while (0)
+
+#ifdef WAIT_STATS
+  #define BUSY_WAIT(site, cond) \
+    do { \
+      if (cond) { \
+        waitTable[site].start = Cycles(); \
+        while (cond) WAIT_POLL(); \
+        Wait_Account(&waitTable[site], Cycles()); \
+      } \
+    } while (0)
+  #define BUSY_WAIT_TIMEOUT(site, cond, timeout, ok) \
+    do { \
+      if (cond) { \
+        waitTable[site].start = Cycles(); \
+        WAIT_BOUNDED(cond, timeout, ok); \
+        Wait_Account(&waitTable[site], Cycles()); \
+      } \
+    } while (0)
+  #define WAIT_BEGIN(site)    (waitTable[site].start = Cycles())
+  #define WAIT_END(site)      Wait_Account(&waitTable[site], Cycles())
+  #define LOOP_BEGIN()        (waitLoop.start = Cycles())
+  #define LOOP_END()          Wait_Loop(Cycles())
+#else
+  #define BUSY_WAIT(site, cond) \
+    do { \
+      while (cond) WAIT_POLL(); \
+    } while (0)
+  #define BUSY_WAIT_TIMEOUT(site, cond, timeout, ok) \
+    do { \
+      if (cond) WAIT_BOUNDED(cond, timeout, ok); \
+    } while (0)
+  #define WAIT_BEGIN(site)    ((void)0)
+  #define WAIT_END(site)      ((void)0)
+  #define LOOP_BEGIN()        ((void)0)
+  #define LOOP_END()          ((void)0)
+#endif /* WAIT_STATS */
+
+
+/* Exported variables --------------------------------------------------------*/
+#ifdef WAIT_STATS
+extern Wait_Entry_TypeDef waitTable[WAIT_COUNT];
+extern Wait_Loop_TypeDef waitLoop;
+#endif /* WAIT_STATS */
+
+
+/* Exported functions prototypes ---------------------------------------------*/
+#ifdef WAIT_STATS
+void Wait_Init(void);
+void Wait_Account(Wait_Entry_TypeDef *entry, uint32_t end);
+void Wait_Loop(uint32_t end);
+void Wait_Snapshot(void);
+void Wait_Report(void);
+#endif /* WAIT_STATS */
+
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*__ WAIT_H */
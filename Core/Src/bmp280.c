@@ -12,13 +12,30 @@
 /* Includes ------------------------------------------------------------------*/
 #include "bmx280.h"
 
+/* bmx280_cpp.cpp takes over with BMX280_CPP */
+#ifndef BMX280_CPP
+
 /* Private variables ---------------------------------------------------------*/
 static uint8_t dataBuf[8];
 static BMP280_S32_t t_fine = 0;
 static BMP280_S32_t temperature;
 static BMP280_U32_t pressure;
-static double preciseTemperature;
-static double precisePressure;
+#ifdef BMX280_PRECISE
+  static double preciseTemperature;
+  static double precisePressure;
+#endif /* BMX280_PRECISE */
+_Static_assert((TemperatureOvs >= 1) && (TemperatureOvs <= OvsMax) && (PressureOvs <= OvsMax), "oversampling codes out of range");
+/* ctrl_meas word of a forced conversion and its typical time, computed once
+   per oversampling change */
+static uint8_t ctrlMeas = CtrlMeasWord(TemperatureOvs, PressureOvs, ForceMode);
+static uint32_t measTime = MeasureTime_us(TemperatureOvs, PressureOvs);
+/* Control registers as the sensor holds them, writes of the same value are
+   dropped. Queued writes go out as address and data pairs of one transaction */
+static uint8_t shadow[ShadowLen];
+static uint8_t shadowValid = 0;
+static uint8_t writeBuf[2 * ShadowLen];
+static uint8_t writeLen = 0;
+static BMX280_Status_TypeDef lastError = BMX280_OK;
 
 bmx280_t bmx280;
 
@@ -26,11 +43,9 @@ bmx280_t bmx280;
 
 /* Private function prototypes -----------------------------------------------*/
 static void BMP280_Write(uint8_t cmd, uint8_t data);
-static void BMP280_Read(void);
-static double bmp280_compensate_T_double(BMP280_S32_t adc_T);
-static double bmp280_compensate_P_double(BMP280_S32_t adc_P);
-static BMP280_S32_t bmp280_compensate_T_int32(BMP280_S32_t adc_T);
-static BMP280_U32_t bmp280_compensate_P_int32(BMP280_S32_t adc_P);
+static SPI_Status_TypeDef BMP280_Commit(void);
+static BMX280_Status_TypeDef BMP280_Read(void);
+static BMX280_Status_TypeDef BMP280_Sample(void);
 
 
 
@@ -51,21 +66,30 @@ static BMP280_U32_t bmp280_compensate_P_int32(BMP280_S32_t adc_P);
 uint8_t BMP280_Init(void) {
   uint8_t status = 0;
   bmx280.Lock = 1;
+  shadowValid = 0;
+  writeLen = 0;
 
   /* Get family ID of a sensor */
   uint8_t cmd = SensorID;
-  SPI_Read(&cmd, 1);
+  if (SPI_Read(&cmd, 1) != SPI_OK) {
+    lastError = BMX280_ERR_BUS;
+    bmx280.Lock = 0;
+    return (status);
+  }
   bmx280.ID = cmd;
   Delay(1);
   
   /* Get out if wrong family ID was gotten */
   switch (bmx280.ID) {
     case BMP280_ID:
-    case BME280_ID:
+    #ifdef BME280_SUPPORT
+      case BME280_ID:
+    #endif /* BME280_SUPPORT */
       // continue proceed
     break;
 
     default:
+      lastError = BMX280_ERR_ID;
       bmx280.Lock = 0;
       return (status);
   }
@@ -74,7 +98,11 @@ uint8_t BMP280_Init(void) {
   uint8_t calib[28];
 
   calib[0] = Calib1;
-  SPI_Read(calib, 26);
+  if (SPI_Read(calib, 26) != SPI_OK) {
+    lastError = BMX280_ERR_BUS;
+    bmx280.Lock = 0;
+    return (status);
+  }
   Delay(1);
 
   uint8_t *tmp = 0;
@@ -105,6 +133,31 @@ uint8_t BMP280_Init(void) {
   tmp += 2;
   bmx280.P9 = *(int16_t*)(tmp);
 
+  /* Load the shadow, the sensor keeps its registers over an MCU reset */
+  uint8_t ctrl[ShadowLen];
+  ctrl[0] = ShadowBase;
+  if (SPI_Read(ctrl, ShadowLen) == SPI_OK) {
+    for (uint8_t i = 0; i < ShadowLen; i++) {
+      shadow[i] = ctrl[i];
+    }
+    shadowValid = 1;
+  }
+
+  /* Filter off, 4-wire SPI, humidity skipped, they cost no transaction when
+     they hold already */
+  #ifdef BME280_SUPPORT
+    if (bmx280.ID == BME280_ID) {
+      BMP280_Write(CtrlHumidity, 0);
+    }
+  #endif /* BME280_SUPPORT */
+  BMP280_Write(ConfigSensor, 0);
+  if (!shadowValid || (BMP280_Commit() != SPI_OK)) {
+    lastError = BMX280_ERR_BUS;
+    bmx280.Lock = 0;
+    return (status);
+  }
+
+  lastError = BMX280_OK;
   status = 1;
   bmx280.Lock = 0;
   return (status);
@@ -122,24 +175,103 @@ uint8_t BMP280_Init(void) {
   *         to increase the measurment delay.
   *         
   * @param  none
-  * @retval none
+  * @retval BMX280_OK, BMX280_ERR_BUS or BMX280_ERR_CONV
   */
-static void BMP280_Read(void) {
+static BMX280_Status_TypeDef BMP280_Read(void) {
+  BMX280_Status_TypeDef status = BMX280_OK;
+  SPI_Status_TypeDef bus;
+
+  PROF_ENTER(PROF_BMP280_READ);
   bmx280.Lock = 1;
 
-  BMP280_Write(CtrlMeasure, (1 << TemperatureOvs_Pos) | (1 << PressureOvs_Pos) | (ForceMode << Mode_Pos));
-  
-  dataBuf[0] = Measuring;
-  while (dataBuf[0] == Measuring) {
+  /* Oversampling and the forced mode share the byte, so a trigger is a single
+     write whatever changed */
+  BMP280_Write(CtrlMeasure, ctrlMeas);
+  bus = BMP280_Commit();
+
+  TRACE(TRACE_CONV_START, 0, 0);
+
+  /* Sleep through the typical conversion time, then poll the rest of it */
+  WAIT_BEGIN(WAIT_BMP280_MEASURE);
+  if (bus == SPI_OK) {
+    uint32_t waited = measTime;
+    Delay_us(waited);
     dataBuf[0] = StatusSensor;
-    SPI_Read(dataBuf, 1);
+    bus = SPI_Read(dataBuf, 1);
+    while ((bus == SPI_OK) && (dataBuf[0] & Measuring)) {
+      /* A floating MISO reads as measuring forever */
+      if (waited >= MeasureTimeout(measTime)) {
+        status = BMX280_ERR_CONV;
+        break;
+      }
+      Delay_us(StatusPoll_us);
+      waited += StatusPoll_us;
+      dataBuf[0] = StatusSensor;
+      bus = SPI_Read(dataBuf, 1);
+    }
   }
+  WAIT_END(WAIT_BMP280_MEASURE);
+  /* Back in sleep mode after a forced conversion */
+  shadow[CtrlMeasure - ShadowBase] &= ~ModeMask;
 
-  Delay(10);
-  dataBuf[0] = CollectData;
-  SPI_Read(dataBuf, 6);
+  if ((bus == SPI_OK) && (status == BMX280_OK)) {
+    dataBuf[0] = CollectData;
+    bus = SPI_Read(dataBuf, 6);
+  }
+  if (bus != SPI_OK) {
+    status = BMX280_ERR_BUS;
+  }
+  TRACE(TRACE_SAMPLE_READY, 0, status);
 
   bmx280.Lock = 0;
+  PROF_EXIT(PROF_BMP280_READ);
+  return (status);
+}
+
+
+
+
+
+/**
+  * @brief  Takes a sample, a failed one gets the bus and the sensor reset
+  *         and is taken again once.
+  * @param  none
+  * @retval BMX280_OK or the error of the last try
+  */
+static BMX280_Status_TypeDef BMP280_Sample(void) {
+  BMX280_Status_TypeDef status = BMP280_Read();
+
+  if (status != BMX280_OK) {
+    TRACE(TRACE_SENSOR_RESET, 0, status);
+    if (BMP280_Recover()) {
+      status = BMP280_Read();
+    }
+  }
+  lastError = status;
+  return (status);
+}
+
+
+
+
+
+/**
+  * @brief  Resets SPI1 and the sensor by its soft reset, then takes the
+  *         identity, calibration and control registers again. It takes
+  *         ResetTime_ms and the Init() reads, a few ms.
+  * @param  none
+  * @retval uint8_t 1 when the sensor is back
+  */
+uint8_t BMP280_Recover(void) {
+  uint8_t reset[2] = { ReserSensor & WriteMask, ResetValue };
+
+  SPI1_Recover();
+  if (SPI_Write(reset, 2) != SPI_OK) {
+    lastError = BMX280_ERR_BUS;
+    return (0);
+  }
+  Delay(ResetTime_ms);
+  return (BMP280_Init());
 }
 
 
@@ -147,20 +279,108 @@ static void BMP280_Read(void) {
 
 
 /**
-  * @brief  Write command to a sensor.
+  * @brief  Error of the last init, recovery or sample.
   * @param  none
+  * @retval BMX280_Status_TypeDef
+  */
+BMX280_Status_TypeDef BMP280_LastError(void) {
+  return (lastError);
+}
+
+
+
+
+
+/**
+  * @brief  Sets oversampling of the following measurements.
+  * @param  temperatureOvs: register code of temperature oversampling, 1..5,
+  *         the temperature is always measured, pressure needs it.
+  * @param  pressureOvs: register code of pressure oversampling, 0..5,
+  *         0 skips the pressure.
+  * @retval uint8_t 1 when the codes were taken
+  */
+uint8_t BMP280_SetOversampling(uint8_t temperatureOvs, uint8_t pressureOvs) {
+  if (!temperatureOvs || (temperatureOvs > OvsMax) || (pressureOvs > OvsMax)) {
+    return (0);
+  }
+
+  ctrlMeas = CtrlMeasWord(temperatureOvs, pressureOvs, ForceMode);
+  measTime = MeasureTime_us(temperatureOvs, pressureOvs);
+  return (1);
+}
+
+
+
+
+
+/**
+  * @brief  Typical measurement time at the current oversampling.
+  * @param  none
+  * @retval uint32_t time, us
+  */
+uint32_t BMP280_MeasureTime(void) {
+  return (measTime);
+}
+
+
+
+
+
+/**
+  * @brief  Trimming parameters read from the sensor NVM.
+  * @param  none
+  * @retval const bmx280_t* calibration, valid after BMP280_Init()
+  */
+const bmx280_t* BMP280_Calibration(void) {
+  return (&bmx280);
+}
+
+
+
+
+
+/**
+  * @brief  Queues a control register write, unless the shadow holds the
+  *         value already. Writes go out in the queued order, ctrl_hum has
+  *         to go before ctrl_meas to take effect.
+  * @param  cmd: control register address, CtrlHumidity..ConfigSensor.
+  * @param  data: register value.
   * @retval none
   */
 static void BMP280_Write(uint8_t cmd, uint8_t data) {
-  bmx280.Lock = 1;
+  uint8_t *reg = &shadow[cmd - ShadowBase];
 
-  dataBuf[0] = cmd & WriteMask;
-  dataBuf[1] = data;
-  
-  SPI_Write(dataBuf, 2);
-  Delay(1);
+  if (shadowValid && (*reg == data)) {
+    return;
+  }
 
-  bmx280.Lock = 0;
+  writeBuf[writeLen++] = cmd & WriteMask;
+  writeBuf[writeLen++] = data;
+  *reg = data;
+}
+
+
+
+
+
+/**
+  * @brief  Sends the queued writes in one transaction. The sensor takes
+  *         a write at the chip select rise, no delay is needed after it.
+  *         The shadow isn't trusted after a failed write.
+  * @param  none
+  * @retval SPI_Status_TypeDef
+  */
+static SPI_Status_TypeDef BMP280_Commit(void) {
+  SPI_Status_TypeDef status = SPI_OK;
+
+  if (writeLen) {
+    status = SPI_Write(writeBuf, writeLen);
+    writeLen = 0;
+  }
+  if (status != SPI_OK) {
+    shadowValid = 0;
+  }
+  return (status);
 }
 
 
@@ -168,18 +388,57 @@ static void BMP280_Write(uint8_t cmd, uint8_t data) {
 
 
 
+/**
+  * @brief  Takes a sample, compensates temperature and pressure and publishes
+  *         them together, readers take them by Sample_Latest().
+  * @param  none
+  * @retval BMX280_OK or the error of the sample
+  */
+BMX280_Status_TypeDef BMP280_Measure(void) {
+  Sample_TypeDef sample;
+  BMP280_S32_t tmp_T;
+  BMP280_S32_t tmp_P;
+
+  if (BMP280_Sample() != BMX280_OK) {
+    return (lastError);
+  }
+
+  tmp_P = ((dataBuf[0] << 16) | (dataBuf[1] << 8) | dataBuf[2]) >> 4;
+  tmp_T = ((dataBuf[3] << 16) | (dataBuf[4] << 8) | dataBuf[5]) >> 4;
+
+  PROF_ENTER(PROF_COMPENSATE_T);
+  sample.temperature = bmp280_compensate_T_int32(&bmx280, tmp_T, &t_fine);
+  PROF_EXIT(PROF_COMPENSATE_T);
+  PROF_ENTER(PROF_COMPENSATE_P);
+  sample.pressure = bmp280_compensate_P_int32(&bmx280, tmp_P, t_fine);
+  PROF_EXIT(PROF_COMPENSATE_P);
+  sample.time = (uint32_t)Clock_Millis();
+
+  Sample_Publish(&sample);
+  return (BMX280_OK);
+}
+
+
+
+
+
 /**
   * @brief  Convert temperature into human readable format.
   * @param  none
-  * @retval pointer to variable with converted temperature.
+  * @retval pointer to variable with converted temperature, NULL when the
+  *         sample failed, see BMP280_LastError().
   */
 BMP280_S32_t* BMP280_ReadT(void) {
-  BMP280_Read();
+  if (BMP280_Sample() != BMX280_OK) {
+    return (NULL);
+  }
 
   BMP280_S32_t tmp_T = 0;
   tmp_T = ((dataBuf[3] << 16) | (dataBuf[4] << 8) | dataBuf[5]) >> 4;
 
-  temperature = bmp280_compensate_T_int32(tmp_T);
+  PROF_ENTER(PROF_COMPENSATE_T);
+  temperature = bmp280_compensate_T_int32(&bmx280, tmp_T, &t_fine);
+  PROF_EXIT(PROF_COMPENSATE_T);
 
   return (&temperature);
 }
@@ -191,14 +450,21 @@ BMP280_S32_t* BMP280_ReadT(void) {
 /**
   * @brief  Convert pressure into human readable format.
   * @param  none
-  * @retval pointer to variable with converted pressure.
+  * @retval pointer to variable with converted pressure, NULL when the
+  *         sample failed.
   */
 BMP280_U32_t* BMP280_ReadP(void) {
   BMP280_S32_t tmp_P = 0;
 
+  if (lastError != BMX280_OK) {
+    return (NULL);
+  }
+
   if (t_fine) {
     tmp_P = ((dataBuf[0] << 16) | (dataBuf[1] << 8) | dataBuf[2]) >> 4;
-    pressure = bmp280_compensate_P_int32(tmp_P);
+    PROF_ENTER(PROF_COMPENSATE_P);
+    pressure = bmp280_compensate_P_int32(&bmx280, tmp_P, t_fine);
+    PROF_EXIT(PROF_COMPENSATE_P);
   }
 
   return (&pressure);
@@ -209,21 +475,24 @@ BMP280_U32_t* BMP280_ReadP(void) {
 
 
 
+#ifdef BMX280_PRECISE
 /**
   * @brief  Convert precise temperature into human readable format.
   * @param  none
-  * @retval pointer to variable with converted temperature.
+  * @retval pointer to variable with converted temperature, NULL when the
+  *         sample failed.
   */
-double* BMP280_ReadPT(void) {
-  BMP280_Read();
-  
-  double tmp_T = 0;
-
-  if (t_fine) {
-    tmp_T = ((dataBuf[4] << 16) | (dataBuf[5] << 8) | dataBuf[6]) >> 4;
-    preciseTemperature = bmp280_compensate_T_double(tmp_T);
+double* BMP280_ReadTP(void) {
+  if (BMP280_Sample() != BMX280_OK) {
+    return (NULL);
   }
 
+  BMP280_S32_t tmp_T = ((dataBuf[3] << 16) | (dataBuf[4] << 8) | dataBuf[5]) >> 4;
+
+  PROF_ENTER(PROF_COMPENSATE_T);
+  preciseTemperature = bmp280_compensate_T_double(&bmx280, tmp_T, &t_fine);
+  PROF_EXIT(PROF_COMPENSATE_T);
+
   return (&preciseTemperature);
 }
 
@@ -234,93 +503,24 @@ double* BMP280_ReadPT(void) {
 /**
   * @brief  Convert precise pressure into human readable format.
   * @param  none
-  * @retval pointer to variable with converted pressure.
+  * @retval pointer to variable with converted pressure, NULL when the
+  *         sample failed.
   */
 double* BMP280_ReadPP(void) {
-  double tmp_P = 0;
+  BMP280_S32_t tmp_P = 0;
 
-  if (t_fine) {
-    tmp_P = ((dataBuf[1] << 16) | (dataBuf[2] << 8) | dataBuf[3]) >> 4;
-    precisePressure = bmp280_compensate_P_double(tmp_P);
+  if (lastError != BMX280_OK) {
+    return (NULL);
   }
 
-  return (&precisePressure);
-}
-
-
-
-/* ------------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------------- */
-/*
-  Here is a bunch of functions provided by Bosch sensor engineering 
-  and proposed by BMP280 datasheet. They were set here with minory 
-  changed. The logic was kept.
-*/
-static double bmp280_compensate_T_double(BMP280_S32_t adc_T) {
-  double var1, var2, T;
-  var1 = (((double)adc_T) / 16384.0 - ((double)bmx280.T1) / 1024.0) * ((double)bmx280.T2);
-  var2 = ((((double)adc_T) / 131072.0 - ((double)bmx280.T1) / 8192.0) * (((double)adc_T) / 131072.0 - ((double)bmx280.T1) / 8192.0)) * ((double)bmx280.T3);
-  t_fine = (BMP280_S32_t)(var1 + var2);
-  T = (var1 + var2) / 5120.0;
-  return (T);
-}
-
-// Returns pressure in Pa as double. Output value of “96386.2” equals 96386.2 Pa = 963.862 hPa
-static double bmp280_compensate_P_double(BMP280_S32_t adc_P) {
-  double var1, var2, p;
-  var1 = ((double)t_fine / 2.0) - 64000.0;
-  var2 = var1 * var1 * ((double)bmx280.P6) / 32768.0;
-  var2 = var2 + var1 * ((double)bmx280.P5) * 2.0;
-  var2 = (var2 / 4.0) + (((double)bmx280.P4) * 65536.0);
-  var1 = (((double)bmx280.P3) * var1 * var1 / 524288.0 + ((double)bmx280.P2) * var1) / 524288.0;
-  var1 = (1.0 + var1 / 32768.0) * ((double)bmx280.P1);
-  if (var1 == 0.0) {
-    return (0); // avoid exception caused by division by zero
+  if (t_fine) {
+    tmp_P = ((dataBuf[0] << 16) | (dataBuf[1] << 8) | dataBuf[2]) >> 4;
+    PROF_ENTER(PROF_COMPENSATE_P);
+    precisePressure = bmp280_compensate_P_double(&bmx280, tmp_P, t_fine);
+    PROF_EXIT(PROF_COMPENSATE_P);
   }
-  p = 1048576.0 - (double)adc_P;
-  p = (p - (var2 / 4096.0)) * 6250.0 / var1;
-  var1 = ((double)bmx280.P9) * p * p / 2147483648.0;
-  var2 = p * ((double)bmx280.P8) / 32768.0;
-  p = p + (var1 + var2 + ((double)bmx280.P7)) / 16.0;
-  return (p);
-}
-
-// Returns temperature in DegC, resolution is 0.01 DegC. Output value of “5123” equals 51.23 DegC.
-// t_fine carries fine temperature as global value
-static BMP280_S32_t bmp280_compensate_T_int32(BMP280_S32_t adc_T) {
-  BMP280_S32_t var1, var2, T;
-  var1 = ((((adc_T >> 3) - ((BMP280_S32_t)bmx280.T1 << 1))) * ((BMP280_S32_t)bmx280.T2)) >> 11;
-  var2 = (((((adc_T >> 4) - ((BMP280_S32_t)bmx280.T1)) * ((adc_T >> 4) - ((BMP280_S32_t)bmx280.T1))) >> 12) * ((BMP280_S32_t)bmx280.T3)) >> 14;
-  t_fine = var1 + var2;
-  T = (t_fine * 5 + 128) >> 8;
-  return (T);
-}
 
-// Returns pressure in Pa as unsigned 32 bit integer. Output value of “96386” equals 96386 Pa = 963.86 hPa
-static BMP280_U32_t bmp280_compensate_P_int32(BMP280_S32_t adc_P) {
-  BMP280_S32_t var1, var2;
-  BMP280_U32_t p;
-  var1 = (((BMP280_S32_t)t_fine) >> 1) - (BMP280_S32_t)64000;
-  var2 = (((var1 >> 2) * (var1 >> 2)) >> 11 ) * ((BMP280_S32_t)bmx280.P6);
-  var2 = var2 + ((var1 * ((BMP280_S32_t)bmx280.P5)) << 1);
-  var2 = (var2 >> 2) + (((BMP280_S32_t)bmx280.P4) << 16);
-  var1 = (((bmx280.P3 * (((var1 >> 2) * (var1 >> 2)) >> 13 )) >> 3) + ((((BMP280_S32_t)bmx280.P2) * var1) >> 1)) >> 18;
-  var1 = ((((32768 + var1)) * ((BMP280_S32_t)bmx280.P1)) >> 15);
-  if (var1 == 0) {
-    return (0); // avoid exception caused by division by zero
-  }
-  p = (((BMP280_U32_t)(((BMP280_S32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
-  if (p < 0x80000000) {
-    p = (p << 1) / ((BMP280_U32_t)var1);
-  } else {
-    p = (p / (BMP280_U32_t)var1) * 2;
-  }
-  var1 = (((BMP280_S32_t)bmx280.P9) * ((BMP280_S32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
-  var2 = (((BMP280_S32_t)(p >> 2)) * ((BMP280_S32_t)bmx280.P8)) >> 13;
-  p = (BMP280_U32_t)((BMP280_S32_t)p + ((var1 + var2 + bmx280.P7) >> 4));
-  return (p);
+  return (&precisePressure);
 }
-/* ------------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------------- */
-/* ------------------------------------------------------------------------------- */
+#endif /* BMX280_PRECISE */
+#endif /* BMX280_CPP */
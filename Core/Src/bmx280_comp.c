@@ -0,0 +1,175 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_comp.c
+  * Description        : This file provides the BMx280 compensation formulas.
+  *                      It's built by the host tools too, see
+  *                      Tools/compcheck.cpp.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "bmx280_comp.h"
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* ------------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------------- */
+/*
+  Here is a bunch of functions provided by Bosch sensor engineering
+  and proposed by BMP280 datasheet. They were set here with minory
+  changed. The logic was kept. Calibration data and t_fine are passed
+  in instead of the globals.
+*/
+double bmp280_compensate_T_double(const bmx280_t *cal, BMP280_S32_t adc_T, BMP280_S32_t *t_fine) {
+  double var1, var2, T;
+  var1 = (((double)adc_T) / 16384.0 - ((double)cal->T1) / 1024.0) * ((double)cal->T2);
+  var2 = ((((double)adc_T) / 131072.0 - ((double)cal->T1) / 8192.0) * (((double)adc_T) / 131072.0 - ((double)cal->T1) / 8192.0)) * ((double)cal->T3);
+  *t_fine = (BMP280_S32_t)(var1 + var2);
+  T = (var1 + var2) / 5120.0;
+  return (T);
+}
+
+// Returns pressure in Pa as double. Output value of “96386.2” equals 96386.2 Pa = 963.862 hPa
+double bmp280_compensate_P_double(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine) {
+  double var1, var2, p;
+  var1 = ((double)t_fine / 2.0) - 64000.0;
+  var2 = var1 * var1 * ((double)cal->P6) / 32768.0;
+  var2 = var2 + var1 * ((double)cal->P5) * 2.0;
+  var2 = (var2 / 4.0) + (((double)cal->P4) * 65536.0);
+  var1 = (((double)cal->P3) * var1 * var1 / 524288.0 + ((double)cal->P2) * var1) / 524288.0;
+  var1 = (1.0 + var1 / 32768.0) * ((double)cal->P1);
+  if (var1 == 0.0) {
+    return (0); // avoid exception caused by division by zero
+  }
+  p = 1048576.0 - (double)adc_P;
+  p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+  var1 = ((double)cal->P9) * p * p / 2147483648.0;
+  var2 = p * ((double)cal->P8) / 32768.0;
+  p = p + (var1 + var2 + ((double)cal->P7)) / 16.0;
+  return (p);
+}
+
+// Returns temperature in DegC, resolution is 0.01 DegC. Output value of “5123” equals 51.23 DegC.
+// t_fine carries fine temperature to the pressure compensation
+BMP280_S32_t bmp280_compensate_T_int32(const bmx280_t *cal, BMP280_S32_t adc_T, BMP280_S32_t *t_fine) {
+  BMP280_S32_t var1, var2, T;
+  var1 = ((((adc_T >> 3) - ((BMP280_S32_t)cal->T1 << 1))) * ((BMP280_S32_t)cal->T2)) >> 11;
+  var2 = (((((adc_T >> 4) - ((BMP280_S32_t)cal->T1)) * ((adc_T >> 4) - ((BMP280_S32_t)cal->T1))) >> 12) * ((BMP280_S32_t)cal->T3)) >> 14;
+  *t_fine = var1 + var2;
+  T = (*t_fine * 5 + 128) >> 8;
+  return (T);
+}
+
+// Returns pressure in Pa as unsigned 32 bit integer. Output value of “96386” equals 96386 Pa = 963.86 hPa
+BMP280_U32_t bmp280_compensate_P_int32(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine) {
+  BMP280_S32_t var1, var2;
+  BMP280_U32_t p;
+  var1 = (((BMP280_S32_t)t_fine) >> 1) - (BMP280_S32_t)64000;
+  var2 = (((var1 >> 2) * (var1 >> 2)) >> 11 ) * ((BMP280_S32_t)cal->P6);
+  var2 = var2 + ((var1 * ((BMP280_S32_t)cal->P5)) << 1);
+  var2 = (var2 >> 2) + (((BMP280_S32_t)cal->P4) << 16);
+  var1 = (((cal->P3 * (((var1 >> 2) * (var1 >> 2)) >> 13 )) >> 3) + ((((BMP280_S32_t)cal->P2) * var1) >> 1)) >> 18;
+  var1 = ((((32768 + var1)) * ((BMP280_S32_t)cal->P1)) >> 15);
+  if (var1 == 0) {
+    return (0); // avoid exception caused by division by zero
+  }
+  p = (((BMP280_U32_t)(((BMP280_S32_t)1048576) - adc_P) - (var2 >> 12))) * 3125;
+  if (p < 0x80000000) {
+    p = (p << 1) / ((BMP280_U32_t)var1);
+  } else {
+    p = (p / (BMP280_U32_t)var1) * 2;
+  }
+  var1 = (((BMP280_S32_t)cal->P9) * ((BMP280_S32_t)(((p >> 3) * (p >> 3)) >> 13))) >> 12;
+  var2 = (((BMP280_S32_t)(p >> 2)) * ((BMP280_S32_t)cal->P8)) >> 13;
+  p = (BMP280_U32_t)((BMP280_S32_t)p + ((var1 + var2 + cal->P7) >> 4));
+  return (p);
+}
+
+// Returns pressure in Pa as unsigned 32 bit integer in Q24.8 format (24 integer bits and 8 fractional bits).
+// Output value of “24674867” represents 24674867/256 = 96386.2 Pa = 963.862 hPa
+BMP280_U32_t bmp280_compensate_P_int64(const bmx280_t *cal, BMP280_S32_t adc_P, BMP280_S32_t t_fine) {
+  BMP280_S64_t var1, var2, p;
+  var1 = ((BMP280_S64_t)t_fine) - 128000;
+  var2 = var1 * var1 * (BMP280_S64_t)cal->P6;
+  var2 = var2 + ((var1 * (BMP280_S64_t)cal->P5) << 17);
+  var2 = var2 + (((BMP280_S64_t)cal->P4) << 35);
+  var1 = ((var1 * var1 * (BMP280_S64_t)cal->P3) >> 8) + ((var1 * (BMP280_S64_t)cal->P2) << 12);
+  var1 = (((((BMP280_S64_t)1) << 47) + var1)) * ((BMP280_S64_t)cal->P1) >> 33;
+  if (var1 == 0) {
+    return (0); // avoid exception caused by division by zero
+  }
+  p = 1048576 - adc_P;
+  p = (((p << 31) - var2) * 3125) / var1;
+  var1 = (((BMP280_S64_t)cal->P9) * (p >> 13) * (p >> 13)) >> 25;
+  var2 = (((BMP280_S64_t)cal->P8) * p) >> 19;
+  p = ((p + var1 + var2) >> 8) + (((BMP280_S64_t)cal->P7) << 4);
+  return ((BMP280_U32_t)p);
+}
+/* ------------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------------- */
+/* ------------------------------------------------------------------------------- */
+
+
+
+
+
+/**
+  * @brief  Compensates a batch of raw samples in place. Calibration is loaded
+  *         once, not for every sample, the formulas are those of
+  *         bmp280_compensate_T_int32() and bmp280_compensate_P_int32().
+  * @param  cal: calibration data.
+  * @param  t: adc_T values, replaced with temperatures, 0.01 DegC.
+  * @param  p: adc_P values, replaced with pressures, Pa. Could be null,
+  *         then only temperatures are done.
+  * @param  count: count of samples.
+  * @retval none
+  */
+void bmp280_compensate_TP_int32_batch(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count) {
+  const BMP280_S32_t T1 = cal->T1, T2 = cal->T2, T3 = cal->T3;
+  const BMP280_S32_t P1 = cal->P1, P2 = cal->P2, P3 = cal->P3, P4 = cal->P4, P5 = cal->P5;
+  const BMP280_S32_t P6 = cal->P6, P7 = cal->P7, P8 = cal->P8, P9 = cal->P9;
+  BMP280_S32_t adc, var1, var2, t_fine;
+  BMP280_U32_t pres;
+
+  for (uint32_t i = 0; i < count; i++) {
+    adc = t[i];
+    var1 = ((((adc >> 3) - (T1 << 1))) * T2) >> 11;
+    var2 = (((((adc >> 4) - T1) * ((adc >> 4) - T1)) >> 12) * T3) >> 14;
+    t_fine = var1 + var2;
+    t[i] = (t_fine * 5 + 128) >> 8;
+
+    if (!p) continue;
+
+    var1 = (t_fine >> 1) - (BMP280_S32_t)64000;
+    var2 = (((var1 >> 2) * (var1 >> 2)) >> 11 ) * P6;
+    var2 = var2 + ((var1 * P5) << 1);
+    var2 = (var2 >> 2) + (P4 << 16);
+    var1 = (((P3 * (((var1 >> 2) * (var1 >> 2)) >> 13 )) >> 3) + ((P2 * var1) >> 1)) >> 18;
+    var1 = ((((32768 + var1)) * P1) >> 15);
+    if (var1 == 0) {
+      p[i] = 0;
+      continue;
+    }
+    pres = (((BMP280_U32_t)(((BMP280_S32_t)1048576) - (BMP280_S32_t)p[i]) - (var2 >> 12))) * 3125;
+    if (pres < 0x80000000) {
+      pres = (pres << 1) / ((BMP280_U32_t)var1);
+    } else {
+      pres = (pres / (BMP280_U32_t)var1) * 2;
+    }
+    var1 = (P9 * ((BMP280_S32_t)(((pres >> 3) * (pres >> 3)) >> 13))) >> 12;
+    var2 = (((BMP280_S32_t)(pres >> 2)) * P8) >> 13;
+    p[i] = (BMP280_U32_t)((BMP280_S32_t)pres + ((var1 + var2 + P7) >> 4));
+  }
+}
@@ -0,0 +1,65 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_cpp.cpp
+  * Description        : bmx280.hpp driver on the board: SPI1, NSS_0 pin and
+  *                      the 32-bit kernels. It gives main.c and console.c
+  *                      the bmx280.h functions in place of bmp280.c with
+  *                      BMX280_CPP defined in config.h. BMP280_ReadT() and
+  *                      the other pointer returning reads aren't given,
+  *                      samples are taken by BMP280_Measure().
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "bmx280.hpp"
+
+#ifdef BMX280_CPP
+#ifdef BMX280_BME
+  typedef bmx::Bme280 Variant;
+#else
+  typedef bmx::Bmp280 Variant;
+#endif /* BMX280_BME */
+
+typedef bmx::Bmx280<bmx::Spi1Bus, bmx::ChipSelect<GPIOA_BASE, NSS_0_Pin>, Variant> Sensor;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+uint8_t BMP280_Init(void) {
+  return (Sensor::Init());
+}
+
+uint8_t BMP280_Recover(void) {
+  return (Sensor::Recover());
+}
+
+BMX280_Status_TypeDef BMP280_LastError(void) {
+  return (Sensor::LastError());
+}
+
+BMX280_Status_TypeDef BMP280_Measure(void) {
+  return (Sensor::Measure());
+}
+
+uint8_t BMP280_SetOversampling(uint8_t temperatureOvs, uint8_t pressureOvs) {
+  return (Sensor::SetOversampling(temperatureOvs, pressureOvs));
+}
+
+uint32_t BMP280_MeasureTime(void) {
+  return (Sensor::MeasureTime());
+}
+
+const bmx280_t* BMP280_Calibration(void) {
+  return (&Sensor::Calibration());
+}
+#endif /* BMX280_CPP */
@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * File Name          : clock.c
+  * Description        : This file provides code for the monotonic system
+  *                      clock. SysTick interrupt counts 64-bit quanta in
+  *                      sysQuantum, microseconds are taken from SysTick->VAL.
+  *                      Read-out is safe from both thread and ISR context,
+  *                      even with interrupts disabled.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "clock.h"
+
+/* Global variables ---------------------------------------------------------*/
+volatile uint64_t sysQuantum = 0;
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t cyclesPerUs = 8;
+static uint32_t advanceRemainder = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+__STATIC_INLINE uint64_t Clock_Snapshot(uint32_t *val);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Starts SysTick on CLOCK_TICK_FREQ. It has to be called after
+  *         SystemCoreClock is settled.
+  * @param  none
+  * @retval none
+  */
+void Clock_Init(void) {
+  cyclesPerUs = SystemCoreClock / 1000000U;
+
+  SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+  SysTick->LOAD  = (SystemCoreClock / CLOCK_TICK_FREQ) - 1U;
+  SysTick->VAL   = 0U;
+  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+  NVIC_SetPriority(SysTick_IRQn, 0);
+}
+
+
+
+
+
+/**
+  * @brief  Takes consistent quanta count and SysTick counter. When SysTick has
+  *         wrapped but its interrupt isn't served yet (interrupts are disabled
+  *         by a caller, or it's called from an ISR), the pending quantum is
+  *         counted and the counter is re-read after the wrap.
+  * @param  val: pointer where SysTick->VAL to be placed.
+  * @retval Quanta count.
+  */
+__STATIC_INLINE uint64_t Clock_Snapshot(uint32_t *val) {
+  uint32_t primask = __get_PRIMASK();
+  uint64_t ticks;
+
+  __disable_irq();
+  ticks = sysQuantum;
+  *val = SysTick->VAL;
+  if (READ_BIT(SCB->ICSR, SCB_ICSR_PENDSTSET_Msk)) {
+    *val = SysTick->VAL;
+    ticks++;
+  }
+  __set_PRIMASK(primask);
+
+  return (ticks);
+}
+
+
+
+
+
+/**
+  * @brief  Returns milliseconds since start.
+  * @param  none
+  * @retval Milliseconds.
+  */
+uint64_t Clock_Millis(void) {
+  uint32_t val;
+  return ((Clock_Snapshot(&val) * 1000U) / CLOCK_TICK_FREQ);
+}
+
+
+
+
+
+/**
+  * @brief  Returns microseconds since start.
+  * @param  none
+  * @retval Microseconds.
+  */
+uint64_t Clock_Micros(void) {
+  uint32_t val;
+  uint64_t ticks = Clock_Snapshot(&val);
+
+  return ((ticks * CLOCK_TICK_US) + ((SysTick->LOAD - val) / cyclesPerUs));
+}
+
+
+
+
+
+/**
+  * @brief  Adds time, the clock missed while SysTick was stopped, e.g. in
+  *         Stop mode. The part shorter than a quantum is carried over.
+  * @param  us: missed time, us.
+  * @retval none
+  */
+void Clock_Advance(uint32_t us) {
+  uint32_t primask = __get_PRIMASK();
+
+  us += advanceRemainder;
+  advanceRemainder = us % CLOCK_TICK_US;
+
+  __disable_irq();
+  sysQuantum += (us / CLOCK_TICK_US);
+  __set_PRIMASK(primask);
+}
@@ -33,7 +33,7 @@ __STATIC_INLINE void _putc(uint8_t ch);
   */
 void Error_Handler(void) {
   while (1) {
-    //
+    WAIT_POLL();
   }
 }
 
@@ -67,8 +67,7 @@ __STATIC_INLINE void _putc(uint8_t ch) {
   if (ch == '\n') _putc('\r');
 
   #ifdef SWO_USART
-    USART1->TDR = ch;
-    while (READ_BIT(USART1->ISR, USART_ISR_TXE) != USART_ISR_TXE);
+    USART1_TX_Put(ch);
   #endif
 }
 
@@ -83,9 +82,12 @@ __STATIC_INLINE void _putc(uint8_t ch) {
   * @retval length of the array. 
   */
 int _write(int32_t file, char *ptr, int32_t len) {
+  PROF_ENTER(PROF_WRITE);
+  TRACE(TRACE_UART_QUEUED, 0, len);
   for(int32_t i = 0 ; i < len ; i++) {
     _putc(*ptr++);  
   }
+  PROF_EXIT(PROF_WRITE);
 	return len;
 }
 
@@ -0,0 +1,367 @@
+/**
+  ******************************************************************************
+  * File Name          : console.c
+  * Description        : This file provides code for the command console
+  *                      over USART1. Commands are text lines terminated
+  *                      by CR or LF:
+  *                        baud <rate> [8] - set baud rate, 8 means 8x oversampling
+  *                        bench [bytes]   - measure sustained TX throughput
+  *                        tasks           - scheduler task statistics
+  *                        idle            - idle time of the last second
+  *                        lp [on|off]     - Stop mode duty cycling
+  *                        ovs [<t> <p>]   - sensor oversampling codes,
+  *                                          t 1..5, p 0..5
+  *                        power           - power state time budget
+  *                        prof [reset]    - cycle profiler probes, PROFILE
+  *                        status          - busy-wait and loop accounting,
+  *                                          WAIT_STATS
+  *                        trace           - binary event trace dump, TRACE_ON
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "console.h"
+
+/* Private variables ---------------------------------------------------------*/
+static char cmdBuf[CMDBUF_LEN];
+static uint8_t cmdLen = 0;
+
+/* 63 printable symbols and LF, it's 65 bytes on the wire */
+static const char benchLine[BENCH_LINE_LEN] =
+  "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz!\n";
+
+/* Private function prototypes -----------------------------------------------*/
+static void Console_Exec(char *cmd);
+static char* Console_ParseU32(char *str, uint32_t *val);
+static void Console_Baud(char *args);
+static void Console_Bench(char *args);
+static void Console_Tasks(void);
+static void Console_Idle(void);
+static void Console_LowPower(char *args);
+static void Console_Oversampling(char *args);
+static void Console_Calibration(void);
+static void Console_Power(void);
+#ifdef PROFILE
+static void Console_Prof(char *args);
+#endif /* PROFILE */
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Collects received symbols into a command line and runs
+  *         the command when the line is terminated.
+  * @param  none
+  * @retval none
+  */
+void Console_Handler(void) {
+  uint8_t ch;
+
+  Power_Hold(POWER_HOLD_MS);
+
+  while (USART_RxBufferRead(&ch, 1)) {
+    if ((ch == '\r') || (ch == '\n')) {
+      if (cmdLen) {
+        cmdBuf[cmdLen] = 0;
+        Console_Exec(cmdBuf);
+        cmdLen = 0;
+      }
+    } else if (cmdLen < (CMDBUF_LEN - 1)) {
+      cmdBuf[(cmdLen++)] = (char)ch;
+    }
+  }
+}
+
+
+
+
+
+
+/**
+  * @brief  Dispatches a command line.
+  * @param  cmd: null terminated command line.
+  * @retval none
+  */
+static void Console_Exec(char *cmd) {
+  char *args = cmd;
+
+  while ((*args != ' ') && (*args != 0)) args++;
+  if (*args) *args++ = 0;
+
+  if (!strcmp(cmd, "baud")) {
+    Console_Baud(args);
+  } else if (!strcmp(cmd, "bench")) {
+    Console_Bench(args);
+  } else if (!strcmp(cmd, "tasks")) {
+    Console_Tasks();
+  } else if (!strcmp(cmd, "idle")) {
+    Console_Idle();
+  } else if (!strcmp(cmd, "lp")) {
+    Console_LowPower(args);
+  } else if (!strcmp(cmd, "ovs")) {
+    Console_Oversampling(args);
+  } else if (!strcmp(cmd, "calib")) {
+    Console_Calibration();
+  } else if (!strcmp(cmd, "power")) {
+    Console_Power();
+#ifdef PROFILE
+  } else if (!strcmp(cmd, "prof")) {
+    Console_Prof(args);
+#endif /* PROFILE */
+#ifdef WAIT_STATS
+  } else if (!strcmp(cmd, "status")) {
+    Wait_Report();
+#endif /* WAIT_STATS */
+#ifdef TRACE_ON
+  } else if (!strcmp(cmd, "trace")) {
+    Trace_Dump();
+#endif /* TRACE_ON */
+  } else {
+    LOG("unknown command\n");
+  }
+}
+
+
+
+
+
+
+/**
+  * @brief  Parses an unsigned decimal number.
+  * @param  str: pointer to the string, leading spaces are skipped.
+  * @param  val: pointer where the number to be placed, it's left untouched
+  *         when there are no digits.
+  * @retval Pointer to the rest of the string.
+  */
+static char* Console_ParseU32(char *str, uint32_t *val) {
+  uint32_t tmp = 0;
+
+  while (*str == ' ') str++;
+  if ((*str < '0') || (*str > '9')) return (str);
+
+  while ((*str >= '0') && (*str <= '9')) {
+    tmp = (tmp * 10U) + (uint32_t)(*str++ - '0');
+  }
+  *val = tmp;
+  return (str);
+}
+
+
+
+
+
+
+/**
+  * @brief  "baud <rate> [8]" command. The answer is sent on the old rate.
+  * @param  args: command arguments.
+  * @retval none
+  */
+static void Console_Baud(char *args) {
+  uint32_t baudRate = 0;
+  uint32_t over = 16;
+  uint16_t brr = 0;
+  int32_t err = 0;
+
+  args = Console_ParseU32(args, &baudRate);
+  Console_ParseU32(args, &over);
+
+  if (!USART1_CalcBRR(baudRate, (over == 8), &brr, &err)) {
+    LOG("baud: %" PRIu32 " x%" PRIu32 " unreachable, err %" PRIi32 " ppm\n", baudRate, over, err);
+    return;
+  }
+
+  LOG("baud: %" PRIu32 " x%" PRIu32 " brr 0x%04x err %" PRIi32 " ppm\n", baudRate, over, brr, err);
+  USART1_SetBaudRate(baudRate, (over == 8), 0);
+}
+
+
+
+
+
+
+/**
+  * @brief  "bench [bytes]" command. Pushes test lines through the _write()
+  *         TX path and measures sustained throughput by the monotonic clock.
+  * @param  args: command arguments.
+  * @retval none
+  */
+static void Console_Bench(char *args) {
+  uint32_t bytes = BENCH_DEFAULT_LEN;
+  uint32_t baudRate = USART1_GetBaudRate();
+  uint32_t lines, wire, us, rate;
+  uint64_t start;
+
+  Console_ParseU32(args, &bytes);
+  if (bytes > BENCH_MAX_LEN) bytes = BENCH_MAX_LEN;
+
+  lines = (bytes + BENCH_LINE_LEN - 1) / BENCH_LINE_LEN;
+  if (!lines) lines = 1;
+  /* LF is expanded to CR LF by _putc() */
+  wire = lines * (BENCH_LINE_LEN + 1);
+
+  /* Drain the output before start */
+  USART1_TX_Flush();
+  start = Clock_Micros();
+
+  while (lines--) {
+    _write(1, (char*)benchLine, BENCH_LINE_LEN);
+    IWDG->KR = IWDG_KEY_RELOAD;
+  }
+
+  USART1_TX_Flush();
+  us = (uint32_t)(Clock_Micros() - start);
+  if (!us) us = 1;
+
+  rate = (uint32_t)(((uint64_t)wire * 1000000U) / us);
+  LOG("bench: %" PRIu32 " B in %" PRIu32 " us, %" PRIu32 " B/s, %" PRIu32 "%% of %" PRIu32 " line rate\n",
+    wire, us, rate, (rate * 1000U) / baudRate, baudRate / 10U);
+}
+
+
+
+
+
+
+/**
+  * @brief  "tasks" command. Tasks are listed from the last registered one.
+  * @param  none
+  * @retval none
+  */
+static void Console_Tasks(void) {
+  for (Sched_Task_TypeDef *task = Sched_Tasks(); task; task = task->link) {
+    LOG("task %u: prio %u period %" PRIu32 " runs %" PRIu32 " missed %" PRIu32 "\n",
+      task->id, task->prio, task->period, task->runs, task->missed);
+  }
+}
+
+
+
+
+
+
+/**
+  * @brief  "idle" command. Share of the last second the core slept in WFI.
+  * @param  none
+  * @retval none
+  */
+static void Console_Idle(void) {
+  uint32_t idle = Sleep_IdlePermille();
+
+  LOG("idle: %" PRIu32 ".%" PRIu32 "%%\n", idle / 10U, idle % 10U);
+}
+
+
+
+
+
+
+/**
+  * @brief  "lp [on|off]" command.
+  * @param  args: command arguments.
+  * @retval none
+  */
+static void Console_LowPower(char *args) {
+  while (*args == ' ') args++;
+
+  if (!strcmp(args, "on")) {
+    Power_SetLowPower(1);
+  } else if (!strcmp(args, "off")) {
+    Power_SetLowPower(0);
+  }
+  LOG("lp: %u, lsi %" PRIu32 " Hz\n", Power_GetLowPower(), RTC_LsiFreq());
+}
+
+
+
+
+
+
+/**
+  * @brief  "ovs [<t> <p>]" command. Codes are as in the ctrl_meas register.
+  * @param  args: command arguments.
+  * @retval none
+  */
+static void Console_Oversampling(char *args) {
+  uint32_t t = 0;
+  uint32_t p = 0;
+
+  args = Console_ParseU32(args, &t);
+  Console_ParseU32(args, &p);
+
+  if (t && !BMP280_SetOversampling((uint8_t)t, (uint8_t)p)) {
+    LOG("ovs: t 1..5, p 0..5\n");
+    return;
+  }
+  LOG("ovs: measure %" PRIu32 " us\n", BMP280_MeasureTime());
+}
+
+
+
+
+
+
+/**
+  * @brief  "calib" command. Trimming parameters T1..P9 as a line of the
+  *         Tools/calib.txt corpus of compcheck.
+  * @param  none
+  * @retval none
+  */
+static void Console_Calibration(void) {
+  const bmx280_t *c = BMP280_Calibration();
+
+  /* Deferred LOG() takes 6 arguments at most */
+  LOG("calib: %u %d %d %u %d %d", c->T1, c->T2, c->T3, c->P1, c->P2, c->P3);
+  LOG(" %d %d %d %d %d %d\n", c->P4, c->P5, c->P6, c->P7, c->P8, c->P9);
+}
+
+
+
+
+
+
+/**
+  * @brief  "power" command. Time budget of the last second per power state
+  *         and the average current estimated by typical figures.
+  * @param  none
+  * @retval none
+  */
+static void Console_Power(void) {
+  const Power_Budget_TypeDef *budget = Power_GetBudget();
+
+  LOG("power: run %" PRIu32 " sleep %" PRIu32 " wake %" PRIu32 " stop %" PRIu32 " permille, %" PRIu32 " stops, ~%" PRIu32 " uA\n",
+    budget->permille[POWER_RUN], budget->permille[POWER_SLEEP],
+    budget->permille[POWER_WAKE], budget->permille[POWER_STOP],
+    budget->stops, budget->averageUa);
+}
+
+
+
+
+
+
+#ifdef PROFILE
+/**
+  * @brief  "prof [reset]" command.
+  * @param  args: command arguments.
+  * @retval none
+  */
+static void Console_Prof(char *args) {
+  while (*args == ' ') args++;
+
+  if (!strcmp(args, "reset")) {
+    Prof_Reset();
+  } else {
+    Prof_Dump();
+  }
+}
+#endif /* PROFILE */
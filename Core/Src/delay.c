@@ -0,0 +1,190 @@
+/**
+  ******************************************************************************
+  * File Name          : delay.c
+  * Description        : This file provides code for the delay, timeout
+  *                      and sleep services. Time is counted by the delay
+  *                      timer, so it doesn't depend on flash wait states
+  *                      or optimization level. The core waits in WFI and
+  *                      is woken up by the timer compare, or by any other
+  *                      interrupt. The compare is checked and slept on
+  *                      with interrupts masked, so it can't be missed.
+  *                      Time spent in WFI is accounted as idle.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "delay.h"
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t idleTicks = 0;
+static uint32_t idlePermille = 0;
+static uint64_t windowStart = 0;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Waits for the given milliseconds.
+  * @param  delay: delay in ms.
+  * @retval none
+  */
+void Delay(uint32_t delay) {
+  while (delay--) {
+    Delay_us(1000U);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Waits for the given microseconds sleeping in WFI.
+  * @param  us: delay in us.
+  * @retval none
+  */
+void Delay_us(uint32_t us) {
+  uint32_t primask = __get_PRIMASK();
+  uint16_t last = (uint16_t)DELAY_TIM->CNT;
+  uint16_t now;
+  uint32_t elapsed = 0;
+  uint32_t step;
+
+  WAIT_BEGIN(WAIT_DELAY);
+  while (elapsed < us) {
+    step = us - elapsed;
+    if (step > DELAY_MAX_STEP) step = DELAY_MAX_STEP;
+
+    /* Wake up by compare match at the end of the step */
+    DELAY_TIM->CCR1 = (uint16_t)(last + step);
+    CLEAR_BIT(DELAY_TIM->SR, TIM_SR_CC1IF);
+    SET_BIT(DELAY_TIM->DIER, TIM_DIER_CC1IE);
+
+    /* Don't sleep when the match has gone already. The check and WFI are
+       masked, a match right before WFI still wakes the core up */
+    __disable_irq();
+    now = (uint16_t)DELAY_TIM->CNT;
+    if ((uint16_t)(now - last) < step) {
+      Sleep_Idle();
+      now = (uint16_t)DELAY_TIM->CNT;
+    }
+    __set_PRIMASK(primask);
+
+    elapsed += (uint16_t)(now - last);
+    last = now;
+  }
+
+  CLEAR_BIT(DELAY_TIM->DIER, TIM_DIER_CC1IE);
+  WAIT_END(WAIT_DELAY);
+}
+
+
+
+
+
+/**
+  * @brief  Starts a timeout.
+  * @param  timeout: pointer to the timeout.
+  * @param  us: timeout in us.
+  * @retval none
+  */
+void Timeout_Start(Timeout_TypeDef *timeout, uint32_t us) {
+  timeout->last = (uint16_t)DELAY_TIM->CNT;
+  timeout->elapsed = 0;
+  timeout->limit = us;
+}
+
+
+
+
+
+/**
+  * @brief  Checks a timeout.
+  * @param  timeout: pointer to the timeout.
+  * @retval 1 when the timeout has expired, 0 otherwise.
+  */
+uint8_t Timeout_Expired(Timeout_TypeDef *timeout) {
+  uint16_t now;
+
+  WAIT_POLL();
+  now = (uint16_t)DELAY_TIM->CNT;
+
+  timeout->elapsed += (uint16_t)(now - timeout->last);
+  timeout->last = now;
+
+  return (timeout->elapsed >= timeout->limit);
+}
+
+
+
+
+
+/**
+  * @brief  Sleeps until any interrupt and accounts the time as idle.
+  *         SysTick wakes the core up every millisecond at least.
+  * @param  none
+  * @retval none
+  */
+void Sleep_Idle(void) {
+  uint16_t start = (uint16_t)DELAY_TIM->CNT;
+
+  __WFI();
+
+  idleTicks += (uint16_t)((uint16_t)DELAY_TIM->CNT - start);
+}
+
+
+
+
+
+/**
+  * @brief  Closes the idle time window. It's called once per second.
+  * @param  none
+  * @retval none
+  */
+void Sleep_Snapshot(void) {
+  uint64_t now = Clock_Micros();
+  uint32_t window = (uint32_t)(now - windowStart);
+
+  if (window) {
+    idlePermille = (uint32_t)(((uint64_t)idleTicks * (1000000U / DELAY_TIM_FREQ) * 1000U) / window);
+  }
+  idleTicks = 0;
+  windowStart = now;
+}
+
+
+
+
+
+/**
+  * @brief  Returns idle time share of the last window.
+  * @param  none
+  * @retval Idle time, 1/1000.
+  */
+uint32_t Sleep_IdlePermille(void) {
+  return (idlePermille);
+}
+
+
+
+
+
+/**
+  * @brief  Delay timer compare handler, it only has to wake the core up.
+  * @param  none
+  * @retval none
+  */
+void Delay_Wakeup_Handler(void) {
+  CLEAR_BIT(DELAY_TIM->SR, TIM_SR_CC1IF);
+}
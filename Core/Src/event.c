@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * File Name          : event.c
+  * Description        : This file provides code for the event flag register
+  *                      _EREG_. Cortex-M0 has no exclusive access, so every
+  *                      read-modify-write of the register is done with
+  *                      interrupts masked for a few cycles: FLAG_SET() and
+  *                      FLAG_CLR() in interrupts and threads, Event_Take()
+  *                      to consume flags. Event_Wait() checks flags with
+  *                      interrupts masked and sleeps in the same section,
+  *                      a masked interrupt still wakes the core up, so
+  *                      a flag set right before WFI can't be slept over.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "event.h"
+
+/* Private variables ---------------------------------------------------------*/
+
+/* Private function prototypes -----------------------------------------------*/
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Reads and clears event flags at once.
+  * @param  mask: flags to be taken.
+  * @retval Flags were set.
+  */
+uint32_t Event_Take(uint32_t mask) {
+  uint32_t primask = __get_PRIMASK();
+  uint32_t pending;
+
+  __disable_irq();
+  pending = _EREG_ & mask;
+  _EREG_ &= ~pending;
+  __set_PRIMASK(primask);
+
+  return (pending);
+}
+
+
+
+
+
+/**
+  * @brief  Sleeps until any of the event flags is set. Flags are left set,
+  *         they're consumed by Event_Take().
+  * @param  mask: flags to wait for.
+  * @param  timeout: timeout in ms or EVENT_FOREVER.
+  * @retval Flags were set, 0 on timeout.
+  */
+uint32_t Event_Wait(uint32_t mask, uint32_t timeout) {
+  uint32_t primask = __get_PRIMASK();
+  uint32_t start = (uint32_t)Clock_Millis();
+  uint32_t pending;
+
+  __disable_irq();
+  while (!(pending = _EREG_ & mask)) {
+    if ((timeout != EVENT_FOREVER) && (((uint32_t)Clock_Millis() - start) >= timeout)) break;
+    Sleep_Idle();
+
+    /* Let the wake up interrupt run */
+    __enable_irq();
+    __disable_irq();
+  }
+  __set_PRIMASK(primask);
+
+  return (pending);
+}
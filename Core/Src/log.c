@@ -0,0 +1,215 @@
+/**
+  ******************************************************************************
+  * File Name          : log.c
+  * Description        : This file provides code for the deferred log frames
+  *                      and the integer-only text formatter.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdarg.h>
+#include "log.h"
+
+/* Private function prototypes -----------------------------------------------*/
+static void Log_Frame(uint16_t id, const uint32_t *args, uint8_t nargs);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Assembles a deferred frame and puts it into the TX buffer.
+  * @param  id: format string ID.
+  * @param  args: pointer to the arguments.
+  * @param  nargs: count of the arguments.
+  * @retval none
+  */
+static void Log_Frame(uint16_t id, const uint32_t *args, uint8_t nargs) {
+  uint8_t frame[3 + (LOG_MAX_ARGS * 4)];
+  uint8_t *tmp = frame;
+
+  *tmp++ = LOG_SYNC | nargs;
+  *tmp++ = (uint8_t)id;
+  *tmp++ = (uint8_t)(id >> 8);
+
+  for (uint8_t i = 0; i < nargs; i++) {
+    *tmp++ = (uint8_t)args[i];
+    *tmp++ = (uint8_t)(args[i] >> 8);
+    *tmp++ = (uint8_t)(args[i] >> 16);
+    *tmp++ = (uint8_t)(args[i] >> 24);
+  }
+
+  USART1_TX_Write(frame, (uint16_t)(tmp - frame));
+}
+
+
+
+
+
+/**
+  * @brief  Deferred frame emitters for LOG() with 0...LOG_MAX_ARGS arguments.
+  * @param  id: format string ID.
+  * @param  a0...a5: the arguments.
+  * @retval none
+  */
+void Log_Emit0(uint16_t id) {
+  Log_Frame(id, 0, 0);
+}
+
+void Log_Emit1(uint16_t id, uint32_t a0) {
+  Log_Frame(id, &a0, 1);
+}
+
+void Log_Emit2(uint16_t id, uint32_t a0, uint32_t a1) {
+  uint32_t args[2] = {a0, a1};
+  Log_Frame(id, args, 2);
+}
+
+void Log_Emit3(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2) {
+  uint32_t args[3] = {a0, a1, a2};
+  Log_Frame(id, args, 3);
+}
+
+void Log_Emit4(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3) {
+  uint32_t args[4] = {a0, a1, a2, a3};
+  Log_Frame(id, args, 4);
+}
+
+void Log_Emit5(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4) {
+  uint32_t args[5] = {a0, a1, a2, a3, a4};
+  Log_Frame(id, args, 5);
+}
+
+void Log_Emit6(uint16_t id, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t a3, uint32_t a4, uint32_t a5) {
+  uint32_t args[6] = {a0, a1, a2, a3, a4, a5};
+  Log_Frame(id, args, 6);
+}
+
+
+
+
+
+/**
+  * @brief  printf() for LOG() without newlib stdio. Conversions are d, i, u,
+  *         x, X, c, s and %%, with 0 flag and width for the numbers. The
+  *         target is ILP32, so l and h are taken and skipped. There is no
+  *         floating point.
+  * @param  fmt: format string.
+  * @retval int count of characters sent
+  */
+int Log_Printf(const char *fmt, ...) {
+  char buf[LOG_CHUNK_LEN];
+  char digits[10];
+  uint8_t len = 0;
+  int total = 0;
+  va_list ap;
+
+  #define LOG_PUT(ch) do { \
+      if (len == LOG_CHUNK_LEN) { \
+        total += _write(1, buf, len); \
+        len = 0; \
+      } \
+      buf[len++] = (ch); \
+    } while (0)
+
+  va_start(ap, fmt);
+  while (*fmt) {
+    char ch = *fmt++;
+    if (ch != '%') {
+      LOG_PUT(ch);
+      continue;
+    }
+
+    char pad = ' ';
+    uint8_t width = 0;
+    if (*fmt == '0') {
+      pad = '0';
+      fmt++;
+    }
+    while ((*fmt >= '0') && (*fmt <= '9')) {
+      width = (uint8_t)((width * 10) + (*fmt++ - '0'));
+    }
+    while ((*fmt == 'l') || (*fmt == 'h')) {
+      fmt++;
+    }
+    ch = *fmt;
+    if (!ch) {
+      break;
+    }
+    fmt++;
+
+    uint32_t value;
+    uint32_t base = 10;
+    uint8_t negative = 0;
+    switch (ch) {
+      case 'd':
+      case 'i': {
+        int32_t v = va_arg(ap, int32_t);
+        negative = (v < 0);
+        value = negative ? (0U - (uint32_t)v) : (uint32_t)v;
+      } break;
+
+      case 'u':
+        value = va_arg(ap, uint32_t);
+      break;
+
+      case 'x':
+      case 'X':
+        value = va_arg(ap, uint32_t);
+        base = 16;
+      break;
+
+      case 'c':
+        LOG_PUT((char)va_arg(ap, int));
+      continue;
+
+      case 's': {
+        const char *str = va_arg(ap, const char*);
+        while (*str) {
+          LOG_PUT(*str++);
+        }
+      } continue;
+
+      default:
+        LOG_PUT(ch);
+      continue;
+    }
+
+    uint8_t n = 0;
+    do {
+      uint8_t digit = (uint8_t)(value % base);
+      digits[n++] = (char)((digit < 10) ? ('0' + digit) : (((ch == 'X') ? 'A' : 'a') + digit - 10));
+      value /= base;
+    } while (value);
+
+    width = (width > (n + negative)) ? (uint8_t)(width - n - negative) : 0;
+    if (negative && (pad == '0')) {
+      LOG_PUT('-');
+    }
+    while (width--) {
+      LOG_PUT(pad);
+    }
+    if (negative && (pad == ' ')) {
+      LOG_PUT('-');
+    }
+    while (n) {
+      LOG_PUT(digits[--n]);
+    }
+  }
+  va_end(ap);
+
+  if (len) {
+    total += _write(1, buf, len);
+  }
+  #undef LOG_PUT
+  return (total);
+}
@@ -12,27 +12,21 @@
 #include "main.h"
 
 /* Global variables ---------------------------------------------------------*/
-uint32_t sysQuantum       = 0;
-uint32_t millis           = 0;
-uint32_t seconds          = 0;
-uint32_t minutes          = 0;
-uint32_t _EREG_           = 0;
-uint32_t delay_tmp        = 0;
+volatile uint32_t _EREG_           = 0;
 uint32_t SystemCoreClock  = 16000000;
 
 /* Private variables ---------------------------------------------------------*/
-static uint32_t millis_tmp    = 100;
-static uint32_t seconds_tmp   = 1000;
-static uint32_t minutes_tmp   = 60;
+static Sched_Task_TypeDef consoleTask;
+static Sched_Task_TypeDef watchdogTask;
+static Sched_Task_TypeDef sampleTask;
+static Sched_Task_TypeDef minuteTask;
 
 static uint8_t bmp280_status = 0;
 
 /* Private function prototypes -----------------------------------------------*/
-static void CronSysQuantum_Handler(void);
-static void CronMillis_Handler(void);
-static void CronSeconds_Handler(void);
-static void CronMinutes_Handler(void);
-static void Flags_Handler(void);
+static void Watchdog_Task(void);
+static void Sample_Task(void);
+static void Minute_Task(void);
 
 static void IWDG_Init(void);
 
@@ -49,6 +43,13 @@ static void IWDG_Init(void);
   * @retval int
   */
 int main(void) {
+  #ifdef PROFILE
+    Prof_Init();
+  #endif /* PROFILE */
+  #ifdef WAIT_STATS
+    Wait_Init();
+  #endif /* WAIT_STATS */
+  TIM14_Init();
   Delay(500);
   USART1_Init();
   SPI1_Init();
@@ -56,53 +57,28 @@ int main(void) {
     bmp280_status = 1;
   }
   IWDG_Init();
+  Power_Init();
 
-  while (1) {
-    Delay_Handler(0);
-    Cron_Handler();
-    Flags_Handler();
-  }
-}
+  Sched_Init();
 
+  Sched_Add(&consoleTask, Console_Handler, 0, 0);
+  Sched_Bind(_U1RXF_, &consoleTask);
 
+  Sched_Add(&watchdogTask, Watchdog_Task, 0, 0);
+  Sched_Start(&watchdogTask, 1000, 1000);
 
+  Sched_Add(&sampleTask, Sample_Task, 1, 0);
+  Sched_Start(&sampleTask, 1000, 1000);
 
+  Sched_Add(&minuteTask, Minute_Task, 3, 0);
+  Sched_Start(&minuteTask, 60000, 60000);
 
-
-/********************************************************************************/
-/*                                     CRON                                     */
-/********************************************************************************/
-void Cron_Handler() {
-  $CronStart:
-  if (SysTick->CTRL & (1 << SysTick_CTRL_COUNTFLAG_Pos)) {
-    sysQuantum++;
-    CronSysQuantum_Handler();
-  }
-
-  if (sysQuantum >= millis_tmp) {
-    millis++;
-    millis_tmp = sysQuantum + 100;
-    CronMillis_Handler();
-  }
-  
-  if (millis >= seconds_tmp) {
-    seconds++;
-    seconds_tmp += 1000;
-    CronSeconds_Handler();
-  }
-  
-  if (seconds >= minutes_tmp) {
-    minutes++;
-    minutes_tmp += 60;
-    CronMinutes_Handler();
-  }
-
-  while (sysQuantum < delay_tmp) {
-    goto $CronStart;
+  while (1) {
+    LOOP_BEGIN();
+    Sched_Run();
+    LOOP_END();
+    Power_Idle();
   }
-  // !!!!!!!!! The bug!!!!!!!!
-  delay_tmp = 0;
-  FLAG_CLR(_EREG_, _DELAYF_);
 }
 
 
@@ -111,57 +87,42 @@ void Cron_Handler() {
 
 
 /********************************************************************************/
-/*                             CRON EVENTS HANDLERS                             */
+/*                                     TASKS                                    */
 /********************************************************************************/
-// ---- System Quantum ---- //
-static void CronSysQuantum_Handler(void) {
-  //
-}
-
-// ---- Milliseconds ---- //
-static void CronMillis_Handler(void) {
-  //
-}
-
-// ---- Seconds ---- //
-static void CronSeconds_Handler(void) {
-  //
+// ---- Watchdog and power budget window, every second ---- //
+/* In duty cycling the watchdog is reloaded on every wake up from Stop too */
+static void Watchdog_Task(void) {
   IWDG->KR = IWDG_KEY_RELOAD;
-  FLAG_SET(_EREG_, _SECF_);
+  Power_Snapshot();
+  #ifdef WAIT_STATS
+    Wait_Snapshot();
+  #endif /* WAIT_STATS */
 }
 
-// ---- Minutes ---- //
-static void CronMinutes_Handler(void) {
-  //
-  printf("A minute left.\n");
-}
-
-
-
-
-
-
-/********************************************************************************/
-/*                                     FLAGS                                    */
-/********************************************************************************/
-void Flags_Handler(void) {
-  if (FLAG_CHECK(_EREG_, _U1RXF_)) {
-    USART1_RX_Handler();
-    FLAG_CLR(_EREG_, _U1RXF_);
+// ---- Sensor sample, every second ---- //
+static void Sample_Task(void) {
+  // LED_Blink(GPIOA, GPIO_PIN_4);
+  /* A sensor missing at start is looked for every sample period */
+  if (!bmp280_status) {
+    bmp280_status = BMP280_Recover();
   }
-
-  if (FLAG_CHECK(_EREG_, _SECF_)) {
-    // LED_Blink(GPIOA, GPIO_PIN_4);
-    if (bmp280_status) {
-      BMP280_S32_t *tmpt = BMP280_ReadT();
-      BMP280_U32_t *tmpp = BMP280_ReadP();
-      printf("temp: %li\n", *tmpt);
-      printf("press: %li\n", *tmpp);
+  if (bmp280_status) {
+    Sample_TypeDef sample;
+    if ((BMP280_Measure() == BMX280_OK) && Sample_Latest(&sample)) {
+      LOG("temp: %" PRIi32 "\n", sample.temperature);
+      LOG("press: %" PRIu32 "\n", sample.pressure);
+    } else {
+      LOG("sensor error: %u\n", (unsigned int)BMP280_LastError());
+      bmp280_status = 0;
     }
-    FLAG_CLR(_EREG_, _SECF_);
   }
 }
 
+// ---- Minutes ---- //
+static void Minute_Task(void) {
+  LOG("A minute left.\n");
+}
+
 
 
 
@@ -184,16 +145,6 @@ void SystemInit (void) {
 
   NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_4);
 
-  /* Setup and enable SysTick */
-  SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
-  SysTick->LOAD  = 480U - 1U;
-  SysTick->VAL   = 0U;
-  SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
-
-  /* Set SysTick interrupt */
-  NVIC_SetPriority(SysTick_IRQn, 0);
-  NVIC_EnableIRQ(SysTick_IRQn);
-
   /* Enable SysCfg, Debug Freezer and PWR  */
   SET_BIT(RCC->APB2ENR, (RCC_APB2ENR_SYSCFGEN | RCC_APB2ENR_DBGMCUEN));
   SET_BIT(RCC->APB1ENR, RCC_APB1ENR_PWREN);
@@ -223,29 +174,11 @@ void SystemInit (void) {
   SET_BIT(RCC->CSR, RCC_CSR_LSION);
   while(!(READ_BIT(RCC->CSR, RCC_CSR_LSIRDY) == (RCC_CSR_LSIRDY)));
 
-  /* Enable HSE and wailt until it reaady*/
-  SET_BIT(RCC->CR, RCC_CR_HSEON);
-  while(!(READ_BIT(RCC->CR, RCC_CR_HSERDY) == (RCC_CR_HSERDY)));
-
-  /* Configure source domain as PLL */
-  MODIFY_REG(RCC->CFGR, RCC_CFGR_PLLSRC | RCC_CFGR_PLLMUL, (RCC_CFGR_PLLSRC_HSE_PREDIV & RCC_CFGR_PLLSRC) | RCC_CFGR_PLLMUL6);
-  MODIFY_REG(RCC->CFGR2, RCC_CFGR2_PREDIV, (RCC_CFGR_PLLSRC_HSE_PREDIV & RCC_CFGR2_PREDIV));
-  
-  
-  /* Enable PLL and wailt until it reaady*/
-  SET_BIT(RCC->CR, RCC_CR_PLLON);
-  while(!(READ_BIT(RCC->CR, RCC_CR_PLLRDY) == (RCC_CR_PLLRDY)));
-
-  /* AHB clock isn't divided */
-  /* APB1 clock isn't divided */
-
-  /* Set PLL as clock source and wailt until it reaady*/
-  MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, RCC_CFGR_SW_PLL);
-
-   /* Wait till System clock is ready */
-  while(READ_BIT(RCC->CFGR, RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+  /* HSE and PLL as system clock */
+  SystemClock_Config();
 
-  SystemCoreClock = 48000000;
+  /* Setup and enable SysTick, it drives the monotonic clock */
+  Clock_Init();
 
   /* USART clock now is APH1 PCLK1 clock */
 
@@ -263,6 +196,9 @@ void SystemInit (void) {
   ));
 
   /* APB1 peripherals */
+  SET_BIT(RCC->APB1ENR, (
+      RCC_APB1ENR_TIM14EN
+  ));
 
   /* APB2 peripherals */
   SET_BIT(RCC->APB2ENR, (
@@ -270,13 +206,21 @@ void SystemInit (void) {
     | RCC_APB2ENR_SPI1EN
   ));
 
+  /* Cycle counter timers */
+  #ifdef CYCLE_COUNTER
+    SET_BIT(RCC->APB1ENR, RCC_APB1ENR_TIM3EN);
+    SET_BIT(RCC->APB2ENR, RCC_APB2ENR_TIM1EN);
+  #endif /* CYCLE_COUNTER */
+
 
   /* Stop ticking peripheral while debugging */
+  /* Keep debugger connected in Stop mode */
   #if (DEBUG != 0)
     SET_BIT(DBGMCU->APB1FZ, (
         DBGMCU_APB1_FZ_DBG_IWDG_STOP
       | DBGMCU_APB1_FZ_DBG_WWDG_STOP
     ));
+    SET_BIT(DBGMCU->CR, DBGMCU_CR_DBG_STOP);
   #endif /* DEBUG */
 
 }
@@ -285,6 +229,42 @@ void SystemInit (void) {
 
 
 
+/**
+  * @brief  Switches the system clock to PLL on HSE, 48MHz. It's used after
+  *         reset and after wake up from Stop mode, when HSI is the clock.
+  * @param  None
+  * @retval None
+  */
+void SystemClock_Config(void) {
+  /* Enable HSE and wailt until it reaady*/
+  SET_BIT(RCC->CR, RCC_CR_HSEON);
+  while(!(READ_BIT(RCC->CR, RCC_CR_HSERDY) == (RCC_CR_HSERDY)));
+
+  /* Configure source domain as PLL */
+  MODIFY_REG(RCC->CFGR, RCC_CFGR_PLLSRC | RCC_CFGR_PLLMUL, (RCC_CFGR_PLLSRC_HSE_PREDIV & RCC_CFGR_PLLSRC) | RCC_CFGR_PLLMUL6);
+  MODIFY_REG(RCC->CFGR2, RCC_CFGR2_PREDIV, (RCC_CFGR_PLLSRC_HSE_PREDIV & RCC_CFGR2_PREDIV));
+  
+  
+  /* Enable PLL and wailt until it reaady*/
+  SET_BIT(RCC->CR, RCC_CR_PLLON);
+  while(!(READ_BIT(RCC->CR, RCC_CR_PLLRDY) == (RCC_CR_PLLRDY)));
+
+  /* AHB clock isn't divided */
+  /* APB1 clock isn't divided */
+
+  /* Set PLL as clock source and wailt until it reaady*/
+  MODIFY_REG(RCC->CFGR, RCC_CFGR_SW, RCC_CFGR_SW_PLL);
+
+   /* Wait till System clock is ready */
+  while(READ_BIT(RCC->CFGR, RCC_CFGR_SWS) != RCC_CFGR_SWS_PLL);
+
+  SystemCoreClock = 48000000;
+}
+
+
+
+
+
 /**
   * @brief  Setup the Independent Watchdog.
   * @note   This function should be used only after reset.
@@ -0,0 +1,252 @@
+/**
+  ******************************************************************************
+  * File Name          : power.c
+  * Description        : This file provides code for the low-power duty
+  *                      cycling. When nothing is due for a while, the core
+  *                      enters Stop mode and RTC Alarm A wakes it up at the
+  *                      next scheduler release, USART RX start bit wakes it
+  *                      up as well. HSE and PLL are restored afterwards and
+  *                      the monotonic clock is advanced by the RTC.
+  *                      Time is accounted per power state:
+  *                        run   - executing on 48MHz
+  *                        sleep - WFI on 48MHz
+  *                        wake  - executing on HSI while PLL is locking
+  *                        stop  - Stop mode
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "power.h"
+
+/* Private variables ---------------------------------------------------------*/
+static uint8_t lowPower = POWER_LP_AT_START;
+static uint8_t rtcReady = 0;
+static volatile uint8_t rxWakeup = 0;
+static uint32_t holdUntil = 0;
+static uint32_t stopUs = 0;
+static uint32_t wakeUs = 0;
+static uint32_t stops = 0;
+static uint64_t windowStart = 0;
+static Power_Budget_TypeDef budget;
+
+static const uint32_t stateUa[POWER_STATES] = {
+  POWER_RUN_UA, POWER_SLEEP_UA, POWER_WAKE_UA, POWER_STOP_UA
+};
+
+/* Private function prototypes -----------------------------------------------*/
+static void Power_Stop(uint32_t ms, uint32_t events);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Power management Initialization procedure.
+  * @param  none
+  * @retval none
+  */
+void Power_Init(void) {
+  rtcReady = RTC_Init();
+  windowStart = Clock_Micros();
+
+  /* USART RX pin PA10 is EXTI line 10, it's unmasked in Stop only */
+  SET_BIT(EXTI->FTSR, EXTI_FTSR_TR10);
+  NVIC_SetPriority(EXTI4_15_IRQn, 2);
+  NVIC_EnableIRQ(EXTI4_15_IRQn);
+}
+
+
+
+
+
+/**
+  * @brief  Idles the core till a bound event or the next scheduler release.
+  *         It's called by the main loop.
+  * @param  none
+  * @retval none
+  */
+void Power_Idle(void) {
+  uint32_t now = (uint32_t)Clock_Millis();
+  uint32_t events = Sched_Events();
+  uint32_t timeout = EVENT_FOREVER;
+  uint32_t release;
+
+  if (Sched_NextRelease(&release)) {
+    if ((int32_t)(release - now) <= 0) return;
+    timeout = release - now;
+  }
+
+  if (lowPower && rtcReady && (timeout != EVENT_FOREVER) && (timeout >= POWER_STOP_MIN_MS)
+      && ((int32_t)(holdUntil - now) <= 0)) {
+    Power_Stop(timeout, events);
+  } else {
+    Event_Wait(events, timeout);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Enters Stop mode. SysTick is stopped meanwhile, so the clock
+  *         is advanced by RTC counts, including the PLL locking time.
+  * @param  ms: time to the next release, ms.
+  * @param  events: _EREG_ flags that cancel Stop mode entry.
+  * @retval none
+  */
+static void Power_Stop(uint32_t ms, uint32_t events) {
+  uint32_t t0, t1, t2;
+
+  /* USART and SPI are stopped together with the clock */
+  USART1_TX_Flush();
+  RTC_SetAlarm(ms);
+
+  WRITE_REG(EXTI->PR, EXTI_PR_PR10);
+  SET_BIT(EXTI->IMR, EXTI_IMR_MR10);
+
+  CLEAR_BIT(SysTick->CTRL, SysTick_CTRL_ENABLE_Msk);
+  MODIFY_REG(PWR->CR, PWR_CR_PDDS, (PWR_CR_LPDS | PWR_CR_CWUF));
+  SET_BIT(SCB->SCR, SCB_SCR_SLEEPDEEP_Msk);
+
+  /* An event set after the decision is caught here, see Event_Wait() */
+  __disable_irq();
+  t0 = RTC_Counts();
+  if (!(_EREG_ & events)) __WFI();
+  t1 = RTC_Counts();
+
+  CLEAR_BIT(SCB->SCR, SCB_SCR_SLEEPDEEP_Msk);
+  CLEAR_BIT(EXTI->IMR, EXTI_IMR_MR10);
+
+  SystemClock_Config();
+  t2 = RTC_Counts();
+  SET_BIT(SysTick->CTRL, SysTick_CTRL_ENABLE_Msk);
+  __enable_irq();
+
+  /* Wake ups come every second at least, the watchdog is safe by that */
+  IWDG->KR = IWDG_KEY_RELOAD;
+
+  stopUs += RTC_CountsToUs(RTC_Elapsed(t0, t1));
+  wakeUs += RTC_CountsToUs(RTC_Elapsed(t1, t2));
+  stops++;
+  Clock_Advance(RTC_CountsToUs(RTC_Elapsed(t0, t2)));
+
+  /* The first RX symbol is lost, keep awake for the rest of the command */
+  if (rxWakeup) {
+    rxWakeup = 0;
+    Power_Hold(POWER_HOLD_MS);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Enables or disables duty cycling.
+  * @param  enable: 1 enables, 0 disables.
+  * @retval none
+  */
+void Power_SetLowPower(uint8_t enable) {
+  lowPower = enable;
+}
+
+
+
+
+
+/**
+  * @brief  Returns duty cycling state.
+  * @param  none
+  * @retval 1 when enabled, 0 otherwise.
+  */
+uint8_t Power_GetLowPower(void) {
+  return (lowPower);
+}
+
+
+
+
+
+/**
+  * @brief  Keeps the core out of Stop mode for a while.
+  * @param  ms: hold time, ms.
+  * @retval none
+  */
+void Power_Hold(uint32_t ms) {
+  holdUntil = (uint32_t)Clock_Millis() + ms;
+}
+
+
+
+
+
+/**
+  * @brief  Closes the time budget window. It's called once per second.
+  * @param  none
+  * @retval none
+  */
+void Power_Snapshot(void) {
+  uint64_t now = Clock_Micros();
+  uint32_t window = (uint32_t)(now - windowStart);
+  uint32_t busy = 0;
+  uint32_t ua = 0;
+
+  Sleep_Snapshot();
+  if (!window) return;
+
+  budget.permille[POWER_SLEEP] = Sleep_IdlePermille();
+  budget.permille[POWER_WAKE] = (uint32_t)(((uint64_t)wakeUs * 1000U) / window);
+  budget.permille[POWER_STOP] = (uint32_t)(((uint64_t)stopUs * 1000U) / window);
+  for (uint8_t i = POWER_SLEEP; i < POWER_STATES; i++) {
+    busy += budget.permille[i];
+  }
+  budget.permille[POWER_RUN] = (busy < 1000U) ? (1000U - busy) : 0;
+
+  for (uint8_t i = 0; i < POWER_STATES; i++) {
+    ua += budget.permille[i] * stateUa[i];
+  }
+  budget.averageUa = ua / 1000U;
+  budget.stops = stops;
+
+  stopUs = 0;
+  wakeUs = 0;
+  stops = 0;
+  windowStart = now;
+}
+
+
+
+
+
+/**
+  * @brief  Returns the time budget of the last window.
+  * @param  none
+  * @retval Pointer to the budget.
+  */
+const Power_Budget_TypeDef* Power_GetBudget(void) {
+  return (&budget);
+}
+
+
+
+
+
+/**
+  * @brief  EXTI line 10 handler, USART RX start bit in Stop mode.
+  * @param  none
+  * @retval none
+  */
+void Power_RxWakeup_Handler(void) {
+  WRITE_REG(EXTI->PR, EXTI_PR_PR10);
+  rxWakeup = 1;
+}
@@ -0,0 +1,123 @@
+/**
+  ******************************************************************************
+  * File Name          : prof.c
+  * Description        : This file provides code for the cycle profiler.
+  *                      Cortex-M0 has no DWT cycle counter, so probes read
+  *                      the TIM3/TIM1 chain running on the core clock.
+  *                      Each probe keeps call count, total, min and max
+  *                      cycles between PROF_ENTER() and PROF_EXIT(), the
+  *                      cost of an empty probe pair is subtracted. A probe
+  *                      doesn't nest into itself.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "prof.h"
+
+#ifdef PROFILE
+
+/* Global variables ---------------------------------------------------------*/
+Prof_Entry_TypeDef profTable[PROF_COUNT];
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t profOverhead = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Profiler Initialization procedure. Starts the cycle counter and
+  *         measures the probe overhead.
+  * @param  none
+  * @retval none
+  */
+void Prof_Init(void) {
+  TIM3_Init();
+
+  Prof_Reset();
+  for (uint8_t i = 0; i < PROF_CALIBRATE; i++) {
+    PROF_ENTER(PROF_BMP280_READ);
+    PROF_EXIT(PROF_BMP280_READ);
+  }
+  profOverhead = profTable[PROF_BMP280_READ].min;
+  Prof_Reset();
+}
+
+
+
+
+
+/**
+  * @brief  Closes a probe run.
+  * @param  entry: probe entry.
+  * @param  end: cycle counter on exit.
+  * @retval none
+  */
+void Prof_Exit(Prof_Entry_TypeDef *entry, uint32_t end) {
+  uint32_t cycles = end - entry->start;
+
+  cycles = (cycles > profOverhead) ? (cycles - profOverhead) : 0;
+
+  entry->count++;
+  entry->total += cycles;
+  if (cycles < entry->min) entry->min = cycles;
+  if (cycles > entry->max) entry->max = cycles;
+}
+
+
+
+
+
+/**
+  * @brief  Clears probe statistics.
+  * @param  none
+  * @retval none
+  */
+void Prof_Reset(void) {
+  for (uint8_t i = 0; i < PROF_COUNT; i++) {
+    profTable[i].count = 0;
+    profTable[i].total = 0;
+    profTable[i].min = UINT32_MAX;
+    profTable[i].max = 0;
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Prints probe statistics, cycles and total us. Names are literals
+  *         in the format string, so it works with deferred LOG() as well.
+  * @param  none
+  * @retval none
+  */
+void Prof_Dump(void) {
+  uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+
+  LOG("prof: %" PRIu32 " cycles overhead\n", profOverhead);
+
+  #define PROF_LOG(id, name) \
+    if (profTable[id].count) { \
+      LOG(name ": %" PRIu32 " calls, min %" PRIu32 " avg %" PRIu32 " max %" PRIu32 " cycles, %" PRIu32 " us\n", \
+        profTable[id].count, profTable[id].min, \
+        (uint32_t)(profTable[id].total / profTable[id].count), profTable[id].max, \
+        (uint32_t)(profTable[id].total / cyclesPerUs)); \
+    }
+  PROF_PROBES(PROF_LOG)
+  #undef PROF_LOG
+}
+
+#endif /* PROFILE */
@@ -0,0 +1,257 @@
+/**
+  ******************************************************************************
+  * File Name          : rtc.c
+  * Description        : This file provides code for the configuration
+  *                      of the RTC. STM32F030 RTC has no wakeup timer, so
+  *                      Alarm A with masked date/time fields is used. It
+  *                      fires every second on the subsecond value set by
+  *                      RTC_SetAlarm(). LSI is measured by TIM14 input
+  *                      capture to keep RTC second and counts conversion
+  *                      close to the real ones.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "rtc.h"
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t lsiFreq = LSI_VALUE;
+static uint32_t syncDiv = LSI_VALUE / (RTC_PREDIV_A + 1);
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t RTC_MeasureLSI(void);
+static uint8_t RTC_WaitFlag(uint32_t flag);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  RTC Initialization procedure. LSI has to be enabled already.
+  * @param  none
+  * @retval 1 when RTC is running, 0 otherwise.
+  */
+uint8_t RTC_Init(void) {
+  /* Select LSI as RTC clock, it's possible after backup domain reset only */
+  SET_BIT(PWR->CR, PWR_CR_DBP);
+  if (READ_BIT(RCC->BDCR, RCC_BDCR_RTCSEL) != RCC_BDCR_RTCSEL_LSI) {
+    SET_BIT(RCC->BDCR, RCC_BDCR_BDRST);
+    CLEAR_BIT(RCC->BDCR, RCC_BDCR_BDRST);
+    MODIFY_REG(RCC->BDCR, RCC_BDCR_RTCSEL, RCC_BDCR_RTCSEL_LSI);
+  }
+  SET_BIT(RCC->BDCR, RCC_BDCR_RTCEN);
+
+  lsiFreq = RTC_MeasureLSI();
+  syncDiv = (lsiFreq + ((RTC_PREDIV_A + 1) / 2)) / (RTC_PREDIV_A + 1);
+  if (syncDiv > (RTC_PRER_PREDIV_S + 1)) syncDiv = RTC_PRER_PREDIV_S + 1;
+
+  RTC->WPR = RTC_KEY_1;
+  RTC->WPR = RTC_KEY_2;
+
+  /* Prescalers, PREDIV_S has to be written first */
+  SET_BIT(RTC->ISR, RTC_ISR_INIT);
+  if (!RTC_WaitFlag(RTC_ISR_INITF)) {
+    RTC->WPR = RTC_KEY_LOCK;
+    return (0);
+  }
+  RTC->PRER = (syncDiv - 1);
+  RTC->PRER |= (RTC_PREDIV_A << RTC_PRER_PREDIV_A_Pos);
+  CLEAR_BIT(RTC->ISR, RTC_ISR_INIT);
+
+  /* Counters are read directly, shadow registers need resync after Stop */
+  SET_BIT(RTC->CR, RTC_CR_BYPSHAD);
+
+  /* Alarm A every second, the subsecond is set later */
+  CLEAR_BIT(RTC->CR, RTC_CR_ALRAE);
+  if (!RTC_WaitFlag(RTC_ISR_ALRAWF)) {
+    RTC->WPR = RTC_KEY_LOCK;
+    return (0);
+  }
+  RTC->ALRMAR = (RTC_ALRMAR_MSK4 | RTC_ALRMAR_MSK3 | RTC_ALRMAR_MSK2 | RTC_ALRMAR_MSK1);
+  RTC->ALRMASSR = 0;
+  SET_BIT(RTC->CR, (RTC_CR_ALRAIE | RTC_CR_ALRAE));
+
+  RTC->WPR = RTC_KEY_LOCK;
+
+  /* Alarm interrupt goes through EXTI line 17, it's able to wake from Stop */
+  SET_BIT(EXTI->IMR, EXTI_IMR_MR17);
+  SET_BIT(EXTI->RTSR, EXTI_RTSR_TR17);
+  NVIC_SetPriority(RTC_IRQn, 2);
+  NVIC_EnableIRQ(RTC_IRQn);
+
+  return (1);
+}
+
+
+
+
+
+/**
+  * @brief  Measures LSI frequency by TIM14 channel 1 capture of RTCCLK.
+  *         Channel 1 is given back to the delay service afterwards.
+  * @param  none
+  * @retval LSI frequency, Hz. LSI_VALUE when the measurement failed.
+  */
+static uint32_t RTC_MeasureLSI(void) {
+  Timeout_TypeDef timeout;
+  uint32_t ticks = 0;
+  uint16_t last = 0;
+  uint8_t i;
+
+  TIM14->OR = TIM14_OR_TI1_RMP_0;
+  TIM14->CCMR1 = (TIM_CCMR1_CC1S_0 | TIM_CCMR1_IC1PSC);
+  TIM14->CCER = TIM_CCER_CC1E;
+
+  for (i = 0; i <= RTC_LSI_CAPTURES; i++) {
+    CLEAR_BIT(TIM14->SR, TIM_SR_CC1IF);
+    Timeout_Start(&timeout, RTC_LSI_TIMEOUT);
+    while (!READ_BIT(TIM14->SR, TIM_SR_CC1IF)) {
+      if (Timeout_Expired(&timeout)) break;
+    }
+    if (!READ_BIT(TIM14->SR, TIM_SR_CC1IF)) break;
+
+    if (i) ticks += (uint16_t)((uint16_t)TIM14->CCR1 - last);
+    last = (uint16_t)TIM14->CCR1;
+  }
+
+  TIM14->CCER = 0;
+  TIM14->CCMR1 = 0;
+  TIM14->OR = 0;
+  CLEAR_BIT(TIM14->SR, TIM_SR_CC1IF);
+
+  if ((i <= RTC_LSI_CAPTURES) || !ticks) return (LSI_VALUE);
+  return ((uint32_t)(((uint64_t)DELAY_TIM_FREQ * RTC_LSI_EDGES * RTC_LSI_CAPTURES) / ticks));
+}
+
+
+
+
+
+/**
+  * @brief  Waits for an RTC_ISR flag.
+  * @param  flag: the flag.
+  * @retval 1 when the flag is set, 0 on timeout.
+  */
+static uint8_t RTC_WaitFlag(uint32_t flag) {
+  Timeout_TypeDef timeout;
+
+  Timeout_Start(&timeout, RTC_SYNC_TIMEOUT);
+  while (!READ_BIT(RTC->ISR, flag)) {
+    if (Timeout_Expired(&timeout)) return (0);
+  }
+  return (1);
+}
+
+
+
+
+
+/**
+  * @brief  Reads RTC time of the day in subsecond counts.
+  * @param  none
+  * @retval Counts since midnight.
+  */
+uint32_t RTC_Counts(void) {
+  uint32_t tr, ss, sec;
+
+  do {
+    tr = RTC->TR;
+    ss = RTC->SSR & RTC_SSR_SS;
+  } while (tr != RTC->TR);
+
+  sec = ((((tr & RTC_TR_HT) >> RTC_TR_HT_Pos) * 10U) + ((tr & RTC_TR_HU) >> RTC_TR_HU_Pos)) * 3600U;
+  sec += ((((tr & RTC_TR_MNT) >> RTC_TR_MNT_Pos) * 10U) + ((tr & RTC_TR_MNU) >> RTC_TR_MNU_Pos)) * 60U;
+  sec += (((tr & RTC_TR_ST) >> RTC_TR_ST_Pos) * 10U) + ((tr & RTC_TR_SU) >> RTC_TR_SU_Pos);
+
+  /* SSR counts down */
+  return ((sec * syncDiv) + (syncDiv - 1U - ss));
+}
+
+
+
+
+
+/**
+  * @brief  Counts between two RTC readings, midnight wrap is taken into account.
+  * @param  from: the first reading.
+  * @param  to: the second reading.
+  * @retval Elapsed counts.
+  */
+uint32_t RTC_Elapsed(uint32_t from, uint32_t to) {
+  return ((to >= from) ? (to - from) : ((RTC_DAY_SECONDS * syncDiv) - from + to));
+}
+
+
+
+
+
+/**
+  * @brief  Converts subsecond counts into microseconds by the measured LSI.
+  * @param  counts: subsecond counts.
+  * @retval Microseconds.
+  */
+uint32_t RTC_CountsToUs(uint32_t counts) {
+  return ((uint32_t)(((uint64_t)counts * (RTC_PREDIV_A + 1) * 1000000U) / lsiFreq));
+}
+
+
+
+
+
+/**
+  * @brief  Sets Alarm A subsecond, so the alarm fires the given time later
+  *         and then on the same subsecond every second.
+  * @param  ms: time to the alarm, ms. Only the fraction of a second matters.
+  * @retval none
+  */
+void RTC_SetAlarm(uint32_t ms) {
+  uint32_t ss = RTC->SSR & RTC_SSR_SS;
+  uint32_t delta = (((ms % 1000U) * syncDiv) / 1000U) % syncDiv;
+
+  ss = (ss + syncDiv - delta) % syncDiv;
+
+  RTC->WPR = RTC_KEY_1;
+  RTC->WPR = RTC_KEY_2;
+  CLEAR_BIT(RTC->CR, RTC_CR_ALRAE);
+  if (RTC_WaitFlag(RTC_ISR_ALRAWF)) {
+    RTC->ALRMASSR = (15U << RTC_ALRMASSR_MASKSS_Pos) | ss;
+  }
+  SET_BIT(RTC->CR, RTC_CR_ALRAE);
+  RTC->WPR = RTC_KEY_LOCK;
+}
+
+
+
+
+
+/**
+  * @brief  Returns measured LSI frequency.
+  * @param  none
+  * @retval Frequency, Hz.
+  */
+uint32_t RTC_LsiFreq(void) {
+  return (lsiFreq);
+}
+
+
+
+
+
+/**
+  * @brief  RTC Alarm A handler, it only has to wake the core up.
+  * @param  none
+  * @retval none
+  */
+void RTC_Alarm_Handler(void) {
+  CLEAR_BIT(RTC->ISR, RTC_ISR_ALRAF);
+  WRITE_REG(EXTI->PR, EXTI_PR_PR17);
+}
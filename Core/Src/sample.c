@@ -0,0 +1,84 @@
+/**
+  ******************************************************************************
+  * File Name          : sample.c
+  * Description        : This file provides code for the publication of the
+  *                      latest sensor sample. There is one writer, readers
+  *                      may run in thread or ISR context and preempt the
+  *                      writer or be preempted by it. Two slots take turns,
+  *                      the writer fills the one readers don't take while
+  *                      the sequence number tells them which one is whole.
+  *                      Nothing disables interrupts and a reader copies one
+  *                      sample, once more only when the writer has started
+  *                      to overwrite it meanwhile.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sample.h"
+
+/* Private variables ---------------------------------------------------------*/
+/* Publication n is written to slot n & 1. The sequence is 2n - 1 while it's
+   written and 2n once it's whole, so seq >> 1 is the latest whole one and
+   0, 1 mean nothing is published yet. A 32-bit store is atomic on the M0 */
+static Sample_TypeDef slot[2];
+static volatile uint32_t seq = 0;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Publishes a sample. Single writer only, it must not be called
+  *         from two contexts that preempt each other.
+  * @param  sample: pointer to the sample to be copied
+  * @retval none
+  */
+void Sample_Publish(const Sample_TypeDef *sample) {
+  uint32_t next = (seq >> 1) + 1;
+
+  seq = (next << 1) - 1;
+  __DMB();
+  slot[next & 1] = *sample;
+  __DMB();
+  seq = next << 1;
+}
+
+
+
+
+
+/**
+  * @brief  Takes a consistent copy of the latest sample. The slot read is
+  *         written again only from publication n + 2 on, which first sets
+  *         the sequence to 2n + 3, so a smaller sequence after the copy
+  *         proves it whole.
+  * @param  sample: pointer where the sample to be placed
+  * @retval uint32_t number of the sample, it counts from 1, 0 when nothing
+  *         is published yet
+  */
+uint32_t Sample_Latest(Sample_TypeDef *sample) {
+  uint32_t before;
+  uint32_t after;
+
+  do {
+    before = seq & ~1U;
+    if (!before) {
+      return (0);
+    }
+    __DMB();
+    *sample = slot[(before >> 1) & 1];
+    __DMB();
+    after = seq;
+  } while ((after - before) >= 3);
+
+  return (before >> 1);
+}
@@ -0,0 +1,420 @@
+/**
+  ******************************************************************************
+  * File Name          : sched.c
+  * Description        : This file provides code for the cooperative task
+  *                      scheduler. Timed tasks are hashed into wheel slots
+  *                      by their release tick, so both arming and expiry
+  *                      are O(1). Expired and posted tasks are queued by
+  *                      priority and run to completion.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "sched.h"
+
+/* Private macro -------------------------------------------------------------*/
+#define SCHED_EXPIRED(time, now)  ((int32_t)((time) - (now)) <= 0)
+
+/* Private variables ---------------------------------------------------------*/
+static Sched_Task_TypeDef *wheel[SCHED_WHEEL_SLOTS];
+static Sched_Task_TypeDef *readyHead[SCHED_PRIO_LEVELS];
+static Sched_Task_TypeDef *readyTail[SCHED_PRIO_LEVELS];
+static Sched_Task_TypeDef *bound[32];
+static Sched_Task_TypeDef *tasks = 0;
+static volatile uint8_t readyMask = 0;
+static uint32_t boundMask = 0;
+static uint32_t wheelTick = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static void Sched_Link(Sched_Task_TypeDef *task);
+static void Sched_Unlink(Sched_Task_TypeDef *task);
+static void Sched_Ready(Sched_Task_TypeDef *task, uint32_t now);
+static void Sched_Expire(Sched_Task_TypeDef **slot, uint32_t now);
+static void Sched_Dispatch(Sched_Task_TypeDef *task);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Scheduler Initialization procedure.
+  * @param  none
+  * @retval none
+  */
+void Sched_Init(void) {
+  wheelTick = (uint32_t)Clock_Millis();
+}
+
+
+
+
+
+/**
+  * @brief  Registers a task.
+  * @param  task: pointer to the task, it has to be static.
+  * @param  func: task function.
+  * @param  prio: priority, 0 is the highest.
+  * @param  deadline: relative deadline in ms, 0 means the period for periodic
+  *         tasks, or SCHED_DEFAULT_DEADLINE for others.
+  * @retval none
+  */
+void Sched_Add(Sched_Task_TypeDef *task, Sched_Func_TypeDef func, uint8_t prio, uint32_t deadline) {
+  task->func = func;
+  task->prio = (prio < SCHED_PRIO_LEVELS) ? prio : (SCHED_PRIO_LEVELS - 1);
+  task->deadline = deadline;
+  task->state = SCHED_IDLE;
+  task->runs = 0;
+  task->missed = 0;
+  task->id = (tasks) ? (tasks->id + 1) : 0;
+  task->link = tasks;
+  tasks = task;
+}
+
+
+
+
+
+/**
+  * @brief  Arms a task. Could be called from an ISR.
+  * @param  task: pointer to the task.
+  * @param  delay: delay of the first release in ms, 0 makes the task ready.
+  * @param  period: period in ms, 0 means one-shot.
+  * @retval none
+  */
+void Sched_Start(Sched_Task_TypeDef *task, uint32_t delay, uint32_t period) {
+  uint32_t now = (uint32_t)Clock_Millis();
+  uint32_t primask = __get_PRIMASK();
+
+  Sched_Stop(task);
+  task->period = period;
+
+  if (!delay) {
+    Sched_Ready(task, now);
+    return;
+  }
+
+  task->release = now + delay;
+  __disable_irq();
+  Sched_Link(task);
+  __set_PRIMASK(primask);
+}
+
+
+
+
+
+/**
+  * @brief  Disarms a task and removes it from the ready queue. Could be
+  *         called from an ISR.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+void Sched_Stop(Sched_Task_TypeDef *task) {
+  uint32_t primask = __get_PRIMASK();
+  Sched_Task_TypeDef **tmp;
+
+  __disable_irq();
+  if (task->state == SCHED_TIMED) {
+    Sched_Unlink(task);
+  } else if (task->state == SCHED_READY) {
+    readyTail[task->prio] = 0;
+    tmp = &readyHead[task->prio];
+    while (*tmp) {
+      if (*tmp == task) {
+        *tmp = task->next;
+        continue;
+      }
+      readyTail[task->prio] = *tmp;
+      tmp = &(*tmp)->next;
+    }
+    if (!readyHead[task->prio]) readyMask &= ~(1 << task->prio);
+  }
+  task->state = SCHED_IDLE;
+  __set_PRIMASK(primask);
+}
+
+
+
+
+
+/**
+  * @brief  Makes a task ready right now. Could be called from an ISR.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+void Sched_Post(Sched_Task_TypeDef *task) {
+  Sched_Ready(task, (uint32_t)Clock_Millis());
+}
+
+
+
+
+
+/**
+  * @brief  Binds an _EREG_ flag to a task. The flag is cleared and the task
+  *         is posted by the scheduler, so an ISR only has to set the flag.
+  * @param  flag: _EREG_ flag number.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+void Sched_Bind(uint8_t flag, Sched_Task_TypeDef *task) {
+  bound[flag] = task;
+  boundMask |= (1 << flag);
+}
+
+
+
+
+
+/**
+  * @brief  Returns _EREG_ flags bound to tasks, the main loop waits for them.
+  * @param  none
+  * @retval Bound flags mask.
+  */
+uint32_t Sched_Events(void) {
+  return (boundMask);
+}
+
+
+
+
+
+/**
+  * @brief  Returns the list of registered tasks, linked by the link field.
+  * @param  none
+  * @retval Pointer to the last registered task.
+  */
+Sched_Task_TypeDef* Sched_Tasks(void) {
+  return (tasks);
+}
+
+
+
+
+
+/**
+  * @brief  Finds the nearest release. It walks the whole wheel, so it's
+  *         meant for the sleep decision only.
+  * @param  release: pointer where the release tick to be placed.
+  * @retval 1 when there is a ready or timed task, 0 otherwise.
+  */
+uint8_t Sched_NextRelease(uint32_t *release) {
+  uint32_t primask = __get_PRIMASK();
+  uint8_t found = 0;
+
+  __disable_irq();
+  if (readyMask) {
+    *release = wheelTick;
+    found = 1;
+  } else {
+    for (uint8_t i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+      for (Sched_Task_TypeDef *task = wheel[i]; task; task = task->next) {
+        if (!found || ((int32_t)(task->release - *release) < 0)) {
+          *release = task->release;
+          found = 1;
+        }
+      }
+    }
+  }
+  __set_PRIMASK(primask);
+
+  return (found);
+}
+
+
+
+
+
+/**
+  * @brief  Scheduler pass, it's called by the main loop. Posts bound events,
+  *         advances the wheel up to the current tick and runs ready tasks
+  *         by priority.
+  * @param  none
+  * @retval none
+  */
+void Sched_Run(void) {
+  uint32_t now = (uint32_t)Clock_Millis();
+  uint32_t primask = __get_PRIMASK();
+  uint32_t pending;
+  uint32_t tick;
+  uint8_t prio;
+  Sched_Task_TypeDef *task;
+
+  /* Events */
+  if (_EREG_ & boundMask) {
+    pending = Event_Take(boundMask);
+    for (uint8_t flag = 0; pending; flag++, pending >>= 1) {
+      if (pending & 1) Sched_Ready(bound[flag], now);
+    }
+  }
+
+  /* Wheel, whole round at most */
+  if (now != wheelTick) {
+    tick = ((now - wheelTick) > SCHED_WHEEL_SLOTS) ? (now - SCHED_WHEEL_SLOTS) : wheelTick;
+    while (tick != now) {
+      tick++;
+      Sched_Expire(&wheel[tick & SCHED_WHEEL_MASK], now);
+    }
+    wheelTick = now;
+  }
+
+  /* Ready tasks */
+  while (readyMask) {
+    prio = 0;
+    while (!(readyMask & (1 << prio))) prio++;
+
+    __disable_irq();
+    task = readyHead[prio];
+    readyHead[prio] = task->next;
+    if (!task->next) {
+      readyTail[prio] = 0;
+      readyMask &= ~(1 << prio);
+    }
+    task->state = SCHED_IDLE;
+    __set_PRIMASK(primask);
+
+    Sched_Dispatch(task);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Runs a task, re-arms a periodic one on its release grid and
+  *         counts deadline misses. Skipped releases are misses as well.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+static void Sched_Dispatch(Sched_Task_TypeDef *task) {
+  uint32_t release = task->release;
+  uint32_t deadline = task->deadline;
+  uint32_t now = wheelTick;
+  uint32_t primask = __get_PRIMASK();
+  uint32_t skipped;
+
+  if (!deadline) deadline = (task->period) ? task->period : SCHED_DEFAULT_DEADLINE;
+
+  if (task->period) {
+    task->release = release + task->period;
+    if (SCHED_EXPIRED(task->release, now)) {
+      skipped = (now - release) / task->period;
+      task->missed += skipped;
+      task->release = release + ((skipped + 1) * task->period);
+    }
+    __disable_irq();
+    Sched_Link(task);
+    __set_PRIMASK(primask);
+  }
+
+  TRACE(TRACE_TASK_BEGIN, task->id, task->prio);
+  task->func();
+  task->runs++;
+  TRACE(TRACE_TASK_END, task->id, task->prio);
+
+  if (((uint32_t)Clock_Millis() - release) > deadline) task->missed++;
+}
+
+
+
+
+
+/**
+  * @brief  Moves expired tasks of a wheel slot into the ready queues.
+  *         Tasks of the next rounds are left in the slot. The slot is
+  *         walked masked, Sched_Start()/Sched_Stop() relink it from ISRs.
+  * @param  slot: pointer to the slot.
+  * @param  now: current tick.
+  * @retval none
+  */
+static void Sched_Expire(Sched_Task_TypeDef **slot, uint32_t now) {
+  uint32_t primask = __get_PRIMASK();
+  Sched_Task_TypeDef *task;
+  Sched_Task_TypeDef *next;
+
+  __disable_irq();
+  task = *slot;
+  while (task) {
+    next = task->next;
+    if (SCHED_EXPIRED(task->release, now)) {
+      Sched_Ready(task, task->release);
+    }
+    task = next;
+  }
+  __set_PRIMASK(primask);
+}
+
+
+
+
+
+/**
+  * @brief  Queues a task to the tail of its priority ready queue.
+  * @param  task: pointer to the task.
+  * @param  release: release time to be accounted.
+  * @retval none
+  */
+static void Sched_Ready(Sched_Task_TypeDef *task, uint32_t release) {
+  uint32_t primask = __get_PRIMASK();
+
+  __disable_irq();
+  if (task->state != SCHED_READY) {
+    if (task->state == SCHED_TIMED) Sched_Unlink(task);
+
+    task->release = release;
+    task->next = 0;
+    if (readyTail[task->prio]) {
+      readyTail[task->prio]->next = task;
+    } else {
+      readyHead[task->prio] = task;
+    }
+    readyTail[task->prio] = task;
+    readyMask |= (1 << task->prio);
+    task->state = SCHED_READY;
+  }
+  __set_PRIMASK(primask);
+}
+
+
+
+
+
+/**
+  * @brief  Puts a task into the wheel slot of its release tick.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+static void Sched_Link(Sched_Task_TypeDef *task) {
+  Sched_Task_TypeDef **slot = &wheel[task->release & SCHED_WHEEL_MASK];
+
+  task->next = *slot;
+  if (*slot) (*slot)->pprev = &task->next;
+  *slot = task;
+  task->pprev = slot;
+  task->state = SCHED_TIMED;
+}
+
+
+
+
+
+/**
+  * @brief  Takes a task out of its wheel slot.
+  * @param  task: pointer to the task.
+  * @retval none
+  */
+static void Sched_Unlink(Sched_Task_TypeDef *task) {
+  *task->pprev = task->next;
+  if (task->next) task->next->pprev = task->pprev;
+  task->next = 0;
+}
@@ -12,6 +12,9 @@
 /* Includes ------------------------------------------------------------------*/
 #include "spi.h"
 
+/* Private function prototypes -----------------------------------------------*/
+__STATIC_INLINE SPI_Status_TypeDef SPI_Transfer(uint8_t out, uint8_t *in);
+
 
 
 
@@ -69,13 +72,60 @@ void SPI1_Enable() {
 /**
   * @brief  SPI1 disabling procedure
   * @param  none
-  * @retval none
+  * @retval SPI_OK, SPI_ERR_BSY when the FIFO or the shifter doesn't drain,
+  *         the SPI is disabled anyway.
   */
-void SPI1_Disable() {
-  while (READ_BIT(SPI1->SR, SPI_SR_FTLVL) == SPI_SR_FTLVL);
-  while (READ_BIT(SPI1->SR, SPI_SR_BSY));
+SPI_Status_TypeDef SPI1_Disable() {
+  uint8_t ok = 1;
+
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_BSY, READ_BIT(SPI1->SR, SPI_SR_FTLVL) == SPI_SR_FTLVL, SPI_TIMEOUT_US, ok);
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_BSY, READ_BIT(SPI1->SR, SPI_SR_BSY), SPI_TIMEOUT_US, ok);
   CLEAR_BIT(SPI1->CR1, SPI_CR1_SPE);
-  while (READ_BIT(SPI1->SR, SPI_SR_FTLVL) == SPI_SR_FTLVL);
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_BSY, READ_BIT(SPI1->SR, SPI_SR_FTLVL) == SPI_SR_FTLVL, SPI_TIMEOUT_US, ok);
+  return ((ok) ? SPI_OK : SPI_ERR_BSY);
+}
+
+
+
+
+
+/**
+  * @brief  Brings SPI1 back after a timed out transfer. The peripheral is
+  *         reset through RCC, which drops its FIFOs, and set up again.
+  * @param  none
+  * @retval none
+  */
+void SPI1_Recover(void) {
+  NSS_0_H;
+  SET_BIT(RCC->APB2RSTR, RCC_APB2RSTR_SPI1RST);
+  CLEAR_BIT(RCC->APB2RSTR, RCC_APB2RSTR_SPI1RST);
+  SPI1_Init();
+}
+
+
+
+
+
+/**
+  * @brief  Clocks a byte through the bus, both waits are bounded.
+  * @param  out: byte to send.
+  * @param  in: pointer where the received byte to be placed.
+  * @retval SPI_OK, SPI_ERR_TXE or SPI_ERR_RXNE.
+  */
+__STATIC_INLINE SPI_Status_TypeDef SPI_Transfer(uint8_t out, uint8_t *in) {
+  uint8_t ok = 1;
+
+  SPI_DR_WRITE(SPI1, out);
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_TXE, !(READ_BIT(SPI1->SR, SPI_SR_TXE)), SPI_TIMEOUT_US, ok);
+  if (!ok) {
+    return (SPI_ERR_TXE);
+  }
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_RXNE, !(READ_BIT(SPI1->SR, SPI_SR_RXNE)), SPI_TIMEOUT_US, ok);
+  if (!ok) {
+    return (SPI_ERR_RXNE);
+  }
+  *in = SPI_DR_READ(SPI1);
+  return (SPI_OK);
 }
 
 
@@ -88,27 +138,43 @@ void SPI1_Disable() {
   * @param  buf: pointer to buffer to read, the first item of buffer could contain
   *              a command data. Beginning iteration reads a dummy byte.
   *         cnt: count of bytes to read.
-  * @retval none
+  * @retval SPI_OK or the wait that timed out, NSS is released anyway.
   */
-void SPI_Read(uint8_t *buf, uint8_t cnt) {
+SPI_Status_TypeDef SPI_Read(uint8_t *buf, uint8_t cnt) {
+  SPI_Status_TypeDef status = SPI_OK;
+  uint8_t ok = 1;
+  uint8_t dummy;
+
+  PROF_ENTER(PROF_SPI_READ);
+  TRACE(TRACE_SPI_BEGIN, cnt, buf[0]);
+  #ifdef SPI_CAPTURE
+    uint8_t *data = buf;
+    uint8_t cmd = buf[0];
+    uint8_t len = cnt;
+    uint32_t time = (uint32_t)Clock_Micros();
+  #endif /* SPI_CAPTURE */
   // SPI1_Enable();
   NSS_0_L;
-  while (PIN_LEVEL(SPI_Port, NSS_0_Pin));
-
-  *(__IO uint8_t*)&SPI1->DR = buf[0];
-  while (!(READ_BIT(SPI1->SR, SPI_SR_TXE)));
-  while (!(READ_BIT(SPI1->SR, SPI_SR_RXNE)));
-  SPI1->DR;
-  
-  while (cnt--) {
-    *(__IO uint8_t*)&SPI1->DR = 0;
-    while (!(READ_BIT(SPI1->SR, SPI_SR_TXE)));
-    while (!(READ_BIT(SPI1->SR, SPI_SR_RXNE)));
-    *buf++ = (uint8_t)SPI1->DR;
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_NSS, PIN_LEVEL(SPI_Port, NSS_0_Pin), SPI_NSS_TIMEOUT_US, ok);
+  if (!ok) {
+    status = SPI_ERR_NSS;
+  }
+
+  if (status == SPI_OK) {
+    status = SPI_Transfer(buf[0], &dummy);
+  }
+  while ((status == SPI_OK) && cnt--) {
+    status = SPI_Transfer(0, buf++);
   }
     
   NSS_0_H;
   // SPI1_Disable();
+  TRACE(TRACE_SPI_END, cnt, status);
+  #ifdef SPI_CAPTURE
+    SPI_Capture(SPI_CAPTURE_READ, cmd, data, len, time);
+  #endif /* SPI_CAPTURE */
+  PROF_EXIT(PROF_SPI_READ);
+  return (status);
 }
 
 
@@ -120,20 +186,56 @@ void SPI_Read(uint8_t *buf, uint8_t cnt) {
   * @brief  Writes data into SPI bus
   * @param  buf: pointer to buffer to write.
   *         cnt: count of bytes to write.
-  * @retval none
+  * @retval SPI_OK or the wait that timed out, NSS is released anyway.
   */
-void SPI_Write(uint8_t *buf, uint8_t cnt) {
+SPI_Status_TypeDef SPI_Write(uint8_t *buf, uint8_t cnt) {
+  SPI_Status_TypeDef status = SPI_OK;
+  uint8_t ok = 1;
+  uint8_t dummy;
+
+  PROF_ENTER(PROF_SPI_WRITE);
+  TRACE(TRACE_SPI_BEGIN, cnt, buf[0]);
+  #ifdef SPI_CAPTURE
+    if (cnt) SPI_Capture(SPI_CAPTURE_WRITE, buf[0], buf + 1, cnt - 1, (uint32_t)Clock_Micros());
+  #endif /* SPI_CAPTURE */
   NSS_0_L;
-  while (PIN_LEVEL(SPI_Port, NSS_0_Pin));
-
-  if (cnt) {
-    while (cnt--) {
-      *(__IO uint8_t*)&SPI1->DR = *buf++;
-      while (!(READ_BIT(SPI1->SR, SPI_SR_TXE)));
-      while (!(READ_BIT(SPI1->SR, SPI_SR_RXNE)));
-      SPI1->DR;
-    }
+  BUSY_WAIT_TIMEOUT(WAIT_SPI_NSS, PIN_LEVEL(SPI_Port, NSS_0_Pin), SPI_NSS_TIMEOUT_US, ok);
+  if (!ok) {
+    status = SPI_ERR_NSS;
+  }
+
+  while ((status == SPI_OK) && cnt--) {
+    status = SPI_Transfer(*buf++, &dummy);
   }
     
   NSS_0_H;
-}
\ No newline at end of file
+  TRACE(TRACE_SPI_END, cnt, status);
+  PROF_EXIT(PROF_SPI_WRITE);
+  return (status);
+}
+
+
+
+
+
+
+#ifdef SPI_CAPTURE
+/**
+  * @brief  Sends a capture frame of a transaction into USART.
+  * @param  type: SPI_CAPTURE_READ or SPI_CAPTURE_WRITE.
+  * @param  cmd: command byte of the transaction.
+  * @param  data: pointer to the payload.
+  * @param  len: length of the payload.
+  * @param  time: microsecond timestamp of the transaction start.
+  * @retval none
+  */
+void SPI_Capture(uint8_t type, uint8_t cmd, const uint8_t *data, uint8_t len, uint32_t time) {
+  uint8_t header[SPI_CAPTURE_HEADER_LEN] = {
+    type, cmd, len,
+    (uint8_t)time, (uint8_t)(time >> 8), (uint8_t)(time >> 16), (uint8_t)(time >> 24)
+  };
+
+  USART1_TX_Write(header, SPI_CAPTURE_HEADER_LEN);
+  USART1_TX_Write(data, len);
+}
+#endif /* SPI_CAPTURE */
@@ -64,7 +64,7 @@ void PendSV_Handler(void) {
   * @brief This function handles System tick timer.
   */
 void SysTick_Handler(void) {
-  //
+  sysQuantum++;
 }
 
 /******************************************************************************/
@@ -75,10 +75,39 @@ void SysTick_Handler(void) {
 /******************************************************************************/
 
 
+/**
+  * @brief This function handles RTC interrupt through EXTI line 17.
+  */
+void RTC_IRQHandler(void) {
+  RTC_Alarm_Handler();
+}
+
+/**
+  * @brief This function handles EXTI line 4 to 15 interrupts.
+  */
+void EXTI4_15_IRQHandler(void) {
+  Power_RxWakeup_Handler();
+}
+
+/**
+  * @brief This function handles TIM14 global interrupt.
+  */
+void TIM14_IRQHandler(void) {
+  Delay_Wakeup_Handler();
+}
+
 /**
   * @brief This function handles USART1 global interrupt.
   */
 void USART1_IRQHandler(void) {
-  SET_BIT(USART1->RQR, USART_RQR_RXFRQ); 
-  FLAG_SET(_EREG_, _U1RXF_);
+  if (READ_BIT(USART1->ISR, USART_ISR_ORE)) {
+    SET_BIT(USART1->ICR, USART_ICR_ORECF);
+  }
+  if (READ_BIT(USART1->ISR, USART_ISR_RXNE)) {
+    USART1_RX_Handler();
+    FLAG_SET(_EREG_, _U1RXF_);
+  }
+  if (READ_BIT(USART1->CR1, USART_CR1_TXEIE) && READ_BIT(USART1->ISR, USART_ISR_TXE)) {
+    USART1_TX_Handler();
+  }
 }
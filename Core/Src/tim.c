@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * File Name          : TIM.c
+  * Description        : This file provides code for the configuration
+  *                      of the TIM instances.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "tim.h"
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  TIM14 Initialization procedure. The timer is free running
+  *         on DELAY_TIM_FREQ, capture/compare 1 wakes the core up from
+  *         a delay.
+  * @param  none
+  * @retval none
+  */
+void TIM14_Init(void) {
+  /* Set prescaler and the whole 16-bit period */
+  TIM14->PSC = (SystemCoreClock / DELAY_TIM_FREQ) - 1U;
+  TIM14->ARR = 0xffff;
+
+  /* Load prescaler by update event */
+  SET_BIT(TIM14->EGR, TIM_EGR_UG);
+  CLEAR_BIT(TIM14->SR, TIM_SR_UIF);
+
+  NVIC_SetPriority(TIM14_IRQn, 1);
+  NVIC_EnableIRQ(TIM14_IRQn);
+
+  /* Enable counter */
+  SET_BIT(TIM14->CR1, TIM_CR1_CEN);
+}
+
+
+
+
+
+/**
+  * @brief  TIM3 and TIM1 Initialization procedure. TIM3 counts core clock
+  *         cycles, its update event is TRGO, TIM1 counts TIM3 updates
+  *         in external clock mode 1 from ITR2. See Cycles().
+  * @param  none
+  * @retval none
+  */
+void TIM3_Init(void) {
+  /* High half, clocked by TIM3 TRGO */
+  CYCLE_TIM_HI->PSC = 0;
+  CYCLE_TIM_HI->ARR = 0xffff;
+  CYCLE_TIM_HI->SMCR = TIM_SMCR_TS_1 | TIM_SMCR_SMS;
+  SET_BIT(CYCLE_TIM_HI->CR1, TIM_CR1_CEN);
+
+  /* Low half, update event is TRGO */
+  CYCLE_TIM_LO->PSC = 0;
+  CYCLE_TIM_LO->ARR = 0xffff;
+  MODIFY_REG(CYCLE_TIM_LO->CR2, TIM_CR2_MMS, TIM_CR2_MMS_1);
+  SET_BIT(CYCLE_TIM_LO->EGR, TIM_EGR_UG);
+  CYCLE_TIM_HI->CNT = 0;
+  SET_BIT(CYCLE_TIM_LO->CR1, TIM_CR1_CEN);
+}
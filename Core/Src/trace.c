@@ -0,0 +1,93 @@
+/**
+  ******************************************************************************
+  * File Name          : trace.c
+  * Description        : This file provides code for the event trace ring.
+  *                      Records are 8 bytes with a microsecond timestamp,
+  *                      the oldest ones are overwritten. Recording is
+  *                      ISR-safe. The dump is binary, Tools/tracejson turns
+  *                      it into Chrome trace JSON for Perfetto.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "trace.h"
+
+#ifdef TRACE_ON
+
+/* Private variables ---------------------------------------------------------*/
+static Trace_Record_TypeDef traceBuf[TRACE_LEN];
+static uint32_t traceIn = 0;
+static uint32_t traceLost = 0;
+static uint8_t tracePaused = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Records an event. Could be called from an ISR.
+  * @param  event: TRACE_EVENTS id.
+  * @param  arg: event argument.
+  * @param  value: event value.
+  * @retval none
+  */
+void Trace_Record(uint8_t event, uint8_t arg, uint16_t value) {
+  uint32_t primask = __get_PRIMASK();
+  Trace_Record_TypeDef *record;
+
+  __disable_irq();
+  if (!tracePaused) {
+    if (traceIn >= TRACE_LEN) traceLost++;
+    record = &traceBuf[traceIn++ & TRACE_MASK];
+    record->time = (uint32_t)Clock_Micros();
+    record->event = event;
+    record->arg = arg;
+    record->value = value;
+  }
+  __set_PRIMASK(primask);
+}
+
+
+
+
+
+/**
+  * @brief  Sends the trace into USART in binary and clears it. Recording
+  *         is paused meanwhile, so the dump doesn't trace itself.
+  * @param  none
+  * @retval none
+  */
+void Trace_Dump(void) {
+  uint32_t count = (traceIn < TRACE_LEN) ? traceIn : TRACE_LEN;
+  uint32_t lost = (traceLost > 0xffff) ? 0xffff : traceLost;
+  uint8_t header[TRACE_HEADER_LEN] = {
+    TRACE_MAGIC[0], TRACE_MAGIC[1], TRACE_MAGIC[2], TRACE_VERSION,
+    (uint8_t)count, (uint8_t)(count >> 8), (uint8_t)lost, (uint8_t)(lost >> 8)
+  };
+
+  tracePaused = 1;
+  USART1_TX_Flush();
+
+  USART1_TX_Write(header, TRACE_HEADER_LEN);
+  for (uint32_t i = traceIn - count; i != traceIn; i++) {
+    USART1_TX_Write((const uint8_t*)&traceBuf[i & TRACE_MASK], sizeof(Trace_Record_TypeDef));
+  }
+  USART1_TX_Flush();
+
+  traceIn = 0;
+  traceLost = 0;
+  tracePaused = 0;
+}
+
+#endif /* TRACE_ON */
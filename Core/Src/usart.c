@@ -16,6 +16,10 @@
 static uint8_t rxBuffer[RXBUF_LEN];
 static uint8_t rxBufPrtIn = 0;
 static uint8_t rxBufPrtOut = 0;
+static uint8_t txBuffer[TXBUF_LEN];
+static volatile uint8_t txBufPrtIn = 0;
+static volatile uint8_t txBufPrtOut = 0;
+static uint32_t currentBaud = 0;
 
 /* Private function prototypes -----------------------------------------------*/
 
@@ -35,8 +39,6 @@ static uint8_t rxBufPrtOut = 0;
   * @retval none
   */
 void USART1_Init(void) {
-  uint32_t baudRate = 115200;
-
   /* Enable GPIO alternative #1 on hight speed */
   USART_Port->MODER   |= ((_AF << (TX_Pin_Pos * 2U)) | (_AF << (RX_Pin_Pos * 2U)));
   USART_Port->OSPEEDR |= ((_HS << (TX_Pin_Pos * 2U)) | (_HS << (RX_Pin_Pos * 2U)));
@@ -49,10 +51,100 @@ void USART1_Init(void) {
   /* Receive enable */
   /* Enable RXNE Interrupt */
   SET_BIT(USART1->CR1, (USART_CR1_TE | USART_CR1_RE | USART_CR1_RXNEIE));
-  /* Set Baudrate */
-  USART1->BRR = ((SystemCoreClock + (baudRate / 2)) / baudRate);
-  /* Enable USART1 */
+  /* Set Baudrate and enable USART1 */
+  if (!USART1_SetBaudRate(USART_DEFAULT_BAUD, 0, 0)) {
+    Error_Handler();
+  }
+}
+
+
+
+
+
+
+/**
+  * @brief  Computes BRR value for the given baud rate. USART1 is clocked
+  *         by PCLK (48MHz), so 16x oversampling reaches 3Mb/s, whereas 8x
+  *         oversampling reaches 6Mb/s. In 8x mode BRR[3] must be kept cleared
+  *         and BRR[2:0] holds USARTDIV[3:0] shifted right, so the divider
+  *         resolution is the same as in 16x mode.
+  * @param  baudRate: requested baud rate.
+  * @param  over8: 1 selects 8x oversampling, 0 selects 16x oversampling.
+  * @param  brr: pointer where BRR value to be placed.
+  * @param  errorPpm: pointer where the real baud rate error (ppm) to be placed.
+  * @retval 1 when the rate is reachable within USART_BAUD_MAX_ERR, 0 otherwise.
+  */
+uint8_t USART1_CalcBRR(uint32_t baudRate, uint8_t over8, uint16_t *brr, int32_t *errorPpm) {
+  uint32_t fck = SystemCoreClock;
+  uint32_t div;
+  int32_t err;
+
+  if (!baudRate) return (0);
+
+  /* fck / baudRate rounded to the nearest divider */
+  div = (fck + (baudRate / 2)) / baudRate;
+
+  if (over8) {
+    if ((div < 8) || (div > 0x7fff)) return (0);
+    *brr = (uint16_t)(((div << 1) & 0xfff0) | (div & 0x0007));
+  } else {
+    if ((div < 16) || (div > 0xffff)) return (0);
+    *brr = (uint16_t)div;
+  }
+
+  /* Real rate is fck / div in both modes */
+  err = (int32_t)((((int64_t)fck * 1000000) / ((int64_t)div * baudRate)) - 1000000);
+  if (errorPpm) *errorPpm = err;
+
+  return ((err <= USART_BAUD_MAX_ERR) && (err >= -USART_BAUD_MAX_ERR));
+}
+
+
+
+
+
+
+/**
+  * @brief  Sets USART1 baud rate on the fly. The last frame in the shift
+  *         register is let out before the peripheral is stopped.
+  * @param  baudRate: requested baud rate.
+  * @param  over8: 1 selects 8x oversampling, 0 selects 16x oversampling.
+  * @param  errorPpm: pointer where the real baud rate error (ppm) to be placed,
+  *         could be null.
+  * @retval 1 when the rate has been set, 0 when it's unreachable and
+  *         the previous setting is kept.
+  */
+uint8_t USART1_SetBaudRate(uint32_t baudRate, uint8_t over8, int32_t *errorPpm) {
+  uint16_t brr = 0;
+
+  if (errorPpm) *errorPpm = 0;
+  if (!USART1_CalcBRR(baudRate, over8, &brr, errorPpm)) return (0);
+
+  if (READ_BIT(USART1->CR1, USART_CR1_UE)) {
+    USART1_TX_Flush();
+    CLEAR_BIT(USART1->CR1, USART_CR1_UE);
+  }
+
+  MODIFY_REG(USART1->CR1, USART_CR1_OVER8, (over8) ? USART_CR1_OVER8 : 0);
+  USART1->BRR = brr;
   SET_BIT(USART1->CR1, USART_CR1_UE);
+
+  currentBaud = baudRate;
+  return (1);
+}
+
+
+
+
+
+
+/**
+  * @brief  Returns currently set baud rate.
+  * @param  none
+  * @retval Baud rate.
+  */
+uint32_t USART1_GetBaudRate(void) {
+  return (currentBaud);
 }
 
 
@@ -66,7 +158,7 @@ void USART1_Init(void) {
   * @retval none
   */
 void USART1_RX_Handler() {
-  rxBuffer[(rxBufPrtIn++)] = (uint8_t)USART1->RDR;;
+  rxBuffer[(rxBufPrtIn++)] = USART_RDR_READ(USART1);
   rxBufPrtIn &= RXBUF_MASK;
 }
 
@@ -74,6 +166,94 @@ void USART1_RX_Handler() {
 
 
 
+/**
+  * @brief  Feeds TDR from the TX circular buffer, called by TXE interrupt.
+  *         TXE interrupt is disabled as soon as the buffer is drained.
+  * @param  none
+  * @retval none
+  */
+void USART1_TX_Handler(void) {
+  uint8_t out = txBufPrtOut;
+
+  if (out != txBufPrtIn) {
+    USART_TDR_WRITE(USART1, txBuffer[out]);
+    txBufPrtOut = (out + 1) & TXBUF_MASK;
+  } else {
+    CLEAR_BIT(USART1->CR1, USART_CR1_TXEIE);
+    TRACE(TRACE_UART_SENT, 0, 0);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Puts a symbol into the TX circular buffer. Waits only when
+  *         the buffer is full.
+  * @param  ch: a symbol to be sent.
+  * @retval none
+  */
+void USART1_TX_Put(uint8_t ch) {
+  uint8_t in = txBufPrtIn;
+  uint8_t next = (in + 1) & TXBUF_MASK;
+
+  BUSY_WAIT(WAIT_USART_TXE, next == txBufPrtOut);
+
+  txBuffer[in] = ch;
+  txBufPrtIn = next;
+  SET_BIT(USART1->CR1, USART_CR1_TXEIE);
+}
+
+
+
+
+
+/**
+  * @brief  Puts raw data into the TX circular buffer as is.
+  * @param  buf: pointer to the data.
+  * @param  len: length of the data.
+  * @retval none
+  */
+void USART1_TX_Write(const uint8_t *buf, uint16_t len) {
+  TRACE(TRACE_UART_QUEUED, 0, len);
+  while (len--) {
+    USART1_TX_Put(*buf++);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Waits until the TX circular buffer is drained and the last
+  *         frame has left the shift register.
+  * @param  none
+  * @retval none
+  */
+void USART1_TX_Flush(void) {
+  BUSY_WAIT(WAIT_USART_TXE, txBufPrtOut != txBufPrtIn);
+  BUSY_WAIT(WAIT_USART_TXE, READ_BIT(USART1->ISR, USART_ISR_TC) != USART_ISR_TC);
+}
+
+
+
+
+
+/**
+  * @brief  Returns the TX circular buffer backlog.
+  * @param  none
+  * @retval Bytes waiting in the buffer, TDR and the shift register aside.
+  */
+uint8_t USART1_TX_Pending(void) {
+  return ((uint8_t)((txBufPrtIn - txBufPrtOut) & TXBUF_MASK));
+}
+
+
+
+
+
 /**
   * @brief  Reads payload data into the circle buffer.
   * @param  buf: pointer to a buffer where dala to be placed.
@@ -85,7 +265,7 @@ void USART1_RX_Handler() {
   */
 uint8_t USART_RxBufferRead(uint8_t *buf, uint16_t len) {
   uint8_t payloadLen = 0;
-  while (rxBufPrtOut != rxBufPrtIn) {
+  while ((rxBufPrtOut != rxBufPrtIn) && (payloadLen < len)) {
     buf[(payloadLen++)] = rxBuffer[(rxBufPrtOut++)];
     rxBufPrtOut &= RXBUF_MASK;
   }
@@ -0,0 +1,172 @@
+/**
+  ******************************************************************************
+  * File Name          : wait.c
+  * Description        : This file provides code for the busy-wait and main
+  *                      loop accounting on the cycle counter. Every wait
+  *                      site keeps count, cycles and the longest wait, the
+  *                      main loop keeps min/avg/max pass time from wake up
+  *                      to the end of the scheduler pass. Counters are
+  *                      closed once per second, the report shows the last
+  *                      window. Sleeping sites (delays) overlap idle time,
+  *                      spinning sites are taken from the work time.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "wait.h"
+
+#ifdef WAIT_STATS
+
+/* Global variables ---------------------------------------------------------*/
+Wait_Entry_TypeDef waitTable[WAIT_COUNT];
+Wait_Loop_TypeDef waitLoop;
+
+/* Private variables ---------------------------------------------------------*/
+static Wait_Entry_TypeDef waitLast[WAIT_COUNT];
+static Wait_Loop_TypeDef loopLast;
+static uint64_t windowStart = 0;
+static uint32_t windowUs = 0;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint32_t Wait_Permille(uint32_t cycles);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Wait accounting Initialization procedure. Starts the cycle counter.
+  * @param  none
+  * @retval none
+  */
+void Wait_Init(void) {
+  #ifndef PROFILE
+    TIM3_Init();
+  #endif /* PROFILE */
+
+  waitLoop.min = UINT32_MAX;
+  windowStart = Clock_Micros();
+}
+
+
+
+
+
+/**
+  * @brief  Closes a wait.
+  * @param  entry: wait site entry.
+  * @param  end: cycle counter at the end of the wait.
+  * @retval none
+  */
+void Wait_Account(Wait_Entry_TypeDef *entry, uint32_t end) {
+  uint32_t cycles = end - entry->start;
+
+  entry->count++;
+  entry->cycles += cycles;
+  if (cycles > entry->max) entry->max = cycles;
+}
+
+
+
+
+
+/**
+  * @brief  Closes a main loop pass.
+  * @param  end: cycle counter at the end of the pass.
+  * @retval none
+  */
+void Wait_Loop(uint32_t end) {
+  uint32_t cycles = end - waitLoop.start;
+
+  waitLoop.count++;
+  waitLoop.cycles += cycles;
+  if (cycles < waitLoop.min) waitLoop.min = cycles;
+  if (cycles > waitLoop.max) waitLoop.max = cycles;
+}
+
+
+
+
+
+/**
+  * @brief  Closes the accounting window. It's called once per second.
+  * @param  none
+  * @retval none
+  */
+void Wait_Snapshot(void) {
+  uint64_t now = Clock_Micros();
+
+  windowUs = (uint32_t)(now - windowStart);
+  windowStart = now;
+
+  for (uint8_t i = 0; i < WAIT_COUNT; i++) {
+    waitLast[i] = waitTable[i];
+    waitTable[i].count = 0;
+    waitTable[i].cycles = 0;
+    waitTable[i].max = 0;
+  }
+
+  loopLast = waitLoop;
+  waitLoop.count = 0;
+  waitLoop.cycles = 0;
+  waitLoop.min = UINT32_MAX;
+  waitLoop.max = 0;
+}
+
+
+
+
+
+/**
+  * @brief  Converts cycles into the share of the last window.
+  * @param  cycles: core clock cycles.
+  * @retval Share of the window, 1/1000.
+  */
+static uint32_t Wait_Permille(uint32_t cycles) {
+  if (!windowUs) return (0);
+  return ((uint32_t)(((uint64_t)cycles * 1000U) / ((uint64_t)windowUs * (SystemCoreClock / 1000000U))));
+}
+
+
+
+
+
+/**
+  * @brief  Prints the status of the last window: wait sites, main loop
+  *         pass time and the split into idle, spinning and work.
+  * @param  none
+  * @retval none
+  */
+void Wait_Report(void) {
+  uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+  uint32_t idle = Sleep_IdlePermille();
+  uint32_t spin = 0;
+  uint32_t work;
+
+  #define WAIT_LOG(id, name, spinning) \
+    LOG(name ": %" PRIu32 " waits, %" PRIu32 " permille, max %" PRIu32 " us\n", \
+      waitLast[id].count, Wait_Permille(waitLast[id].cycles), waitLast[id].max / cyclesPerUs); \
+    if (spinning) spin += Wait_Permille(waitLast[id].cycles);
+  WAIT_SITES(WAIT_LOG)
+  #undef WAIT_LOG
+
+  if (loopLast.count) {
+    LOG("loop: %" PRIu32 " passes, min %" PRIu32 " avg %" PRIu32 " max %" PRIu32 " us\n", loopLast.count,
+      loopLast.min / cyclesPerUs, loopLast.cycles / loopLast.count / cyclesPerUs,
+      loopLast.max / cyclesPerUs);
+  }
+
+  work = ((idle + spin) < 1000U) ? (1000U - idle - spin) : 0;
+  LOG("cpu: idle %" PRIu32 " spin %" PRIu32 " work %" PRIu32 " permille\n", idle, spin, work);
+}
+
+#endif /* WAIT_STATS */
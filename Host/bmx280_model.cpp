@@ -0,0 +1,355 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_model.cpp
+  * Description        : BMP280/BME280 SPI slave model. SPI transactions
+  *                      are those of the datasheet 4-wire mode: a register
+  *                      address byte with bit 7 set starts an auto
+  *                      incremented read, with bit 7 clear it's followed by
+  *                      the data byte, address and data pairs may repeat.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstring>
+
+#include "bmx280_model.h"
+
+namespace Sim {
+
+namespace {
+
+const uint8_t REG_CALIB     = 0x88;
+const uint8_t REG_H1        = 0xa1;
+const uint8_t REG_ID        = 0xd0;
+const uint8_t REG_RESET     = 0xe0;
+const uint8_t REG_CALIB_H   = 0xe1;
+const uint8_t REG_CTRL_HUM  = 0xf2;
+const uint8_t REG_STATUS    = 0xf3;
+const uint8_t REG_CTRL_MEAS = 0xf4;
+const uint8_t REG_CONFIG    = 0xf5;
+const uint8_t REG_DATA      = 0xf7;
+const uint8_t DATA_LEN      = 8;
+
+const uint8_t RESET_VALUE   = 0xb6;
+const uint8_t STATUS_MEASURING = 0x08;
+
+const int32_t SKIPPED_TP    = 0x80000;
+const int32_t SKIPPED_H     = 0x8000;
+
+uint32_t OvsCount(uint8_t code) {
+  if (!code) return (0);
+  if (code > 5) code = 5;
+  return (1U << (code - 1));
+}
+
+/* 20-bit result resolution is 16 bits at x1, one bit more per step */
+int32_t Resolution(int32_t raw, uint8_t code) {
+  if (!code) return (SKIPPED_TP);
+  if (code > 5) code = 5;
+  return (raw & ~((1 << (5 - code)) - 1));
+}
+
+/* First value in [lo, hi) where the predicate holds, it's monotonic */
+template <typename Pred>
+int32_t Search(int32_t lo, int32_t hi, Pred pred) {
+  while (lo < hi) {
+    int32_t mid = lo + ((hi - lo) / 2);
+    if (pred(mid)) hi = mid;
+    else lo = mid + 1;
+  }
+  return (lo);
+}
+
+void Put16(uint8_t *p, uint16_t value) {
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+}
+
+} // namespace
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+Bmx280Model::Bmx280Model(bool bme280, const Bmx280Calibration &calibration)
+  : bme(bme280), calib(calibration) {
+  environment = [](Time) { return Environment(); };
+  Reset();
+}
+
+
+
+
+
+void Bmx280Model::SetEnvironment(std::function<Environment(Time)> env) {
+  environment = env;
+}
+
+
+
+
+
+void Bmx280Model::Reset(void) {
+  memset(regs, 0, sizeof(regs));
+
+  uint8_t *p = &regs[REG_CALIB];
+  Put16(p + 0, calib.T1);
+  Put16(p + 2, (uint16_t)calib.T2);
+  Put16(p + 4, (uint16_t)calib.T3);
+  Put16(p + 6, calib.P1);
+  Put16(p + 8, (uint16_t)calib.P2);
+  Put16(p + 10, (uint16_t)calib.P3);
+  Put16(p + 12, (uint16_t)calib.P4);
+  Put16(p + 14, (uint16_t)calib.P5);
+  Put16(p + 16, (uint16_t)calib.P6);
+  Put16(p + 18, (uint16_t)calib.P7);
+  Put16(p + 20, (uint16_t)calib.P8);
+  Put16(p + 22, (uint16_t)calib.P9);
+  regs[REG_ID] = (bme) ? BME280_ID : BMP280_ID;
+
+  if (bme) {
+    regs[REG_H1] = calib.H1;
+    p = &regs[REG_CALIB_H];
+    Put16(p + 0, (uint16_t)calib.H2);
+    p[2] = calib.H3;
+    p[3] = (uint8_t)(calib.H4 >> 4);
+    p[4] = (uint8_t)((calib.H4 & 0x0f) | ((calib.H5 & 0x0f) << 4));
+    p[5] = (uint8_t)(calib.H5 >> 4);
+    p[6] = (uint8_t)calib.H6;
+  }
+
+  /* Data registers read as skipped until the first conversion */
+  regs[REG_DATA + 0] = 0x80;
+  regs[REG_DATA + 3] = 0x80;
+  regs[REG_DATA + 6] = 0x80;
+  memcpy(latched, &regs[REG_DATA], DATA_LEN);
+
+  measuring = false;
+  measureEnd = 0;
+}
+
+
+
+
+
+/**
+  * @brief  Measurement time, datasheet maximum of the oversampling settings.
+  */
+Time Bmx280Model::MeasureTime(void) const {
+  uint8_t meas = regs[REG_CTRL_MEAS];
+  uint32_t t = OvsCount(meas >> 5);
+  uint32_t p = OvsCount((meas >> 2) & 7);
+  uint32_t h = (bme) ? OvsCount(regs[REG_CTRL_HUM] & 7) : 0;
+  Time us = 1250 + (2300 * t);
+
+  if (p) us += (2300 * p) + 575;
+  if (h) us += (2300 * h) + 575;
+  return (us * US);
+}
+
+
+
+
+
+void Bmx280Model::Convert(Time time) {
+  Environment env = environment(time);
+  uint8_t meas = regs[REG_CTRL_MEAS];
+  uint8_t ovsH = regs[REG_CTRL_HUM] & 7;
+
+  int32_t t = Resolution(RawTemperature(env.temperature), meas >> 5);
+  int32_t p = Resolution(RawPressure(env.pressure, env.temperature), (meas >> 2) & 7);
+  int32_t h = (ovsH) ? RawHumidity(env.humidity, env.temperature) : SKIPPED_H;
+
+  regs[REG_DATA + 0] = (uint8_t)(p >> 12);
+  regs[REG_DATA + 1] = (uint8_t)(p >> 4);
+  regs[REG_DATA + 2] = (uint8_t)(p << 4);
+  regs[REG_DATA + 3] = (uint8_t)(t >> 12);
+  regs[REG_DATA + 4] = (uint8_t)(t >> 4);
+  regs[REG_DATA + 5] = (uint8_t)(t << 4);
+  if (bme) {
+    regs[REG_DATA + 6] = (uint8_t)(h >> 8);
+    regs[REG_DATA + 7] = (uint8_t)h;
+  }
+  conversions++;
+}
+
+
+
+
+
+/**
+  * @brief  Brings conversions up to the given time.
+  */
+void Bmx280Model::Update(Time time) {
+  static const uint32_t standbyBmp[8] = { 500, 62500, 125000, 250000, 500000, 1000000, 2000000, 4000000 };
+  static const uint32_t standbyBme[8] = { 500, 62500, 125000, 250000, 500000, 1000000, 10000, 20000 };
+  uint8_t mode = regs[REG_CTRL_MEAS] & 3;
+
+  if (measuring && (time >= measureEnd)) {
+    Convert(measureEnd);
+    measuring = false;
+    if (mode != 3) regs[REG_CTRL_MEAS] &= ~3;
+  }
+
+  /* Normal mode measures and stands by in turn */
+  if (mode == 3) {
+    uint8_t sb = regs[REG_CONFIG] >> 5;
+    Time standby = ((bme) ? standbyBme[sb] : standbyBmp[sb]) * US;
+    while (!measuring && (nextNormal <= time)) {
+      measuring = true;
+      measureEnd = nextNormal + MeasureTime();
+      if (conversionStart) conversionStart(nextNormal);
+      nextNormal = measureEnd + standby;
+      if (time >= measureEnd) {
+        Convert(measureEnd);
+        measuring = false;
+      }
+    }
+  }
+
+  regs[REG_STATUS] = (measuring) ? STATUS_MEASURING : 0;
+}
+
+
+
+
+
+void Bmx280Model::Write(Time time, uint8_t reg, uint8_t data) {
+  switch (reg) {
+    case REG_RESET:
+      if (data == RESET_VALUE) Reset();
+      break;
+
+    case REG_CTRL_HUM:
+      if (bme) regs[reg] = data & 7;
+      break;
+
+    case REG_CONFIG:
+      regs[reg] = data & 0xfd;
+      break;
+
+    case REG_CTRL_MEAS:
+      regs[reg] = data;
+      measuring = false;
+      if (((data & 3) == 1) || ((data & 3) == 2)) {
+        measuring = true;
+        measureEnd = time + MeasureTime();
+        if (conversionStart) conversionStart(time);
+      } else if ((data & 3) == 3) {
+        nextNormal = time;
+      }
+      Update(time);
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+
+
+
+uint8_t Bmx280Model::Read(uint8_t r) const {
+  if ((r >= REG_DATA) && (r < REG_DATA + DATA_LEN)) {
+    if (!bme && (r >= REG_DATA + 6)) return (0);
+    return (latched[r - REG_DATA]);
+  }
+  return (regs[r]);
+}
+
+
+
+
+
+void Bmx280Model::Select(Time time, bool sel) {
+  Update(time);
+  selected = sel;
+  address = true;
+
+  /* A burst read gets the data of one conversion */
+  if (sel) memcpy(latched, &regs[REG_DATA], DATA_LEN);
+}
+
+
+
+
+
+uint8_t Bmx280Model::Transfer(Time time, uint8_t mosi) {
+  if (!selected) return (0xff);
+  Update(time);
+
+  if (address) {
+    reg = mosi | 0x80;
+    reading = (mosi & 0x80) != 0;
+    address = false;
+    return (0xff);
+  }
+
+  if (reading) return (Read(reg++));
+
+  Write(time, reg, mosi);
+  address = true;
+  return (0xff);
+}
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/* Bosch double precision compensation, datasheet section 8.1 */
+double Bmx280Model::TFine(int32_t adcT) const {
+  double var1 = (((double)adcT / 16384.0) - ((double)calib.T1 / 1024.0)) * (double)calib.T2;
+  double var2 = ((double)adcT / 131072.0) - ((double)calib.T1 / 8192.0);
+  var2 = var2 * var2 * (double)calib.T3;
+  return (var1 + var2);
+}
+
+double Bmx280Model::Pressure(int32_t adcP, double tFine) const {
+  double var1 = (tFine / 2.0) - 64000.0;
+  double var2 = var1 * var1 * (double)calib.P6 / 32768.0;
+  var2 = var2 + (var1 * (double)calib.P5 * 2.0);
+  var2 = (var2 / 4.0) + ((double)calib.P4 * 65536.0);
+  var1 = (((double)calib.P3 * var1 * var1 / 524288.0) + ((double)calib.P2 * var1)) / 524288.0;
+  var1 = (1.0 + (var1 / 32768.0)) * (double)calib.P1;
+  if (var1 == 0.0) return (0);
+
+  double p = 1048576.0 - (double)adcP;
+  p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+  var1 = (double)calib.P9 * p * p / 2147483648.0;
+  var2 = p * (double)calib.P8 / 32768.0;
+  return (p + ((var1 + var2 + (double)calib.P7) / 16.0));
+}
+
+double Bmx280Model::Humidity(int32_t adcH, double tFine) const {
+  double h = tFine - 76800.0;
+  h = ((double)adcH - (((double)calib.H4 * 64.0) + ((double)calib.H5 / 16384.0 * h)))
+    * ((double)calib.H2 / 65536.0 * (1.0 + ((double)calib.H6 / 67108864.0 * h * (1.0 + ((double)calib.H3 / 67108864.0 * h)))));
+  h = h * (1.0 - ((double)calib.H1 * h / 524288.0));
+  if (h > 100.0) h = 100.0;
+  if (h < 0.0) h = 0.0;
+  return (h);
+}
+
+int32_t Bmx280Model::RawTemperature(double temperature) const {
+  return (Search(0, 1 << 20, [&](int32_t adc) { return (TFine(adc) / 5120.0) >= temperature; }));
+}
+
+/* Pressure falls as the ADC value rises */
+int32_t Bmx280Model::RawPressure(double pressure, double temperature) const {
+  double tFine = TFine(RawTemperature(temperature));
+  return (Search(0, 1 << 20, [&](int32_t adc) { return Pressure(adc, tFine) <= pressure; }));
+}
+
+int32_t Bmx280Model::RawHumidity(double humidity, double temperature) const {
+  double tFine = TFine(RawTemperature(temperature));
+  return (Search(0, 1 << 16, [&](int32_t adc) { return Humidity(adc, tFine) >= humidity; }));
+}
+
+} // namespace Sim
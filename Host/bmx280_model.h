@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_model.h
+  * Description        : SPI slave model of the Bosch BMP280 and BME280
+  *                      sensors for the host simulation. Readings come from
+  *                      an environment function of time, the raw ADC values
+  *                      are what the Bosch compensation formulas turn back
+  *                      into that environment. Forced and normal modes take
+  *                      the datasheet maximum measurement time, the IIR
+  *                      filter isn't modelled.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BMX280_MODEL_H
+#define __BMX280_MODEL_H
+
+#include <cstdint>
+#include <functional>
+
+#include "simulator.h"
+
+namespace Sim {
+
+struct Environment {
+  double    temperature = 25.0;       // degC
+  double    pressure    = 101325.0;   // Pa
+  double    humidity    = 40.0;       // %RH
+};
+
+/* Trimming parameters, the datasheet example values by default */
+struct Bmx280Calibration {
+  uint16_t  T1 = 27504;
+  int16_t   T2 = 26435;
+  int16_t   T3 = -1000;
+  uint16_t  P1 = 36477;
+  int16_t   P2 = -10685;
+  int16_t   P3 = 3024;
+  int16_t   P4 = 2855;
+  int16_t   P5 = 140;
+  int16_t   P6 = -7;
+  int16_t   P7 = 15500;
+  int16_t   P8 = -14600;
+  int16_t   P9 = 6000;
+  uint8_t   H1 = 75;
+  int16_t   H2 = 362;
+  uint8_t   H3 = 0;
+  int16_t   H4 = 313;
+  int16_t   H5 = 50;
+  int8_t    H6 = 30;
+};
+
+class Bmx280Model : public SpiSlave {
+public:
+  static const uint8_t BMP280_ID = 0x58;
+  static const uint8_t BME280_ID = 0x60;
+
+  explicit Bmx280Model(bool bme280 = false, const Bmx280Calibration &calibration = Bmx280Calibration());
+
+  void SetEnvironment(std::function<Environment(Time)> environment);
+
+  void Select(Time time, bool selected) override;
+  uint8_t Transfer(Time time, uint8_t mosi) override;
+
+  /* Completed conversions */
+  uint32_t Conversions(void) const { return conversions; }
+
+  /* Optional observer of conversion starts */
+  std::function<void(Time)> conversionStart;
+
+  /* Raw ADC values of an environment, as the sensor would report them */
+  int32_t RawTemperature(double temperature) const;
+  int32_t RawPressure(double pressure, double temperature) const;
+  int32_t RawHumidity(double humidity, double temperature) const;
+
+private:
+  void Reset(void);
+  void Update(Time time);
+  void Convert(Time time);
+  void Write(Time time, uint8_t reg, uint8_t data);
+  uint8_t Read(uint8_t reg) const;
+  Time MeasureTime(void) const;
+
+  double TFine(int32_t adcT) const;
+  double Pressure(int32_t adcP, double tFine) const;
+  double Humidity(int32_t adcH, double tFine) const;
+
+  bool      bme;
+  Bmx280Calibration calib;
+  std::function<Environment(Time)> environment;
+
+  uint8_t   regs[256];
+  uint8_t   latched[8];     // Data registers at the chip select
+  bool      selected = false;
+  bool      address = true; // Next byte is a register address
+  bool      reading = false;
+  uint8_t   reg = 0;
+  Time      measureEnd = 0;
+  bool      measuring = false;
+  Time      nextNormal = 0;
+  uint32_t  conversions = 0;
+};
+
+} // namespace Sim
+
+#endif /* __BMX280_MODEL_H */
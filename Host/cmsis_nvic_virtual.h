@@ -0,0 +1,29 @@
+/**
+  ******************************************************************************
+  * File Name          : cmsis_nvic_virtual.h
+  * Description        : CMSIS virtual NVIC for the host simulation. ISER and
+  *                      ICER are write-one registers, which a plain memory
+  *                      register file can't keep, so the simulator holds
+  *                      enable and pending state itself.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __CMSIS_NVIC_VIRTUAL_H
+#define __CMSIS_NVIC_VIRTUAL_H
+
+#define NVIC_SetPriorityGrouping    __NVIC_SetPriorityGrouping
+#define NVIC_GetPriorityGrouping    __NVIC_GetPriorityGrouping
+#define NVIC_EnableIRQ(IRQn)        Sim_NVIC_EnableIRQ((int32_t)(IRQn))
+#define NVIC_GetEnableIRQ(IRQn)     Sim_NVIC_GetEnableIRQ((int32_t)(IRQn))
+#define NVIC_DisableIRQ(IRQn)       Sim_NVIC_DisableIRQ((int32_t)(IRQn))
+#define NVIC_GetPendingIRQ(IRQn)    Sim_NVIC_GetPendingIRQ((int32_t)(IRQn))
+#define NVIC_SetPendingIRQ(IRQn)    Sim_NVIC_SetPendingIRQ((int32_t)(IRQn))
+#define NVIC_ClearPendingIRQ(IRQn)  Sim_NVIC_ClearPendingIRQ((int32_t)(IRQn))
+#define NVIC_SetPriority            __NVIC_SetPriority
+#define NVIC_GetPriority            __NVIC_GetPriority
+#define NVIC_SystemReset()          Sim_Fault("system reset")
+
+#endif /* __CMSIS_NVIC_VIRTUAL_H */
@@ -0,0 +1,339 @@
+/**
+  ******************************************************************************
+  * File Name          : pipebench.cpp
+  * Description        : Throughput benchmark of the sample pipeline of the
+  *                      firmware in virtual time: measurement trigger,
+  *                      status polls, burst read by SPI_Read(), compensation,
+  *                      formatting and _write() down to the last bit on the
+  *                      TX pin. Every combination of the given SPI rates,
+  *                      baud rates and oversampling codes runs in a fresh
+  *                      firmware, the stages are told apart by the SPI
+  *                      frames and the UART output of every sample.
+  *
+  *                      pipebench [-s hz,..] [-b baud,..] [-o t:p,..]
+  *                                [-n samples] [-C cycles] [-e]
+  *
+  *                      -s  SPI1 bit rates, k and M suffixes, 0 keeps the
+  *                          firmware prescaler, that is the default
+  *                      -b  baud rates set by the "baud" command, 0 keeps
+  *                          the firmware default
+  *                      -o  oversampling codes set by the "ovs" command,
+  *                          1:1 by default
+  *                      -n  samples averaged per configuration, 8 by default
+  *                      -C  core cycles of compensation and formatting per
+  *                          sample, e.g. from the "prof" report on the
+  *                          target. The simulation runs the code in no time,
+  *                          it's 0 by default
+  *                      -e  BME280 instead of BMP280
+  *
+  *                      Stage times are means in us. The sample task is
+  *                      serial up to the burst read and the compensation,
+  *                      the TX ring drains the lines meanwhile, so the
+  *                      sustainable rate is set by the longer of the two.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "bmx280_model.h"
+
+extern "C" {
+extern uint32_t SystemCoreClock;
+}
+
+using namespace Sim;
+
+/* Sensor commands as they appear on the bus */
+static const uint8_t CMD_CTRL_MEAS = 0x74;
+static const uint8_t CMD_STATUS = 0xf3;
+static const uint8_t CMD_DATA = 0xf7;
+
+/* Console commands go in once the firmware is up, samples before are dropped */
+static const Time INPUT_AT = 700 * MS;
+static const Time SETTLED = SEC;
+
+struct Config {
+  uint32_t  spiHz;
+  uint32_t  baud;
+  uint8_t   ovsT;
+  uint8_t   ovsP;
+};
+
+/* Stage boundaries of one pass through the pipeline */
+struct Sample {
+  Time      start = 0;        // ctrl_meas write selected
+  Time      triggerEnd = 0;   // ctrl_meas write deselected
+  Time      statusEnd = 0;    // Last status read deselected
+  Time      burstStart = 0;
+  Time      burstEnd = 0;
+  Time      outStart = 0;     // Start bit of the first output byte
+  Time      outEnd = 0;       // Stop bit of the pressure line LF
+  uint32_t  polls = 0;
+  uint32_t  bytes = 0;
+};
+
+/* Passes the traffic to the sensor model and splits it into samples */
+class BusTap : public SpiSlave {
+public:
+  explicit BusTap(SpiSlave *slave) : slave(slave) {}
+
+  void Select(Time time, bool selected) override {
+    slave->Select(time, selected);
+    if (selected) {
+      frameStart = time;
+      frameBytes = 0;
+    } else if (frameBytes) {
+      Frame(time);
+    }
+  }
+
+  uint8_t Transfer(Time time, uint8_t mosi) override {
+    if (!frameBytes) frameCmd = mosi;
+    frameBytes++;
+    return slave->Transfer(time, mosi);
+  }
+
+  void Output(Time time, uint8_t data, Time charTime) {
+    if (!reading) return;
+    if (!current.bytes) current.outStart = time - charTime;
+    current.bytes++;
+
+    if (data == '\n') {
+      if (line.compare(0, 6, "press:") == 0) {
+        current.outEnd = time;
+        if (current.start >= SETTLED) samples.push_back(current);
+        reading = false;
+      }
+      line.clear();
+    } else if ((data != '\r') && (line.size() < 16)) {
+      line += (char)data;
+    }
+  }
+
+  std::vector<Sample> samples;
+
+private:
+  void Frame(Time end) {
+    switch (frameCmd) {
+      case CMD_CTRL_MEAS:
+        current = Sample();
+        current.start = frameStart;
+        current.triggerEnd = end;
+        current.statusEnd = end;
+        measuring = true;
+        reading = false;
+        break;
+      case CMD_STATUS:
+        if (!measuring) break;
+        current.polls++;
+        current.statusEnd = end;
+        break;
+      case CMD_DATA:
+        if (!measuring) break;
+        current.burstStart = frameStart;
+        current.burstEnd = end;
+        measuring = false;
+        reading = true;
+        line.clear();
+        break;
+    }
+  }
+
+  SpiSlave  *slave;
+  Time      frameStart = 0;
+  uint32_t  frameBytes = 0;
+  uint8_t   frameCmd = 0;
+  bool      measuring = false;
+  bool      reading = false;
+  Sample    current;
+  std::string line;
+};
+
+static uint32_t ParseRate(const char *arg) {
+  char *end;
+  double value = strtod(arg, &end);
+
+  if (*end == 'k') value *= 1e3;
+  if (*end == 'M') value *= 1e6;
+  return ((value > 0) ? (uint32_t)value : 0);
+}
+
+static std::vector<std::string> Split(const char *arg) {
+  std::vector<std::string> items;
+  std::string item;
+
+  for (const char *c = arg; ; c++) {
+    if (!*c || (*c == ',')) {
+      if (!item.empty()) items.push_back(item);
+      item.clear();
+      if (!*c) break;
+    } else {
+      item += *c;
+    }
+  }
+  return items;
+}
+
+static double Mean(const std::vector<Sample> &samples, Time (*stage)(const Sample&)) {
+  double sum = 0;
+  for (const Sample &s : samples) sum += (double)stage(s);
+  return (sum / samples.size() / US);
+}
+
+/* Runs one configuration in this process, prints its row */
+static int Run(const Config &config, uint32_t count, uint32_t computeCycles, bool bme) {
+  Options options;
+  options.spiHz = config.spiHz;
+
+  Bmx280Model sensor(bme);
+  BusTap tap(&sensor);
+
+  Init(options);
+  Attach(&tap);
+  Observe().uartTx = [&](Time time, uint8_t data) {
+    uint32_t baud = UartBaud();
+    tap.Output(time, data, (baud) ? ((10 * SEC) / baud) : 0);
+  };
+
+  char cmd[32];
+  snprintf(cmd, sizeof(cmd), "ovs %u %u\r", config.ovsT, config.ovsP);
+  UartInputAt(INPUT_AT, cmd);
+  if (config.baud) {
+    snprintf(cmd, sizeof(cmd), "baud %u\r", config.baud);
+    UartInputAt(INPUT_AT, cmd);
+  }
+
+  Stop stop = Stop::Deadline;
+  Time end = SETTLED + (count + 3) * SEC;
+  for (Time t = SETTLED; (t <= end) && (tap.samples.size() < count); t += SEC) {
+    stop = RunUntil(t);
+    if (stop != Stop::Deadline) break;
+  }
+
+  char ovs[8];
+  snprintf(ovs, sizeof(ovs), "%u:%u", config.ovsT, config.ovsP);
+  printf("%9.1f %7u %5s |", SpiRate() / 1e3, UartBaud(), ovs);
+
+  if (stop != Stop::Deadline) {
+    printf(" %s\n", (stop == Stop::Fault) ? FaultReason().c_str() : "watchdog reset");
+    return (1);
+  }
+  if (tap.samples.empty()) {
+    printf(" no samples\n");
+    return (1);
+  }
+
+  const std::vector<Sample> &s = tap.samples;
+  double trigger = Mean(s, [](const Sample &x) { return x.triggerEnd - x.start; });
+  double conversion = Mean(s, [](const Sample &x) { return x.statusEnd - x.triggerEnd; });
+  double settle = Mean(s, [](const Sample &x) { return x.burstStart - x.statusEnd; });
+  double burst = Mean(s, [](const Sample &x) { return x.burstEnd - x.burstStart; });
+  double output = Mean(s, [](const Sample &x) { return x.outEnd - x.outStart; });
+  double compute = (double)computeCycles * 1e6 / SystemCoreClock;
+  double polls = 0;
+  for (const Sample &x : s) polls += x.polls;
+  polls /= s.size();
+
+  /* The task runs through the burst read and compensation, the lines drain
+     under the next sample */
+  double serial = trigger + conversion + settle + burst + compute;
+  double period = (output > serial) ? output : serial;
+  const char *limit = "uart";
+  if (serial >= output) {
+    struct { const char *name; double us; } stages[] = {
+      { "trigger", trigger }, { "conversion", conversion }, { "settle", settle },
+      { "burst", burst }, { "compute", compute } };
+    limit = stages[0].name;
+    double longest = stages[0].us;
+    for (const auto &stage : stages) {
+      if (stage.us > longest) {
+        limit = stage.name;
+        longest = stage.us;
+      }
+    }
+  }
+
+  printf(" %8.1f %10.1f %5.1f %8.1f %8.1f %8.1f %8.1f | %9.1f %8.1f  %s\n",
+    trigger, conversion, polls, settle, burst, compute, output,
+    serial + output, 1e6 / period, limit);
+  return (0);
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: pipebench [-s hz,..] [-b baud,..] [-o t:p,..] [-n samples] [-C cycles] [-e]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  std::vector<uint32_t> spiRates = { 0 };
+  std::vector<uint32_t> bauds = { 0 };
+  std::vector<std::pair<uint8_t, uint8_t>> ovs = { { 1, 1 } };
+  uint32_t count = 8;
+  uint32_t computeCycles = 0;
+  bool bme = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "s:b:o:n:C:e")) != -1) {
+    switch (opt) {
+      case 's':
+        spiRates.clear();
+        for (const std::string &item : Split(optarg)) spiRates.push_back(ParseRate(item.c_str()));
+        break;
+      case 'b':
+        bauds.clear();
+        for (const std::string &item : Split(optarg)) bauds.push_back(ParseRate(item.c_str()));
+        break;
+      case 'o':
+        ovs.clear();
+        for (const std::string &item : Split(optarg)) {
+          unsigned t, p;
+          if ((sscanf(item.c_str(), "%u:%u", &t, &p) != 2) || !t || (t > 5) || (p > 5)) Usage();
+          ovs.push_back({ (uint8_t)t, (uint8_t)p });
+        }
+        break;
+      case 'n': count = (uint32_t)atoi(optarg); break;
+      case 'C': computeCycles = (uint32_t)atoi(optarg); break;
+      case 'e': bme = true; break;
+      default: Usage();
+    }
+  }
+  if (!count || spiRates.empty() || bauds.empty() || ovs.empty()) Usage();
+
+  printf("%9s %7s %5s | %8s %10s %5s %8s %8s %8s %8s | %9s %8s  %s\n",
+    "spi kHz", "baud", "ovs", "trigger", "conversion", "polls", "settle", "burst",
+    "compute", "output", "chain us", "max/s", "limit");
+
+  /* The firmware keeps its state in globals, every run gets a fresh copy */
+  int failed = 0;
+  for (uint32_t spiHz : spiRates) {
+    for (uint32_t baud : bauds) {
+      for (const auto &o : ovs) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) {
+          perror("fork");
+          return (1);
+        }
+        if (!pid) {
+          int status = Run({ spiHz, baud, o.first, o.second }, count, computeCycles, bme);
+          fflush(stdout);
+          _exit(status);
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) failed = 1;
+      }
+    }
+  }
+  return (failed);
+}
@@ -0,0 +1,353 @@
+/**
+  ******************************************************************************
+  * File Name          : replay.cpp
+  * Description        : Replays SPI traffic captured by an SPI_CAPTURE build
+  *                      into the firmware on the simulated STM32F030. The
+  *                      sensor is replaced by the capture: reads get the
+  *                      captured bytes, writes are checked against it, so
+  *                      the firmware sees the bus as it was in the field.
+  *                      The firmware here is built without SPI_CAPTURE.
+  *
+  *                      replay [-b boot] [-i time:line]... [-l] [-o] [-v]
+  *                             [-d] capture.bin
+  *
+  *                      -b  boot to replay, a capture is split into boots
+  *                          by the sensor ID reads, the first by default
+  *                      -i  console line typed at the given second of the
+  *                          replay, as it was in the field, e.g. -i 3:lp on
+  *                      -l  loose matching for driver changes: repeated
+  *                          transactions (status polls) may differ in count,
+  *                          an extra one gets the last answer again, a
+  *                          missing one is skipped
+  *                      -o  firmware output
+  *                      -v  every transaction with both timestamps
+  *                      -d  decode the capture and exit
+  *
+  *                      Exit status is 1 when the firmware went off the
+  *                      capture or didn't get through it.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "spi_capture.h"
+#include "trace_events.h"
+
+using namespace Sim;
+
+/* Must match Core/Inc/log.h */
+static const uint8_t LOG_SYNC      = 0xf0;
+static const uint8_t LOG_SYNC_MASK = 0xf8;
+static const uint8_t LOG_MAX_ARGS  = 6;
+
+/* Sensor commands as they appear on the bus */
+static const uint8_t CMD_ID = 0xd0;
+static const uint8_t CMD_CTRL_MEAS = 0x74;
+static const uint8_t CMD_DATA = 0xf7;
+
+struct Transaction {
+  bool      write;
+  uint8_t   cmd;
+  std::vector<uint8_t> data;
+  uint64_t  time;             // us, unwrapped
+};
+
+/* Picks capture frames out of the raw TX stream, text, LOG frames and trace
+   dumps are stepped over */
+static std::vector<Transaction> Parse(const std::vector<uint8_t> &raw) {
+  std::vector<Transaction> out;
+  uint64_t time = 0;
+  uint32_t last = 0;
+  size_t i = 0;
+
+  while (i < raw.size()) {
+    const uint8_t *p = &raw[i];
+    size_t left = raw.size() - i;
+
+    if ((p[0] & SPI_CAPTURE_SYNC_MASK) == SPI_CAPTURE_READ) {
+      if ((left < SPI_CAPTURE_HEADER_LEN) || (left < (size_t)SPI_CAPTURE_HEADER_LEN + p[2])) break;
+      uint32_t stamp = (uint32_t)p[3] | ((uint32_t)p[4] << 8) | ((uint32_t)p[5] << 16) | ((uint32_t)p[6] << 24);
+      time = (out.empty()) ? stamp : (time + (uint32_t)(stamp - last));
+      last = stamp;
+      out.push_back({ (p[0] == SPI_CAPTURE_WRITE), p[1],
+        std::vector<uint8_t>(p + SPI_CAPTURE_HEADER_LEN, p + SPI_CAPTURE_HEADER_LEN + p[2]), time });
+      i += SPI_CAPTURE_HEADER_LEN + p[2];
+    } else if (((p[0] & LOG_SYNC_MASK) == LOG_SYNC) && ((p[0] & ~LOG_SYNC_MASK) <= LOG_MAX_ARGS)) {
+      i += 3 + ((p[0] & ~LOG_SYNC_MASK) * 4);
+    } else if ((left >= TRACE_HEADER_LEN) && !memcmp(p, TRACE_MAGIC, 3) && (p[3] == TRACE_VERSION)) {
+      i += TRACE_HEADER_LEN + ((p[4] | (p[5] << 8)) * 8);
+    } else {
+      i++;
+    }
+  }
+  return out;
+}
+
+static void Print(const char *prefix, const Transaction &t, uint64_t base) {
+  printf("%s%12.6f %s 0x%02x %3zu:", prefix, (double)(t.time - base) / 1e6,
+    (t.write) ? "W" : "R", t.cmd, t.data.size());
+  for (size_t i = 0; (i < t.data.size()) && (i < 16); i++) printf(" %02x", t.data[i]);
+  if (t.data.size() > 16) printf(" ..");
+  printf("\n");
+}
+
+/* Stands for the sensor, answers from the capture */
+class ReplaySlave : public SpiSlave {
+public:
+  ReplaySlave(const std::vector<Transaction> &capture, bool loose, bool verbose)
+    : capture(capture), loose(loose), verbose(verbose) {}
+
+  void Select(Time time, bool selected) override {
+    if (selected) {
+      bytes = 0;
+    } else if (bytes) {
+      Finish(time);
+    }
+  }
+
+  uint8_t Transfer(Time time, uint8_t mosi) override {
+    uint8_t miso = 0xff;
+
+    if (!bytes) {
+      start = time;
+      cmd = mosi;
+      sent.clear();
+      current = (diverged) ? nullptr : Match(mosi);
+    } else {
+      size_t index = bytes - 1;
+      sent.push_back(mosi);
+      if (current && !current->write && (index < current->data.size())) miso = current->data[index];
+    }
+    bytes++;
+    return miso;
+  }
+
+  bool Done(void) const { return diverged || (cursor >= capture.size()); }
+
+  const std::vector<Transaction> &capture;
+  bool      loose;
+  bool      verbose;
+  size_t    cursor = 0;
+  bool      diverged = false;
+  std::string divergence;
+  uint32_t  repeated = 0;     // Extra transactions answered again, loose
+  uint32_t  skipped = 0;      // Captured ones the firmware didn't make, loose
+  std::vector<std::pair<size_t, Time>> matched;
+
+private:
+  const Transaction* Match(uint8_t mosi) {
+    if (cursor >= capture.size()) {
+      Diverge("the firmware went on after the capture end");
+      return nullptr;
+    }
+    if (loose) {
+      /* The firmware polls more than the capture did */
+      if ((capture[cursor].cmd != mosi) && previous && (previous->cmd == mosi)) {
+        repeated++;
+        return previous;
+      }
+      /* Or less */
+      while ((capture[cursor].cmd != mosi) && previous && (capture[cursor].cmd == previous->cmd)
+        && (cursor + 1 < capture.size())) {
+        cursor++;
+        skipped++;
+      }
+    }
+    if (capture[cursor].cmd != mosi) {
+      char why[96];
+      snprintf(why, sizeof(why), "the firmware sent 0x%02x, the capture has 0x%02x", mosi, capture[cursor].cmd);
+      Diverge(why);
+      return nullptr;
+    }
+    matched.push_back({ cursor, start });
+    previous = &capture[cursor];
+    return &capture[cursor++];
+  }
+
+  void Finish(Time time) {
+    if (!current) return;
+    bool write = !(cmd & 0x80);
+    size_t len = bytes - 1;
+
+    if (verbose) {
+      printf("%12.6f ", (double)time / SEC);
+      Print("<- ", *current, capture[0].time);
+    }
+    if (write != current->write) {
+      Diverge((write) ? "a write in place of a captured read" : "a read in place of a captured write");
+    } else if (len != current->data.size()) {
+      char why[96];
+      snprintf(why, sizeof(why), "%zu bytes of 0x%02x, the capture has %zu", len, cmd, current->data.size());
+      Diverge(why);
+    } else if (write && (sent != current->data)) {
+      char why[96];
+      snprintf(why, sizeof(why), "write of 0x%02x differs from the capture", cmd);
+      Diverge(why);
+    }
+  }
+
+  void Diverge(const std::string &why) {
+    if (diverged) return;
+    diverged = true;
+    char where[64];
+    snprintf(where, sizeof(where), "transaction %zu of %zu: ", cursor, capture.size());
+    divergence = where + why;
+  }
+
+  const Transaction *current = nullptr;
+  const Transaction *previous = nullptr;
+  Time      start = 0;
+  uint8_t   cmd = 0;
+  uint32_t  bytes = 0;
+  std::vector<uint8_t> sent;
+};
+
+/* Mean time from a measurement trigger to the following data read, us */
+static double SampleLatency(const std::vector<Transaction> &capture, const std::vector<double> &times) {
+  double sum = 0;
+  uint32_t count = 0;
+  double trigger = -1;
+
+  for (size_t i = 0; i < capture.size(); i++) {
+    if (times[i] < 0) continue;
+    if (capture[i].write && (capture[i].cmd == CMD_CTRL_MEAS)) trigger = times[i];
+    if (!capture[i].write && (capture[i].cmd == CMD_DATA) && (trigger >= 0)) {
+      sum += times[i] - trigger;
+      count++;
+      trigger = -1;
+    }
+  }
+  return (count) ? (sum / count) : 0;
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: replay [-b boot] [-i time:line]... [-l] [-o] [-v] [-d] capture.bin\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  uint32_t boot = 1;
+  bool loose = false;
+  bool output = false;
+  bool verbose = false;
+  bool decode = false;
+  std::vector<std::pair<Time, std::string>> inputs;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:i:lovd")) != -1) {
+    switch (opt) {
+      case 'b': boot = (uint32_t)atoi(optarg); break;
+      case 'i': {
+        const char *colon = strchr(optarg, ':');
+        if (!colon) Usage();
+        inputs.push_back({ (Time)(atof(optarg) * SEC), std::string(colon + 1) + "\r" });
+        break;
+      }
+      case 'l': loose = true; break;
+      case 'o': output = true; break;
+      case 'v': verbose = true; break;
+      case 'd': decode = true; break;
+      default: Usage();
+    }
+  }
+  if ((optind != argc - 1) || !boot) Usage();
+
+  FILE *in = fopen(argv[optind], "rb");
+  if (!in) {
+    perror(argv[optind]);
+    return (2);
+  }
+  std::vector<uint8_t> raw;
+  int ch;
+  while ((ch = fgetc(in)) != EOF) raw.push_back((uint8_t)ch);
+  fclose(in);
+
+  std::vector<Transaction> all = Parse(raw);
+  if (decode) {
+    for (const Transaction &t : all) Print("", t, all.empty() ? 0 : all[0].time);
+    return (0);
+  }
+
+  /* Boots start with the sensor ID read */
+  std::vector<size_t> boots;
+  for (size_t i = 0; i < all.size(); i++) {
+    if (!all[i].write && (all[i].cmd == CMD_ID)) boots.push_back(i);
+  }
+  if (boot > boots.size()) {
+    fprintf(stderr, "replay: %zu boots in the capture\n", boots.size());
+    return (2);
+  }
+  size_t first = boots[boot - 1];
+  size_t last = (boot < boots.size()) ? boots[boot] : all.size();
+  std::vector<Transaction> capture(all.begin() + first, all.begin() + last);
+
+  Options options;
+  ReplaySlave slave(capture, loose, verbose);
+  bool lineStart = true;
+
+  Init(options);
+  Attach(&slave);
+  Observe().uartTx = [&](Time time, uint8_t data) {
+    if (!output || (data == '\r')) return;
+    if (lineStart) printf("%12.6f ", (double)time / SEC);
+    putchar(data);
+    lineStart = (data == '\n');
+  };
+
+  /* Runs through the capture, then a bit more for the last output */
+  Time span = (capture.back().time - capture.front().time) * US;
+  Time end = span + 10 * SEC;
+  Stop stop = Stop::Deadline;
+  Time t = 0;
+  size_t input = 0;
+  while (!slave.Done() && (t < end) && (stop == Stop::Deadline)) {
+    Time next = t + 100 * MS;
+    if ((input < inputs.size()) && (inputs[input].first < next)) next = inputs[input].first;
+    stop = RunUntil(next);
+    t = next;
+    while ((input < inputs.size()) && (inputs[input].first <= t)) {
+      UartInputAt(inputs[input].first, inputs[input].second);
+      input++;
+    }
+  }
+  if (stop == Stop::Deadline) stop = RunUntil(t + 100 * MS);
+  fflush(stdout);
+
+  /* Timing of the replay against the field */
+  std::vector<double> captured(capture.size(), -1);
+  std::vector<double> replayed(capture.size(), -1);
+  for (const auto &m : slave.matched) {
+    captured[m.first] = (double)(capture[m.first].time - capture[0].time);
+    replayed[m.first] = (double)(m.second - slave.matched[0].second) / US;
+  }
+  double lastCaptured = 0, lastReplayed = 0;
+  if (!slave.matched.empty()) {
+    lastCaptured = captured[slave.matched.back().first];
+    lastReplayed = replayed[slave.matched.back().first];
+  }
+
+  fprintf(stderr, "\n--- boot %u of %zu, %zu transactions\n", boot, boots.size(), capture.size());
+  fprintf(stderr, "replayed:       %zu", slave.matched.size());
+  if (loose) fprintf(stderr, ", %u repeated, %u skipped", slave.repeated, slave.skipped);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "span:           capture %.6f s, replay %.6f s\n", lastCaptured / 1e6, lastReplayed / 1e6);
+  fprintf(stderr, "sample latency: capture %.1f us, replay %.1f us\n",
+    SampleLatency(capture, captured), SampleLatency(capture, replayed));
+  if (stop == Stop::WatchdogReset) fprintf(stderr, "watchdog reset\n");
+  if (stop == Stop::Fault) fprintf(stderr, "fault: %s\n", FaultReason().c_str());
+  if (slave.diverged) fprintf(stderr, "diverged at %s\n", slave.divergence.c_str());
+  else if (!slave.Done()) fprintf(stderr, "stopped at transaction %zu\n", slave.cursor);
+
+  bool ok = (stop == Stop::Deadline) && !slave.diverged && slave.Done();
+  fprintf(stderr, "%s\n", (ok) ? "REPLAYED" : "FAILED");
+  return ((ok) ? 0 : 1);
+}
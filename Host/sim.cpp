@@ -0,0 +1,1205 @@
+/**
+  ******************************************************************************
+  * File Name          : sim.cpp
+  * Description        : STM32F030 peripheral simulation. Registers live in
+  *                      anonymous memory mapped at the device addresses.
+  *                      Every hook first takes in what the firmware wrote
+  *                      (Ingest), then moves virtual time if the hook waits
+  *                      (Advance), then writes the current peripheral state
+  *                      back into the registers (Publish) and dispatches
+  *                      interrupts when PRIMASK allows. The firmware runs
+  *                      in its own context, so RunUntil() could stop and
+  *                      resume it at any virtual time.
+  *
+  *                      Modelled: SysTick, NVIC, TIM14 compare and LSI
+  *                      capture, TIM3/TIM1 cycle counter, GPIOA outputs,
+  *                      SPI1 master, USART1 TX/RX, RTC Alarm A, EXTI 10/17,
+  *                      IWDG, Stop mode. RCC reports every clock as ready
+  *                      at once, PLL locking time isn't modelled.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <ucontext.h>
+
+#include "sim_hooks.h"
+#include "stm32f0xx.h"
+#undef printf
+
+#include "simulator.h"
+
+extern "C" {
+extern uint32_t SystemCoreClock;
+int _write(int32_t file, char *ptr, int32_t len);
+void SysTick_Handler(void);
+void RTC_IRQHandler(void);
+void EXTI4_15_IRQHandler(void);
+void TIM14_IRQHandler(void);
+void USART1_IRQHandler(void);
+}
+
+namespace Sim {
+
+namespace {
+
+const Time NEVER = UINT64_MAX;
+const int32_t IRQ_SYSTICK = SysTick_IRQn;
+const uint32_t DISPATCH_LIMIT = 100000;
+
+/* Register file regions */
+struct Region {
+  uintptr_t base;
+  size_t    size;
+};
+const Region regions[] = {
+  { 0x40000000UL, 0x00030000UL },   // APB, AHB1
+  { 0x48000000UL, 0x00002000UL },   // AHB2, GPIO
+  { 0xe000e000UL, 0x00001000UL },   // System control space
+};
+
+/* Core clock cycles against running time, rebased when the clock changes */
+struct CoreClock {
+  uint32_t  hz = 0;
+  uint64_t  baseCycles = 0;
+  Time      baseRun = 0;
+
+  uint64_t CyclesAt(Time run) const {
+    return baseCycles + (uint64_t)(((unsigned __int128)(run - baseRun) * hz) / SEC);
+  }
+  Time RunAt(uint64_t cycles) const {
+    if (cycles <= baseCycles) return baseRun;
+    return baseRun + (Time)((((unsigned __int128)(cycles - baseCycles) * SEC) + hz - 1) / hz);
+  }
+};
+
+struct UartRx {
+  Time    end;
+  uint8_t data;
+};
+
+struct State {
+  Options     options;
+  Observers   observers;
+  SpiSlave    *slave = nullptr;
+
+  /* Contexts */
+  ucontext_t  hostContext;
+  ucontext_t  firmwareContext;
+  std::vector<uint8_t> stack;
+  bool        running = false;      // Firmware context is current
+  bool        halted = false;
+  Time        yieldAt = 0;
+  Stop        stopReason = Stop::Deadline;
+  std::string faultReason;
+
+  /* Core */
+  Time        now = 0;              // Wall time
+  Time        run = 0;              // Core clocked time, it's frozen in Stop
+  bool        stopped = false;
+  Time        stopStart = 0;
+  uint32_t    primask = 0;
+  bool        inIsr = false;
+  uint32_t    nvicEnabled = 0;
+  uint32_t    nvicPending = 0;      // Software pending
+  CoreClock   clock;
+
+  /* SysTick */
+  bool        tickRunning = false;
+  uint64_t    tickBase = 0;         // Cycles at the last reload
+  uint32_t    tickReload = 0;
+  uint64_t    tickCount = 0;        // Reloads since tickBase
+  bool        tickPending = false;
+  uint32_t    tickVal = 0;          // Published VAL
+
+  /* TIM14 */
+  bool        t14Running = false;
+  uint64_t    t14Base = 0;          // Cycles at counter 0 of t14Ticks
+  uint32_t    t14Psc = 0;
+  uint32_t    t14Arr = 0xffff;
+  uint32_t    t14Offset = 0;
+  uint64_t    t14Ticks = 0;         // Timer ticks at the last update
+  uint32_t    t14Cnt = 0;           // Published CNT
+  uint64_t    lsiEdges = 0;         // LSI edges processed by the capture
+
+  /* TIM3/TIM1 cycle counter */
+  bool        cycRunning = false;
+  uint64_t    cycBase = 0;
+
+  /* GPIOA */
+  uint32_t    odr = 0;
+
+  /* SPI1 */
+  std::deque<uint8_t> spiTx;
+  std::deque<uint8_t> spiRx;
+  Time        spiDone = NEVER;      // Running time the shifted byte completes
+  uint8_t     spiShift = 0;
+  uint8_t     spiLast = 0;
+
+  /* USART1 */
+  bool        txShifting = false;
+  Time        txDone = NEVER;       // Running time
+  uint8_t     txShift = 0;
+  bool        tdrFull = false;
+  uint8_t     tdr = 0;
+  uint8_t     rdr = 0;
+  uint32_t    usartIsr = USART_ISR_TXE | USART_ISR_TC;
+  std::deque<UartRx> rxLine;
+  Time        rxLineEnd = 0;
+
+  /* RTC */
+  bool        rtcRunning = false;
+  Time        rtcBase = 0;
+  uint64_t    rtcTicksBase = 0;     // ck_apre ticks at rtcBase
+  uint64_t    rtcTicks = 0;         // ck_apre ticks processed
+  uint32_t    rtcPrer = 0;
+  bool        rtcInit = false;
+
+  /* EXTI */
+  uint32_t    extiPending = 0;
+
+  /* IWDG */
+  bool        iwdgRunning = false;
+  Time        iwdgRefresh = 0;
+};
+
+State s;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Yield(Stop reason) {
+  s.stopReason = reason;
+  swapcontext(&s.firmwareContext, &s.hostContext);
+}
+
+void Halt(Stop reason, const std::string &why) {
+  s.halted = true;
+  s.faultReason = why;
+  for (;;) Yield(reason);
+}
+
+Time RunToWall(Time run) {
+  if ((run == NEVER) || s.stopped) return NEVER;
+  return s.now + ((run > s.run) ? (run - s.run) : 0);
+}
+
+uint64_t Cycles(void) {
+  return s.clock.CyclesAt(s.run);
+}
+
+Time LsiEdgeTime(uint64_t edge) {
+  return (Time)(((unsigned __int128)edge * SEC + s.options.lsiHz - 1) / s.options.lsiHz);
+}
+
+uint64_t LsiEdges(Time t) {
+  return (uint64_t)(((unsigned __int128)t * s.options.lsiHz) / SEC);
+}
+
+
+
+
+
+/* ---- SysTick ------------------------------------------------------------ */
+
+void SysTick_Ingest(void) {
+  bool enable = SysTick->CTRL & SysTick_CTRL_ENABLE_Msk;
+  bool written = (SysTick->VAL != s.tickVal);
+  bool reloaded = (SysTick->LOAD + 1 != s.tickReload);
+
+  if (enable && (!s.tickRunning || written || reloaded)) {
+    uint64_t into = 0;
+    uint64_t c = Cycles();
+
+    /* A restart goes on from the stopped count, a VAL write clears it */
+    if (!written && !reloaded && (s.tickVal < s.tickReload)) into = s.tickReload - 1 - s.tickVal;
+    s.tickReload = SysTick->LOAD + 1;
+    s.tickBase = (c > into) ? (c - into) : 0;
+    s.tickCount = 0;
+  }
+  s.tickRunning = enable;
+}
+
+Time SysTick_Next(void) {
+  if (!s.tickRunning || !s.tickReload) return NEVER;
+  return RunToWall(s.clock.RunAt(s.tickBase + ((s.tickCount + 1) * s.tickReload)));
+}
+
+void SysTick_Process(void) {
+  if (!s.tickRunning || !s.tickReload) return;
+  uint64_t count = (Cycles() - s.tickBase) / s.tickReload;
+  if (count != s.tickCount) {
+    s.tickCount = count;
+    if (SysTick->CTRL & SysTick_CTRL_TICKINT_Msk) s.tickPending = true;
+  }
+}
+
+void SysTick_Publish(void) {
+  if (s.tickRunning && s.tickReload) {
+    uint64_t into = (Cycles() - s.tickBase) % s.tickReload;
+    s.tickVal = (uint32_t)(s.tickReload - 1 - into);
+  }
+  SysTick->VAL = s.tickVal;
+  if (s.tickPending) SCB->ICSR |= SCB_ICSR_PENDSTSET_Msk;
+  else SCB->ICSR &= ~SCB_ICSR_PENDSTSET_Msk;
+}
+
+
+
+
+
+/* ---- TIM14 -------------------------------------------------------------- */
+
+uint64_t Tim14_TicksAt(uint64_t cycles) {
+  return (cycles - s.t14Base) / (s.t14Psc + 1);
+}
+
+uint32_t Tim14_Cnt(uint64_t ticks) {
+  return (uint32_t)((s.t14Offset + ticks) % (s.t14Arr + 1));
+}
+
+bool Tim14_Capture(void) {
+  return ((TIM14->CCMR1 & TIM_CCMR1_CC1S) == TIM_CCMR1_CC1S_0) && (TIM14->CCER & TIM_CCER_CC1E)
+    && (TIM14->OR == TIM14_OR_TI1_RMP_0);
+}
+
+uint32_t Tim14_CapturePsc(void) {
+  return 1U << ((TIM14->CCMR1 & TIM_CCMR1_IC1PSC) >> TIM_CCMR1_IC1PSC_Pos);
+}
+
+void Tim14_Ingest(void) {
+  bool cen = TIM14->CR1 & TIM_CR1_CEN;
+  uint64_t c = Cycles();
+
+  /* Counter moved on to the current time before any change */
+  if (s.t14Running) {
+    uint64_t ticks = Tim14_TicksAt(c);
+    s.t14Offset = Tim14_Cnt(ticks);
+    s.t14Base = c - ((c - s.t14Base) % (s.t14Psc + 1));
+    s.t14Ticks = 0;
+  }
+
+  if (TIM14->EGR & TIM_EGR_UG) {
+    TIM14->EGR = 0;
+    s.t14Psc = TIM14->PSC;
+    s.t14Arr = TIM14->ARR;
+    s.t14Offset = 0;
+    s.t14Base = c;
+  } else if ((TIM14->CNT & 0xffff) != s.t14Cnt) {
+    s.t14Offset = TIM14->CNT & 0xffff;
+    s.t14Base = c;
+  }
+  if (!cen || (TIM14->ARR != s.t14Arr)) {
+    s.t14Psc = TIM14->PSC;
+    s.t14Arr = TIM14->ARR;
+  }
+  if (cen && !s.t14Running) s.t14Base = c;
+  s.t14Running = cen;
+  s.t14Ticks = 0;
+
+  if (!Tim14_Capture()) s.lsiEdges = LsiEdges(s.now);
+}
+
+Time Tim14_Next(void) {
+  Time next = NEVER;
+
+  if (!s.t14Running) return NEVER;
+
+  if (Tim14_Capture()) {
+    uint32_t psc = Tim14_CapturePsc();
+    next = LsiEdgeTime(((s.lsiEdges / psc) + 1) * psc);
+    return (s.stopped) ? NEVER : next;
+  }
+
+  /* Compare match of channel 1 */
+  uint64_t ticks = Tim14_TicksAt(Cycles());
+  uint32_t cnt = Tim14_Cnt(ticks);
+  uint32_t period = s.t14Arr + 1;
+  uint32_t ccr = TIM14->CCR1 % period;
+  uint64_t delta = (ccr + period - cnt) % period;
+  if (!delta) delta = period;
+  uint64_t cycles = s.t14Base + ((ticks + delta) * (s.t14Psc + 1));
+  return RunToWall(s.clock.RunAt(cycles));
+}
+
+void Tim14_Process(void) {
+  if (!s.t14Running) return;
+
+  uint64_t ticks = Tim14_TicksAt(Cycles());
+
+  if (Tim14_Capture()) {
+    uint32_t psc = Tim14_CapturePsc();
+    uint64_t edges = LsiEdges(s.now);
+    if ((edges / psc) != (s.lsiEdges / psc)) {
+      if (TIM14->SR & TIM_SR_CC1IF) TIM14->SR |= TIM_SR_CC1OF;
+      TIM14->CCR1 = Tim14_Cnt(ticks);
+      TIM14->SR |= TIM_SR_CC1IF;
+    }
+    s.lsiEdges = edges;
+    return;
+  }
+
+  if (ticks != s.t14Ticks) {
+    uint32_t period = s.t14Arr + 1;
+    uint32_t from = Tim14_Cnt(s.t14Ticks);
+    uint32_t ccr = TIM14->CCR1 % period;
+    uint64_t delta = (ccr + period - from) % period;
+    if (!delta) delta = period;
+    if ((ticks - s.t14Ticks) >= delta) TIM14->SR |= TIM_SR_CC1IF;
+    if ((Tim14_Cnt(s.t14Ticks) + (ticks - s.t14Ticks)) >= period) TIM14->SR |= TIM_SR_UIF;
+    s.t14Ticks = ticks;
+  }
+}
+
+void Tim14_Publish(void) {
+  if (s.t14Running) s.t14Cnt = Tim14_Cnt(Tim14_TicksAt(Cycles()));
+  else s.t14Cnt = s.t14Offset;
+  TIM14->CNT = s.t14Cnt;
+}
+
+
+
+
+
+/* ---- TIM3/TIM1 cycle counter -------------------------------------------- */
+
+void Cycle_Ingest(void) {
+  bool cen = TIM3->CR1 & TIM_CR1_CEN;
+  if (cen && !s.cycRunning) s.cycBase = Cycles();
+  s.cycRunning = cen;
+}
+
+void Cycle_Publish(void) {
+  if (!s.cycRunning) return;
+  uint64_t cycles = Cycles() - s.cycBase;
+  TIM3->CNT = (uint32_t)(cycles & 0xffff);
+  if ((TIM1->CR1 & TIM_CR1_CEN) && ((TIM1->SMCR & TIM_SMCR_SMS) == TIM_SMCR_SMS)) {
+    TIM1->CNT = (uint32_t)((cycles >> 16) & 0xffff);
+  }
+}
+
+
+
+
+
+/* ---- GPIOA -------------------------------------------------------------- */
+
+bool Gpio_Ingest(void) {
+  uint32_t set = GPIOA->BSRR & 0xffff;
+  uint32_t reset = (GPIOA->BSRR >> 16) | GPIOA->BRR;
+  uint32_t odr = s.odr;
+
+  if (!set && !reset) {
+    if ((GPIOA->ODR & 0xffff) == s.odr) return false;
+    odr = GPIOA->ODR & 0xffff;
+  }
+
+  /* Both set and reset of a pin since the last hook: it went up, then down */
+  uint32_t pulse = set & reset;
+  odr = (odr | set) & ~reset;
+  GPIOA->BSRR = 0;
+  GPIOA->BRR = 0;
+
+  uint32_t nss = GPIO_BSRR_BS_4;
+  if (((s.odr ^ odr) & nss) || (pulse & nss)) {
+    if (pulse & nss) {
+      if (s.slave) s.slave->Select(s.now, false);
+      if (s.observers.chipSelect) s.observers.chipSelect(s.now, true);
+    }
+    bool selected = !(odr & nss);
+    if (s.slave) s.slave->Select(s.now, selected);
+    if (s.observers.chipSelect) s.observers.chipSelect(s.now, !selected);
+  }
+
+  s.odr = odr;
+  return true;
+}
+
+void Gpio_Publish(void) {
+  GPIOA->ODR = s.odr;
+  GPIOA->IDR = s.odr;
+}
+
+
+
+
+
+/* ---- SPI1 --------------------------------------------------------------- */
+
+uint32_t Spi_Rate(void) {
+  uint32_t div = 2U << ((SPI1->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos);
+  return (s.options.spiHz) ? s.options.spiHz : (s.clock.hz / div);
+}
+
+Time Spi_ByteTime(void) {
+  return (8ULL * SEC) / Spi_Rate();
+}
+
+void Spi_Start(void) {
+  uint8_t mosi = s.spiTx.front();
+  s.spiTx.pop_front();
+  bool selected = !(s.odr & GPIO_BSRR_BS_4);
+  s.spiShift = (s.slave && selected) ? s.slave->Transfer(s.now, mosi) : 0xff;
+  s.spiDone = s.run + Spi_ByteTime();
+}
+
+Time Spi_Next(void) {
+  return RunToWall(s.spiDone);
+}
+
+void Spi_Process(void) {
+  while ((s.spiDone != NEVER) && (s.run >= s.spiDone)) {
+    if (s.spiRx.size() < 4) s.spiRx.push_back(s.spiShift);
+    else SPI1->SR |= SPI_SR_OVR;
+    s.spiDone = NEVER;
+    if (!s.spiTx.empty()) Spi_Start();
+  }
+}
+
+void Spi_Publish(void) {
+  uint32_t sr = SPI1->SR & SPI_SR_OVR;
+  size_t tx = s.spiTx.size();
+  size_t rx = s.spiRx.size();
+
+  if (tx < 2) sr |= SPI_SR_TXE;
+  if (rx) sr |= SPI_SR_RXNE;
+  if (s.spiDone != NEVER) sr |= SPI_SR_BSY;
+  sr |= (uint32_t)((tx > 3) ? 3 : tx) << SPI_SR_FTLVL_Pos;
+  sr |= (uint32_t)((rx > 3) ? 3 : rx) << SPI_SR_FRLVL_Pos;
+  SPI1->SR = sr;
+}
+
+
+
+
+
+/* ---- USART1 ------------------------------------------------------------- */
+
+uint32_t Usart_Baud(void) {
+  uint32_t brr = USART1->BRR & 0xffff;
+  uint32_t fck = s.clock.hz;
+
+  if (!brr) return 0;
+  if (USART1->CR1 & USART_CR1_OVER8) {
+    uint32_t div = (brr & 0xfff0) | ((brr & 7) << 1);
+    return (div) ? (2 * fck) / div : 0;
+  }
+  return fck / brr;
+}
+
+Time Usart_CharTime(void) {
+  uint32_t baud = Usart_Baud();
+  return (baud) ? ((10 * SEC) / baud) : MS;
+}
+
+bool Usart_Ingest(void) {
+  uint32_t icr = USART1->ICR;
+
+  if (!icr) return false;
+  if (icr & USART_ICR_ORECF) s.usartIsr &= ~USART_ISR_ORE;
+  if (icr & USART_ICR_TCCF) s.usartIsr &= ~USART_ISR_TC;
+  if (icr & USART_ICR_FECF) s.usartIsr &= ~USART_ISR_FE;
+  USART1->ICR = 0;
+  return true;
+}
+
+Time Usart_Next(void) {
+  Time next = RunToWall(s.txDone);
+  if (!s.rxLine.empty() && (s.rxLine.front().end < next)) next = s.rxLine.front().end;
+  return next;
+}
+
+void Usart_Process(void) {
+  while ((s.txDone != NEVER) && (s.run >= s.txDone)) {
+    if (s.observers.uartTx) s.observers.uartTx(s.now, s.txShift);
+    if (s.tdrFull) {
+      s.txShift = s.tdr;
+      s.tdrFull = false;
+      s.usartIsr |= USART_ISR_TXE;
+      s.txDone += Usart_CharTime();
+    } else {
+      s.txShifting = false;
+      s.txDone = NEVER;
+      s.usartIsr |= USART_ISR_TC;
+    }
+  }
+
+  while (!s.rxLine.empty() && (s.rxLine.front().end <= s.now)) {
+    uint8_t data = s.rxLine.front().data;
+    s.rxLine.pop_front();
+
+    /* In Stop the start bit only wakes the core up through EXTI line 10 */
+    if (s.stopped) {
+      if ((EXTI->IMR & EXTI_IMR_MR10) && (EXTI->FTSR & EXTI_FTSR_TR10)) s.extiPending |= EXTI_PR_PR10;
+      continue;
+    }
+    if (!(USART1->CR1 & USART_CR1_UE) || !(USART1->CR1 & USART_CR1_RE)) continue;
+    if (s.usartIsr & USART_ISR_RXNE) {
+      s.usartIsr |= USART_ISR_ORE;
+    } else {
+      s.rdr = data;
+      s.usartIsr |= USART_ISR_RXNE;
+    }
+  }
+}
+
+void Usart_Publish(void) {
+  USART1->ISR = s.usartIsr;
+  USART1->RDR = s.rdr;
+}
+
+bool Usart_Irq(void) {
+  uint32_t cr1 = USART1->CR1;
+  return ((cr1 & USART_CR1_TXEIE) && (s.usartIsr & USART_ISR_TXE))
+    || ((cr1 & USART_CR1_TCIE) && (s.usartIsr & USART_ISR_TC))
+    || ((cr1 & USART_CR1_RXNEIE) && (s.usartIsr & (USART_ISR_RXNE | USART_ISR_ORE)));
+}
+
+
+
+
+
+/* ---- RTC ---------------------------------------------------------------- */
+
+uint32_t Rtc_DivA(void) {
+  return ((s.rtcPrer & RTC_PRER_PREDIV_A) >> RTC_PRER_PREDIV_A_Pos) + 1;
+}
+
+uint32_t Rtc_DivS(void) {
+  return (s.rtcPrer & RTC_PRER_PREDIV_S) + 1;
+}
+
+uint64_t Rtc_TicksAt(Time t) {
+  return s.rtcTicksBase + (uint64_t)(((unsigned __int128)(t - s.rtcBase) * s.options.lsiHz) / ((unsigned __int128)Rtc_DivA() * SEC));
+}
+
+Time Rtc_TickTime(uint64_t tick) {
+  unsigned __int128 span = (unsigned __int128)(tick - s.rtcTicksBase) * Rtc_DivA() * SEC;
+  return s.rtcBase + (Time)((span + s.options.lsiHz - 1) / s.options.lsiHz);
+}
+
+void Rtc_Ingest(void) {
+  bool enable = RCC->BDCR & RCC_BDCR_RTCEN;
+  bool init = RTC->ISR & RTC_ISR_INIT;
+
+  if (!s.rtcRunning && enable) {
+    s.rtcPrer = RTC->PRER;
+    s.rtcBase = s.now;
+    s.rtcTicksBase = 0;
+    s.rtcTicks = 0;
+  }
+  s.rtcRunning = enable;
+
+  /* Prescalers take effect when init mode is left, the time is kept */
+  if ((init != s.rtcInit) || (!init && (RTC->PRER != s.rtcPrer))) {
+    uint64_t seconds = (s.rtcRunning) ? (Rtc_TicksAt(s.now) / Rtc_DivS()) : 0;
+    s.rtcPrer = RTC->PRER;
+    s.rtcBase = s.now;
+    s.rtcTicksBase = seconds * Rtc_DivS();
+    s.rtcTicks = s.rtcTicksBase;
+    s.rtcInit = init;
+  }
+}
+
+bool Rtc_AlarmMatch(uint64_t tick) {
+  uint32_t divS = Rtc_DivS();
+  uint32_t ss = divS - 1 - (uint32_t)(tick % divS);
+  uint32_t maskss = (RTC->ALRMASSR & RTC_ALRMASSR_MASKSS) >> RTC_ALRMASSR_MASKSS_Pos;
+  uint32_t mask = (1U << maskss) - 1;
+
+  if (!maskss) return (tick % divS) == 0;
+  return (ss & mask) == (RTC->ALRMASSR & RTC_ALRMASSR_SS & mask);
+}
+
+uint64_t Rtc_NextAlarm(void) {
+  uint32_t divS = Rtc_DivS();
+  uint32_t maskss = (RTC->ALRMASSR & RTC_ALRMASSR_MASKSS) >> RTC_ALRMASSR_MASKSS_Pos;
+
+  /* Whole second or a full subsecond match, one tick of every second */
+  if (!maskss || (maskss >= 15)) {
+    uint32_t ss = (maskss) ? (RTC->ALRMASSR & RTC_ALRMASSR_SS) : (divS - 1);
+    if (ss >= divS) return UINT64_MAX;
+    uint64_t phase = divS - 1 - ss;
+    uint64_t tick = ((s.rtcTicks / divS) * divS) + phase;
+    return (tick > s.rtcTicks) ? tick : (tick + divS);
+  }
+  for (uint64_t tick = s.rtcTicks + 1; tick <= s.rtcTicks + divS; tick++) {
+    if (Rtc_AlarmMatch(tick)) return tick;
+  }
+  return UINT64_MAX;
+}
+
+bool Rtc_AlarmOn(void) {
+  return s.rtcRunning && !s.rtcInit && (RTC->CR & RTC_CR_ALRAE);
+}
+
+Time Rtc_Next(void) {
+  if (!Rtc_AlarmOn()) return NEVER;
+  uint64_t tick = Rtc_NextAlarm();
+  return (tick == UINT64_MAX) ? NEVER : Rtc_TickTime(tick);
+}
+
+void Rtc_Process(void) {
+  if (!s.rtcRunning || s.rtcInit) return;
+
+  uint64_t ticks = Rtc_TicksAt(s.now);
+  if (ticks == s.rtcTicks) return;
+
+  if (Rtc_AlarmOn()) {
+    uint64_t alarm = Rtc_NextAlarm();
+    if (alarm <= ticks) {
+      RTC->ISR |= RTC_ISR_ALRAF;
+      if ((RTC->CR & RTC_CR_ALRAIE) && (EXTI->IMR & EXTI_IMR_MR17) && (EXTI->RTSR & EXTI_RTSR_TR17)) {
+        s.extiPending |= EXTI_PR_PR17;
+      }
+    }
+  }
+  s.rtcTicks = ticks;
+}
+
+void Rtc_Publish(void) {
+  RTC->ISR |= RTC_ISR_INITF | RTC_ISR_RSF | RTC_ISR_ALRAWF;
+  if (!s.rtcRunning) return;
+
+  uint32_t divS = Rtc_DivS();
+  uint64_t ticks = s.rtcTicks;
+  uint32_t sec = (uint32_t)((ticks / divS) % 86400U);
+  uint32_t h = sec / 3600, m = (sec / 60) % 60, ss = sec % 60;
+
+  RTC->TR = ((h / 10) << RTC_TR_HT_Pos) | ((h % 10) << RTC_TR_HU_Pos)
+          | ((m / 10) << RTC_TR_MNT_Pos) | ((m % 10) << RTC_TR_MNU_Pos)
+          | ((ss / 10) << RTC_TR_ST_Pos) | ((ss % 10) << RTC_TR_SU_Pos);
+  RTC->SSR = divS - 1 - (uint32_t)(ticks % divS);
+}
+
+
+
+
+
+/* ---- EXTI --------------------------------------------------------------- */
+
+bool Exti_Ingest(void) {
+  /* PR is write-one-to-clear, it reads as 0 here, so any 1 is a clear */
+  uint32_t clear = EXTI->PR;
+  if (!clear) return false;
+  s.extiPending &= ~clear;
+  EXTI->PR = 0;
+  return true;
+}
+
+
+
+
+
+/* ---- IWDG --------------------------------------------------------------- */
+
+Time Iwdg_Timeout(void) {
+  uint32_t div = 4U << (IWDG->PR & IWDG_PR_PR);
+  uint32_t reload = (IWDG->RLR & IWDG_RLR_RL) + 1;
+  return (Time)(((unsigned __int128)div * reload * SEC) / s.options.lsiHz);
+}
+
+bool Iwdg_Ingest(void) {
+  uint32_t key = IWDG->KR & 0xffff;
+
+  if (!key) return false;
+  if ((key == 0xcccc) || (key == 0xaaaa)) {
+    if (s.iwdgRunning && s.observers.watchdog) s.observers.watchdog(s.now);
+    s.iwdgRunning = true;
+    s.iwdgRefresh = s.now;
+  }
+  IWDG->KR = 0;
+  return true;
+}
+
+Time Iwdg_Next(void) {
+  return (s.iwdgRunning) ? (s.iwdgRefresh + Iwdg_Timeout()) : NEVER;
+}
+
+void Iwdg_Process(void) {
+  if (s.iwdgRunning && (s.now >= s.iwdgRefresh + Iwdg_Timeout())) {
+    Halt(Stop::WatchdogReset, "watchdog reset");
+  }
+}
+
+
+
+
+
+/* ---- RCC ---------------------------------------------------------------- */
+
+void Rcc_Publish(void) {
+  RCC->CR |= RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY;
+  RCC->CSR |= RCC_CSR_LSIRDY;
+}
+
+
+
+
+
+/* ---- Machine ------------------------------------------------------------ */
+
+bool Ingest(void) {
+  bool changed = false;
+
+  if (SystemCoreClock != s.clock.hz) {
+    s.clock.baseCycles = s.clock.CyclesAt(s.run);
+    s.clock.baseRun = s.run;
+    s.clock.hz = SystemCoreClock;
+    changed = true;
+  }
+
+  changed |= Gpio_Ingest();
+  changed |= Usart_Ingest();
+  changed |= Exti_Ingest();
+  changed |= Iwdg_Ingest();
+  SysTick_Ingest();
+  Tim14_Ingest();
+  Cycle_Ingest();
+  Rtc_Ingest();
+  return changed;
+}
+
+void Publish(void) {
+  SysTick_Publish();
+  Tim14_Publish();
+  Cycle_Publish();
+  Gpio_Publish();
+  Spi_Publish();
+  Usart_Publish();
+  Rtc_Publish();
+  Rcc_Publish();
+}
+
+Time NextEvent(void) {
+  Time next = NEVER;
+  Time t;
+
+  if ((t = SysTick_Next()) < next) next = t;
+  if ((t = Tim14_Next()) < next) next = t;
+  if ((t = Spi_Next()) < next) next = t;
+  if ((t = Usart_Next()) < next) next = t;
+  if ((t = Rtc_Next()) < next) next = t;
+  if ((t = Iwdg_Next()) < next) next = t;
+  return next;
+}
+
+void Process(void) {
+  SysTick_Process();
+  Tim14_Process();
+  Spi_Process();
+  Usart_Process();
+  Rtc_Process();
+  Iwdg_Process();
+}
+
+/* Moves time to the next event, or by the given quantum when nothing is due.
+   RunUntil() time is a step of its own, the firmware context gives way there */
+void Step(Time idle) {
+  Time next = NextEvent();
+  bool yield;
+
+  if (next == NEVER) next = s.now + idle;
+  if (next < s.now) next = s.now;
+  yield = (s.yieldAt <= next);
+  if (yield) next = (s.yieldAt > s.now) ? s.yieldAt : s.now;
+
+  if (!s.stopped) s.run += next - s.now;
+  s.now = next;
+  Process();
+
+  if (yield) {
+    Publish();
+    Yield(Stop::Deadline);
+    Ingest();
+  }
+}
+
+bool IrqPending(int32_t irq) {
+  switch (irq) {
+    case SysTick_IRQn:    return s.tickPending;
+    case RTC_IRQn:        return (s.extiPending & EXTI_PR_PR17) != 0;
+    case EXTI4_15_IRQn:   return (s.extiPending & 0xfff0) != 0;
+    case TIM14_IRQn:      return (TIM14->SR & TIM14->DIER & 0x1f) != 0;
+    case USART1_IRQn:     return Usart_Irq();
+    default:              return false;
+  }
+}
+
+bool IrqEnabled(int32_t irq) {
+  return (irq < 0) || (s.nvicEnabled & (1U << irq));
+}
+
+/* Highest priority pending enabled interrupt, lowest number wins a tie */
+int32_t NextIrq(void) {
+  static const int32_t irqs[] = { SysTick_IRQn, RTC_IRQn, EXTI4_15_IRQn, TIM14_IRQn, USART1_IRQn };
+  int32_t best = INT32_MIN;
+  uint32_t bestPrio = UINT32_MAX;
+
+  for (int32_t irq : irqs) {
+    bool pending = IrqPending(irq) || ((irq >= 0) && (s.nvicPending & (1U << irq)));
+    if (!pending || !IrqEnabled(irq)) continue;
+    uint32_t prio = __NVIC_GetPriority((IRQn_Type)irq);
+    if (prio < bestPrio) {
+      best = irq;
+      bestPrio = prio;
+    }
+  }
+  return best;
+}
+
+void Dispatch(void) {
+  if (s.primask || s.inIsr) return;
+
+  for (uint32_t n = 0; ; n++) {
+    int32_t irq = NextIrq();
+    if (irq == INT32_MIN) return;
+    if (n > DISPATCH_LIMIT) Halt(Stop::Fault, "interrupt storm");
+
+    if (irq >= 0) s.nvicPending &= ~(1U << irq);
+    s.inIsr = true;
+    switch (irq) {
+      case SysTick_IRQn:    s.tickPending = false; SysTick_Handler(); break;
+      case RTC_IRQn:        RTC_IRQHandler(); break;
+      case EXTI4_15_IRQn:   EXTI4_15_IRQHandler(); break;
+      case TIM14_IRQn:      TIM14_IRQHandler(); break;
+      case USART1_IRQn:     USART1_IRQHandler(); break;
+    }
+    s.inIsr = false;
+    Ingest();
+    Publish();
+  }
+}
+
+/* Firmware calls from the host can't wait, there is no time to wait for */
+void HostCheck(const char *what) {
+  if (s.running) return;
+  fprintf(stderr, "sim: %s in a firmware call from the host\n", what);
+  abort();
+}
+
+void FirmwareEntry(void) {
+  SystemInit();
+  Firmware_Main();
+  Halt(Stop::Fault, "main returned");
+}
+
+void MapRegisters(void) {
+  for (const Region &r : regions) {
+    void *p = mmap((void*)r.base, r.size, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p != (void*)r.base) {
+      fprintf(stderr, "sim: can't map registers at 0x%08lx\n", (unsigned long)r.base);
+      exit(1);
+    }
+  }
+}
+
+void ResetRegisters(void) {
+  for (const Region &r : regions) memset((void*)r.base, 0, r.size);
+
+  RCC->CR = RCC_CR_HSION | RCC_CR_HSIRDY;
+  RCC->CFGR = RCC_CFGR_SWS_PLL;
+  TIM14->ARR = 0xffff;
+  TIM3->ARR = 0xffff;
+  TIM1->ARR = 0xffff;
+  SPI1->SR = SPI_SR_TXE;
+  USART1->ISR = USART_ISR_TXE | USART_ISR_TC;
+  IWDG->RLR = 0xfff;
+  RTC->PRER = (0x7fU << RTC_PRER_PREDIV_A_Pos) | 0xffU;
+  Rcc_Publish();
+}
+
+} // namespace
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+void Init(const Options &options) {
+  static bool mapped = false;
+
+  if (!mapped) MapRegisters();
+  mapped = true;
+  ResetRegisters();
+
+  s.options = options;
+  s.stack.assign(options.stackSize, 0);
+  s.clock.hz = SystemCoreClock;
+
+  getcontext(&s.firmwareContext);
+  s.firmwareContext.uc_stack.ss_sp = s.stack.data();
+  s.firmwareContext.uc_stack.ss_size = s.stack.size();
+  s.firmwareContext.uc_link = nullptr;
+  makecontext(&s.firmwareContext, FirmwareEntry, 0);
+}
+
+void Attach(SpiSlave *slave) {
+  s.slave = slave;
+}
+
+Observers& Observe(void) {
+  return s.observers;
+}
+
+Stop RunUntil(Time time) {
+  if (s.halted) return s.stopReason;
+  s.yieldAt = time;
+  s.running = true;
+  swapcontext(&s.hostContext, &s.firmwareContext);
+  s.running = false;
+  return s.stopReason;
+}
+
+Time Now(void) {
+  return s.now;
+}
+
+const std::string& FaultReason(void) {
+  return s.faultReason;
+}
+
+void UartInputAt(Time time, const std::string &data) {
+  Time charTime = Usart_CharTime();
+  Time start = (time > s.rxLineEnd) ? time : s.rxLineEnd;
+
+  for (char c : data) {
+    start += charTime;
+    s.rxLine.push_back({ start, (uint8_t)c });
+  }
+  s.rxLineEnd = start;
+}
+
+void UartInput(const std::string &data) {
+  UartInputAt(s.now, data);
+}
+
+uint32_t UartBaud(void) {
+  return Usart_Baud();
+}
+
+uint32_t SpiRate(void) {
+  return Spi_Rate();
+}
+
+Time WatchdogTimeout(void) {
+  return Iwdg_Timeout();
+}
+
+} // namespace Sim
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+using namespace Sim;
+
+extern "C" {
+
+void Sim_Poll(void) {
+  HostCheck("poll");
+
+  /* A fresh register write could be all the wait needs */
+  if (!Ingest()) Step(US);
+  Publish();
+  Dispatch();
+}
+
+void Sim_WaitForInterrupt(void) {
+  bool deep = SCB->SCR & SCB_SCR_SLEEPDEEP_Msk;
+
+  HostCheck("WFI");
+
+  Ingest();
+  Publish();
+
+  if (deep) {
+    s.stopped = true;
+    s.stopStart = s.now;
+    while (!(s.extiPending & EXTI->IMR)) Step(MS);
+    s.stopped = false;
+    if (s.observers.stopMode) s.observers.stopMode(s.stopStart, s.now);
+  } else {
+    while (NextIrq() == INT32_MIN) Step(MS);
+  }
+
+  Publish();
+  Dispatch();
+}
+
+uint32_t Sim_GetPrimask(void) {
+  return s.primask;
+}
+
+void Sim_SetPrimask(uint32_t primask) {
+  s.primask = primask & 1;
+  if (!s.primask && !s.inIsr && s.running) {
+    Ingest();
+    Publish();
+    Dispatch();
+  }
+}
+
+void Sim_NVIC_EnableIRQ(int32_t irq) {
+  if (irq >= 0) s.nvicEnabled |= 1U << irq;
+}
+
+void Sim_NVIC_DisableIRQ(int32_t irq) {
+  if (irq >= 0) s.nvicEnabled &= ~(1U << irq);
+}
+
+uint32_t Sim_NVIC_GetEnableIRQ(int32_t irq) {
+  return (irq >= 0) ? ((s.nvicEnabled >> irq) & 1) : 0;
+}
+
+uint32_t Sim_NVIC_GetPendingIRQ(int32_t irq) {
+  return (irq >= 0) ? (IrqPending(irq) || ((s.nvicPending >> irq) & 1)) : 0;
+}
+
+void Sim_NVIC_SetPendingIRQ(int32_t irq) {
+  if (irq >= 0) s.nvicPending |= 1U << irq;
+}
+
+void Sim_NVIC_ClearPendingIRQ(int32_t irq) {
+  if (irq >= 0) s.nvicPending &= ~(1U << irq);
+}
+
+void Sim_SPI_Write(uint8_t data) {
+  Ingest();
+  Process();
+  if (SPI1->CR1 & SPI_CR1_SPE) {
+    s.spiTx.push_back(data);
+    if (s.spiDone == NEVER) Spi_Start();
+  }
+  Publish();
+}
+
+uint8_t Sim_SPI_Read(void) {
+  Ingest();
+  Process();
+  if (!s.spiRx.empty()) {
+    s.spiLast = s.spiRx.front();
+    s.spiRx.pop_front();
+  }
+  Publish();
+  return s.spiLast;
+}
+
+void Sim_USART_Write(uint32_t data) {
+  if (!s.inIsr) Ingest();
+  s.usartIsr &= ~USART_ISR_TC;
+  if (!s.txShifting) {
+    s.txShift = (uint8_t)data;
+    s.txShifting = true;
+    s.txDone = s.run + Usart_CharTime();
+  } else {
+    s.tdr = (uint8_t)data;
+    s.tdrFull = true;
+    s.usartIsr &= ~USART_ISR_TXE;
+  }
+  Usart_Publish();
+}
+
+uint8_t Sim_USART_Read(void) {
+  s.usartIsr &= ~USART_ISR_RXNE;
+  Usart_Publish();
+  return s.rdr;
+}
+
+void Sim_Fault(const char *reason) {
+  Halt(Stop::Fault, reason);
+}
+
+/* newlib on the target is ILP32: long is 32 bits, so is every integer */
+int Sim_Printf(const char *fmt, ...) {
+  std::string out;
+  char spec[32];
+  char tmp[128];
+  va_list ap;
+
+  va_start(ap, fmt);
+  while (*fmt) {
+    if (*fmt != '%') {
+      out += *fmt++;
+      continue;
+    }
+
+    size_t n = 0;
+    spec[n++] = *fmt++;
+    while (*fmt && strchr("-+ #0123456789.*", *fmt) && (n < sizeof(spec) - 4)) spec[n++] = *fmt++;
+    int longs = 0;
+    while (*fmt && strchr("hlLqjzt", *fmt)) {
+      if (*fmt == 'l') longs++;
+      fmt++;
+    }
+    char conv = *fmt;
+    if (!conv) break;
+    fmt++;
+
+    switch (conv) {
+      case 'd':
+      case 'i':
+        spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = 0;
+        snprintf(tmp, sizeof(tmp), spec, (long long)((longs > 1) ? va_arg(ap, long long) : (int32_t)va_arg(ap, int)));
+        break;
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = 0;
+        snprintf(tmp, sizeof(tmp), spec, (unsigned long long)((longs > 1) ? va_arg(ap, unsigned long long) : (uint32_t)va_arg(ap, unsigned)));
+        break;
+      case 'c':
+        spec[n++] = conv; spec[n] = 0;
+        snprintf(tmp, sizeof(tmp), spec, va_arg(ap, int));
+        break;
+      case 's':
+        spec[n++] = conv; spec[n] = 0;
+        snprintf(tmp, sizeof(tmp), spec, va_arg(ap, const char*));
+        break;
+      case 'p':
+        snprintf(tmp, sizeof(tmp), "0x%08lx", (unsigned long)(uintptr_t)va_arg(ap, void*));
+        break;
+      case 'f':
+      case 'e':
+      case 'g':
+        spec[n++] = conv; spec[n] = 0;
+        snprintf(tmp, sizeof(tmp), spec, va_arg(ap, double));
+        break;
+      case '%':
+        strcpy(tmp, "%");
+        break;
+      default:
+        snprintf(tmp, sizeof(tmp), "%%%c", conv);
+        break;
+    }
+    out += tmp;
+  }
+  va_end(ap);
+
+  if (!out.empty()) _write(1, &out[0], (int32_t)out.size());
+  return (int)out.size();
+}
+
+} // extern "C"
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * File Name          : sim.h
+  * Description        : Host simulation of the STM32F030 peripherals the
+  *                      firmware uses. Peripheral registers are plain memory
+  *                      mapped at their device addresses, the simulator
+  *                      brings them up to date on every hook call: polls,
+  *                      WFI, PRIMASK changes and data register accesses.
+  *                      Time is virtual, it moves forward only by waits,
+  *                      firmware code itself takes no time.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SIM_H
+#define __SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Firmware side hooks, see sim_hooks.h */
+void Sim_Poll(void);
+void Sim_WaitForInterrupt(void);
+uint32_t Sim_GetPrimask(void);
+void Sim_SetPrimask(uint32_t primask);
+void Sim_NVIC_EnableIRQ(int32_t irq);
+void Sim_NVIC_DisableIRQ(int32_t irq);
+uint32_t Sim_NVIC_GetEnableIRQ(int32_t irq);
+uint32_t Sim_NVIC_GetPendingIRQ(int32_t irq);
+void Sim_NVIC_SetPendingIRQ(int32_t irq);
+void Sim_NVIC_ClearPendingIRQ(int32_t irq);
+void Sim_SPI_Write(uint8_t data);
+uint8_t Sim_SPI_Read(void);
+void Sim_USART_Write(uint32_t data);
+uint8_t Sim_USART_Read(void);
+int Sim_Printf(const char *fmt, ...) __attribute__((format(__printf__, 1, 2)));
+void Sim_Fault(const char *reason);
+
+/* Firmware entry points */
+void SystemInit(void);
+int Firmware_Main(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_H */
@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * File Name          : sim_hooks.h
+  * Description        : Forced include of every firmware source in the host
+  *                      simulation build. It replaces the CMSIS GCC core
+  *                      intrinsics, which are ARM assembly, and routes the
+  *                      register accesses with side effects, the polling
+  *                      waits and printf() into the simulator.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SIM_HOOKS_H
+#define __SIM_HOOKS_H
+
+#include <stdint.h>
+#include "sim.h"
+
+/* cmsis_gcc.h is skipped, its defines and intrinsics are given here */
+#define __CMSIS_GCC_H
+
+#define __ASM                     __asm
+#define __INLINE                  inline
+#define __STATIC_INLINE           static inline
+#define __STATIC_FORCEINLINE      __attribute__((always_inline)) static inline
+#define __NO_RETURN               __attribute__((__noreturn__))
+#define __USED                    __attribute__((used))
+#define __WEAK                    __attribute__((weak))
+#define __PACKED                  __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT           struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION            union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)              __attribute__((aligned(x)))
+#define __RESTRICT                __restrict
+#define __COMPILER_BARRIER()      __asm volatile("" ::: "memory")
+
+#define __enable_irq()            Sim_SetPrimask(0)
+#define __disable_irq()           Sim_SetPrimask(1)
+#define __get_PRIMASK()           Sim_GetPrimask()
+#define __set_PRIMASK(priMask)    Sim_SetPrimask(priMask)
+#define __WFI()                   Sim_WaitForInterrupt()
+#define __WFE()                   Sim_WaitForInterrupt()
+#define __SEV()                   ((void)0)
+#define __NOP()                   ((void)0)
+#define __ISB()                   __COMPILER_BARRIER()
+#define __DSB()                   __COMPILER_BARRIER()
+#define __DMB()                   __COMPILER_BARRIER()
+#define __REV(value)              __builtin_bswap32(value)
+#define __REV16(value)            ((uint32_t)(((value) & 0xff00ff00U) >> 8) | (((value) & 0x00ff00ffU) << 8))
+#define __BKPT(value)             Sim_Fault("breakpoint")
+#define __CLZ(value)              ((uint8_t)__builtin_clz(value))
+
+/* NVIC goes through cmsis_nvic_virtual.h */
+#define CMSIS_NVIC_VIRTUAL
+
+/* Register accesses with side effects */
+#define SPI_DR_WRITE(spi, data)       Sim_SPI_Write(data)
+#define SPI_DR_READ(spi)              Sim_SPI_Read()
+#define USART_TDR_WRITE(usart, data)  Sim_USART_Write(data)
+#define USART_RDR_READ(usart)         Sim_USART_Read()
+
+/* Every poll of a wait moves time forward */
+#define WAIT_POLL()               Sim_Poll()
+
+/* printf() of the firmware links to Sim_Printf(), which sends it through
+   _write() to the USART model. The name stays, so formats are checked, and
+   -fno-builtin-printf keeps the compiler from turning calls into puts() */
+#ifdef __cplusplus
+extern "C"
+#endif
+int printf(const char *fmt, ...) __asm__("Sim_Printf") __attribute__((format(__printf__, 1, 2)));
+
+#endif /* __SIM_HOOKS_H */
@@ -0,0 +1,187 @@
+/**
+  ******************************************************************************
+  * File Name          : sim_main.cpp
+  * Description        : Host simulation runner. Boots the firmware on the
+  *                      simulated STM32F030 with a BMP280 (or a BME280) on
+  *                      SPI1, prints what the firmware sends on USART1 and
+  *                      types console lines at the given virtual times.
+  *
+  *                      sim [-t seconds] [-i time:line]... [-e] [-l lsiHz]
+  *                          [-T degC] [-P Pa] [-s] [-q] [-w file]
+  *                          [-x from:to]...
+  *
+  *                      -t  virtual time to run, 10 s by default
+  *                      -i  console line typed at the given second, a CR
+  *                          is appended, e.g. -i 3:status
+  *                      -e  BME280 instead of BMP280
+  *                      -l  real LSI frequency, 40000 Hz by default
+  *                      -T  ambient temperature, -P ambient pressure
+  *                      -s  virtual time stamp on every output line
+  *                      -q  no firmware output, the summary only
+  *                      -w  raw USART1 TX stream into a file, e.g. for
+  *                          binary output of SPI_CAPTURE builds
+  *                      -x  sensor off the bus between the given seconds,
+  *                          MISO floats high, e.g. -x 3:3.5
+  *
+  *                      Exit status is 0 when the run reached its time,
+  *                      1 on a watchdog reset, 2 on a firmware fault.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "bmx280_model.h"
+
+using namespace Sim;
+
+/* Takes the sensor off the bus in the given windows */
+class Unplug : public SpiSlave {
+public:
+  explicit Unplug(SpiSlave *slave) : slave(slave) {}
+
+  void Select(Time time, bool selected) override {
+    if (!Off(time) || !selected) slave->Select(time, selected);
+  }
+
+  uint8_t Transfer(Time time, uint8_t mosi) override {
+    return ((Off(time)) ? 0xff : slave->Transfer(time, mosi));
+  }
+
+  std::vector<std::pair<Time, Time>> windows;
+
+private:
+  bool Off(Time time) const {
+    for (const auto &w : windows) {
+      if ((time >= w.first) && (time < w.second)) return true;
+    }
+    return false;
+  }
+
+  SpiSlave  *slave;
+};
+
+struct Summary {
+  uint64_t  uartBytes = 0;
+  uint32_t  refreshes = 0;
+  Time      lastRefresh = 0;
+  Time      longestGap = 0;
+  uint32_t  stops = 0;
+  Time      stopTime = 0;
+};
+
+static void Usage(void) {
+  fprintf(stderr, "usage: sim [-t seconds] [-i time:line]... [-e] [-l lsiHz] [-T degC] [-P Pa] [-s] [-q] [-w file] [-x from:to]...\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  Environment ambient;
+  double seconds = 10.0;
+  bool bme = false;
+  bool stamps = false;
+  bool quiet = false;
+  FILE *raw = nullptr;
+  std::vector<std::pair<Time, std::string>> inputs;
+  std::vector<std::pair<Time, Time>> unplugged;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:i:el:T:P:sqw:x:")) != -1) {
+    switch (opt) {
+      case 't': seconds = atof(optarg); break;
+      case 'i': {
+        const char *colon = strchr(optarg, ':');
+        if (!colon) Usage();
+        inputs.push_back({ (Time)(atof(optarg) * SEC), std::string(colon + 1) + "\r" });
+        break;
+      }
+      case 'e': bme = true; break;
+      case 'l': options.lsiHz = (uint32_t)atoi(optarg); break;
+      case 'T': ambient.temperature = atof(optarg); break;
+      case 'P': ambient.pressure = atof(optarg); break;
+      case 's': stamps = true; break;
+      case 'q': quiet = true; break;
+      case 'w':
+        raw = fopen(optarg, "wb");
+        if (!raw) {
+          perror(optarg);
+          return (2);
+        }
+        break;
+      case 'x': {
+        const char *colon = strchr(optarg, ':');
+        if (!colon) Usage();
+        unplugged.push_back({ (Time)(atof(optarg) * SEC), (Time)(atof(colon + 1) * SEC) });
+        break;
+      }
+      default: Usage();
+    }
+  }
+  if ((seconds <= 0) || !options.lsiHz) Usage();
+
+  Bmx280Model sensor(bme);
+  sensor.SetEnvironment([ambient](Time) { return ambient; });
+  Unplug bus(&sensor);
+  bus.windows = unplugged;
+
+  Summary summary;
+  bool lineStart = true;
+
+  Init(options);
+  Attach(&bus);
+  Observe().uartTx = [&](Time time, uint8_t data) {
+    summary.uartBytes++;
+    if (raw) fputc(data, raw);
+    if (quiet || (data == '\r')) return;
+    if (stamps && lineStart) printf("[%12.6f] ", (double)time / SEC);
+    putchar(data);
+    lineStart = (data == '\n');
+  };
+  Observe().watchdog = [&](Time time) {
+    if (summary.refreshes && (time - summary.lastRefresh > summary.longestGap)) {
+      summary.longestGap = time - summary.lastRefresh;
+    }
+    summary.lastRefresh = time;
+    summary.refreshes++;
+  };
+  Observe().stopMode = [&](Time entry, Time exit) {
+    summary.stops++;
+    summary.stopTime += exit - entry;
+  };
+
+  /* Console lines go in at their times, the rest runs to the end */
+  Time end = (Time)(seconds * SEC);
+  Stop stop = Stop::Deadline;
+  for (const auto &input : inputs) {
+    if (input.first >= end) continue;
+    stop = RunUntil(input.first);
+    if (stop != Stop::Deadline) break;
+    UartInputAt(input.first, input.second);
+  }
+  if (stop == Stop::Deadline) stop = RunUntil(end);
+  fflush(stdout);
+  if (raw) fclose(raw);
+
+  fprintf(stderr, "\n--- %.6f s", (double)Now() / SEC);
+  if (stop == Stop::WatchdogReset) fprintf(stderr, ", watchdog reset");
+  if (stop == Stop::Fault) fprintf(stderr, ", fault: %s", FaultReason().c_str());
+  fprintf(stderr, "\n");
+  fprintf(stderr, "uart:      %llu bytes at %u baud\n", (unsigned long long)summary.uartBytes, UartBaud());
+  fprintf(stderr, "watchdog:  %u refreshes, longest gap %.3f ms of %.3f ms\n",
+    summary.refreshes, (double)summary.longestGap / MS, (double)WatchdogTimeout() / MS);
+  fprintf(stderr, "stop mode: %u entries, %.3f s\n", summary.stops, (double)summary.stopTime / SEC);
+  fprintf(stderr, "sensor:    %u conversions\n", sensor.Conversions());
+
+  if (stop == Stop::WatchdogReset) return (1);
+  if (stop == Stop::Fault) return (2);
+  return (0);
+}
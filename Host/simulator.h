@@ -0,0 +1,88 @@
+/**
+  ******************************************************************************
+  * File Name          : simulator.h
+  * Description        : Host side interface of the simulator: machine
+  *                      options, virtual time control, line input and
+  *                      observers of the firmware behaviour.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __SIMULATOR_H
+#define __SIMULATOR_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "sim.h"
+
+namespace Sim {
+
+/* Virtual time, ns */
+typedef uint64_t Time;
+const Time NS  = 1;
+const Time US  = 1000;
+const Time MS  = 1000000;
+const Time SEC = 1000000000ULL;
+
+class SpiSlave;
+
+struct Options {
+  uint32_t  hseHz     = 8000000;      // HSE crystal, exact
+  uint32_t  lsiHz     = 40000;        // Real LSI, the firmware measures it
+  uint32_t  stackSize = 1 << 20;      // Firmware context stack
+  uint32_t  spiHz     = 0;            // SPI1 bit rate, 0 follows the CR1 prescaler
+};
+
+enum class Stop {
+  Deadline,           // RunUntil() time is reached
+  WatchdogReset,      // IWDG expired
+  Fault               // Firmware went into a fault or reset
+};
+
+/* Observers, all are optional */
+struct Observers {
+  std::function<void(Time, uint8_t)>  uartTx;         // Byte left the TX pin
+  std::function<void(Time)>           watchdog;       // IWDG refresh
+  std::function<void(Time, Time)>     stopMode;       // Stop mode entry, exit
+  std::function<void(Time, bool)>     chipSelect;     // SPI NSS level
+};
+
+void Init(const Options &options);
+void Attach(SpiSlave *slave);
+Observers& Observe(void);
+
+/* Runs the firmware from reset or from where it stopped. In between the
+   host may call firmware functions that don't wait, e.g. to read its clock,
+   no interrupt is taken meanwhile */
+Stop RunUntil(Time time);
+Time Now(void);
+const std::string& FaultReason(void);
+
+/* Queues bytes onto the USART RX line at the current baud rate */
+void UartInput(const std::string &data);
+void UartInputAt(Time time, const std::string &data);
+
+/* Current USART line rate, baud */
+uint32_t UartBaud(void);
+
+/* Current SPI1 bit rate, Hz */
+uint32_t SpiRate(void);
+
+/* IWDG timeout at the current prescaler and reload */
+Time WatchdogTimeout(void);
+
+/* SPI slave model */
+class SpiSlave {
+public:
+  virtual ~SpiSlave() {}
+  virtual void Select(Time time, bool selected) = 0;
+  virtual uint8_t Transfer(Time time, uint8_t mosi) = 0;
+};
+
+} // namespace Sim
+
+#endif /* __SIMULATOR_H */
@@ -0,0 +1,327 @@
+/**
+  ******************************************************************************
+  * File Name          : soak.cpp
+  * Description        : Soak run of the whole firmware in virtual time, a
+  *                      day takes some tens of seconds. The report has the
+  *                      firmware clock drift against true time, seconds
+  *                      without a sample and with two of them, histograms of
+  *                      the sample and output line interval jitter, the UART
+  *                      TX backlog and the watchdog refresh margins.
+  *
+  *                      soak [-t duration] [-l lsiHz] [-p] [-c seconds] [-e]
+  *                           [-D ms] [-M count] [-v]
+  *
+  *                      -t  virtual duration, s, m, h or d suffix, 1d
+  *                          by default
+  *                      -l  real LSI frequency, 40000 Hz by default
+  *                      -p  duty cycling in Stop mode from the start
+  *                      -c  console load, "tasks" is typed every given
+  *                          seconds
+  *                      -e  BME280 instead of BMP280
+  *                      -D  drift limit, 1000 ms by default
+  *                      -M  missed seconds limit, 0 by default
+  *                      -v  progress line every virtual hour
+  *
+  *                      Exit status is 1 when the run failed: watchdog
+  *                      reset, fault, drift or missed seconds over limits,
+  *                      fewer samples or output lines than the duration
+  *                      takes less the missed limit. Seconds from the last
+  *                      event to the end of the run count as missed. The
+  *                      output is parsed as text, so LOG_DEFERRED and
+  *                      SPI_CAPTURE builds are refused.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "simulator.h"
+#include "bmx280_model.h"
+#include "config.h"
+
+extern "C" {
+uint64_t Clock_Micros(void);
+uint8_t USART1_TX_Pending(void);
+}
+
+using namespace Sim;
+
+/* Nominal sample period and the TX ring capacity of the firmware */
+static const Time SAMPLE_PERIOD = SEC;
+static const uint32_t TX_RING_CAPACITY = 127;
+
+/* Counts values into bins between the given edges */
+class Histogram {
+public:
+  Histogram(const char *title, std::vector<int64_t> edges, std::vector<const char*> labels)
+    : title(title), edges(edges), labels(labels), counts(edges.size() + 1, 0) {}
+
+  void Add(int64_t value) {
+    size_t bin = 0;
+    while ((bin < edges.size()) && (value >= edges[bin])) bin++;
+    counts[bin]++;
+    total++;
+  }
+
+  void Print(void) const {
+    uint64_t peak = 1;
+    for (uint64_t c : counts) if (c > peak) peak = c;
+
+    printf("%s, %llu values\n", title, (unsigned long long)total);
+    for (size_t i = 0; i < counts.size(); i++) {
+      int bar = (int)((counts[i] * 40 + peak - 1) / peak);
+      printf("  %-20s %10llu %.*s\n", labels[i], (unsigned long long)counts[i], bar,
+        "########################################");
+    }
+  }
+
+private:
+  const char *title;
+  std::vector<int64_t> edges;
+  std::vector<const char*> labels;
+  std::vector<uint64_t> counts;
+  uint64_t total = 0;
+};
+
+/* Deviation of an interval from its nominal value, ns */
+static Histogram JitterHistogram(const char *title) {
+  return Histogram(title,
+    { -100000000, -10000000, -1000000, -100000, -10000, 10000, 100000, 1000000, 10000000, 100000000 },
+    { "< -100 ms", "-100 ms .. -10 ms", "-10 ms .. -1 ms", "-1 ms .. -100 us", "-100 us .. -10 us",
+      "-10 us .. 10 us",
+      "10 us .. 100 us", "100 us .. 1 ms", "1 ms .. 10 ms", "10 ms .. 100 ms", ">= 100 ms" });
+}
+
+/* Interval series of an event that should come once a period */
+struct Periodic {
+  Histogram jitter;
+  Time      last = 0;
+  bool      seen = false;
+  uint64_t  count = 0;
+  Time      shortest = UINT64_MAX;
+  Time      longest = 0;
+  uint64_t  missed = 0;     // True seconds without an event
+  uint64_t  doubled = 0;    // True seconds with more than one
+  uint64_t  lastSecond = 0;
+
+  explicit Periodic(const char *title) : jitter(JitterHistogram(title)) {}
+
+  void Add(Time time) {
+    uint64_t second = time / SAMPLE_PERIOD;
+
+    if (seen) {
+      Time interval = time - last;
+      jitter.Add((int64_t)interval - (int64_t)SAMPLE_PERIOD);
+      if (interval < shortest) shortest = interval;
+      if (interval > longest) longest = interval;
+      if (second > lastSecond + 1) missed += second - lastSecond - 1;
+      if (second == lastSecond) doubled++;
+    }
+    seen = true;
+    last = time;
+    lastSecond = second;
+    count++;
+  }
+
+  /* Seconds after the last event, all of them when none came */
+  void Finish(Time end) {
+    uint64_t second = end / SAMPLE_PERIOD;
+
+    if (!seen) missed += second;
+    else if (second > lastSecond + 1) missed += second - lastSecond - 1;
+  }
+};
+
+struct Report {
+  Periodic  samples{"Sample interval jitter"};
+  Periodic  lines{"Output line interval jitter"};
+
+  /* Firmware clock against true time */
+  int64_t   drift = 0;
+  int64_t   driftMax = 0;
+
+  /* UART */
+  uint64_t  uartBytes = 0;
+  uint32_t  backlogPeak = 0;
+  uint64_t  backlogFull = 0;
+  std::string line;
+  Time      lineStart = 0;
+
+  /* Watchdog */
+  Histogram margins{"Watchdog refresh margin",
+    { 250000000, 500000000, 1000000000, 1500000000 },
+    { "< 250 ms", "250 ms .. 500 ms", "500 ms .. 1 s", "1 s .. 1.5 s", ">= 1.5 s" }};
+  uint32_t  refreshes = 0;
+  Time      lastRefresh = 0;
+  Time      longestGap = 0;
+
+  /* Stop mode */
+  uint64_t  stops = 0;
+  Time      stopTime = 0;
+};
+
+static Time ParseDuration(const char *arg) {
+  char *end;
+  double value = strtod(arg, &end);
+
+  switch (*end) {
+    case 'd': value *= 86400.0; break;
+    case 'h': value *= 3600.0; break;
+    case 'm': value *= 60.0; break;
+    case 's':
+    case 0: break;
+    default: return (0);
+  }
+  return ((value > 0) ? (Time)(value * SEC) : 0);
+}
+
+static void PrintTime(const char *label, Time t) {
+  printf("%-22s %.6f s\n", label, (double)t / SEC);
+}
+
+static void Usage(void) {
+  fprintf(stderr, "usage: soak [-t duration] [-l lsiHz] [-p] [-c seconds] [-e] [-D ms] [-M count] [-v]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  Time duration = 86400 * SEC;
+  Time consolePeriod = 0;
+  bool lowPower = false;
+  bool bme = false;
+  bool verbose = false;
+  double driftLimitMs = 1000.0;
+  uint64_t missedLimit = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:l:pc:eD:M:v")) != -1) {
+    switch (opt) {
+      case 't': duration = ParseDuration(optarg); break;
+      case 'l': options.lsiHz = (uint32_t)atoi(optarg); break;
+      case 'p': lowPower = true; break;
+      case 'c': consolePeriod = ParseDuration(optarg); break;
+      case 'e': bme = true; break;
+      case 'D': driftLimitMs = atof(optarg); break;
+      case 'M': missedLimit = strtoull(optarg, nullptr, 10); break;
+      case 'v': verbose = true; break;
+      default: Usage();
+    }
+  }
+  if (!duration || !options.lsiHz) Usage();
+
+#if defined(LOG_DEFERRED) || defined(SPI_CAPTURE)
+  fprintf(stderr, "soak: the firmware sends binary output, build it without LOG_DEFERRED and SPI_CAPTURE\n");
+  return (2);
+#endif
+
+  Report r;
+  Bmx280Model sensor(bme);
+
+  Init(options);
+  Attach(&sensor);
+  sensor.conversionStart = [&](Time time) { r.samples.Add(time); };
+
+  Observe().uartTx = [&](Time time, uint8_t data) {
+    uint32_t pending = USART1_TX_Pending();
+    r.uartBytes++;
+    if (pending > r.backlogPeak) r.backlogPeak = pending;
+    if (pending >= TX_RING_CAPACITY) r.backlogFull++;
+
+    if (r.line.empty()) r.lineStart = time;
+    if (data == '\n') {
+      if (r.line.compare(0, 5, "temp:") == 0) r.lines.Add(r.lineStart);
+      r.line.clear();
+    } else if ((data != '\r') && (r.line.size() < 80)) {
+      r.line += (char)data;
+    }
+  };
+  Observe().watchdog = [&](Time time) {
+    if (r.refreshes) {
+      Time gap = time - r.lastRefresh;
+      Time timeout = WatchdogTimeout();
+      r.margins.Add((gap < timeout) ? (int64_t)(timeout - gap) : 0);
+      if (gap > r.longestGap) r.longestGap = gap;
+    }
+    r.lastRefresh = time;
+    r.refreshes++;
+  };
+  Observe().stopMode = [&](Time entry, Time exit) {
+    r.stops++;
+    r.stopTime += exit - entry;
+  };
+
+  /* Runs by virtual seconds, the firmware clock is read in between */
+  Stop stop = Stop::Deadline;
+  Time nextConsole = (consolePeriod) ? consolePeriod : UINT64_MAX;
+  if (lowPower) UartInputAt(SEC / 2, "lp on\r");
+
+  for (Time t = SEC; (t <= duration) && (stop == Stop::Deadline); t += SEC) {
+    stop = RunUntil(t);
+    if (stop != Stop::Deadline) break;
+
+    r.drift = (int64_t)(Clock_Micros() * US) - (int64_t)Now();
+    if (std::llabs(r.drift) > std::llabs(r.driftMax)) r.driftMax = r.drift;
+
+    if (t >= nextConsole) {
+      UartInput("tasks\r");
+      nextConsole += consolePeriod;
+    }
+    if (verbose && !(t % (3600 * SEC))) {
+      fprintf(stderr, "%6llu h: drift %+.3f ms, missed %llu, %llu samples\n",
+        (unsigned long long)(t / (3600 * SEC)), (double)r.drift / MS,
+        (unsigned long long)r.samples.missed, (unsigned long long)r.samples.count);
+    }
+  }
+
+  r.samples.Finish(Now());
+  r.lines.Finish(Now());
+
+  /* Report */
+  double seconds = (double)Now() / SEC;
+  uint32_t baud = UartBaud();
+
+  PrintTime("Virtual time", Now());
+  if (stop == Stop::WatchdogReset) printf("Stopped by a watchdog reset\n");
+  if (stop == Stop::Fault) printf("Stopped by a fault: %s\n", FaultReason().c_str());
+  printf("Clock drift            %+.3f ms, %+.2f ppm, peak %+.3f ms\n",
+    (double)r.drift / MS, (seconds > 0) ? ((double)r.drift / (seconds * 1000.0)) : 0.0, (double)r.driftMax / MS);
+  printf("Samples                %llu, missed seconds %llu, doubled seconds %llu\n",
+    (unsigned long long)r.samples.count, (unsigned long long)r.samples.missed, (unsigned long long)r.samples.doubled);
+  if (r.samples.count > 1) {
+    printf("Sample interval        %.6f .. %.6f s\n", (double)r.samples.shortest / SEC, (double)r.samples.longest / SEC);
+  }
+  printf("Output lines           %llu, missed seconds %llu, doubled seconds %llu\n",
+    (unsigned long long)r.lines.count, (unsigned long long)r.lines.missed, (unsigned long long)r.lines.doubled);
+  printf("UART TX                %llu bytes, %.2f%% of %u baud, backlog peak %u of %u, full %llu times\n",
+    (unsigned long long)r.uartBytes, (baud && seconds > 0) ? ((r.uartBytes * 1000.0) / (baud * seconds)) : 0.0,
+    baud, r.backlogPeak, TX_RING_CAPACITY, (unsigned long long)r.backlogFull);
+  printf("Watchdog               %u refreshes, longest gap %.3f ms of %.3f ms\n",
+    r.refreshes, (double)r.longestGap / MS, (double)WatchdogTimeout() / MS);
+  printf("Stop mode              %llu entries, %.1f%% of the time\n",
+    (unsigned long long)r.stops, (seconds > 0) ? ((double)r.stopTime * 100.0 / (double)Now()) : 0.0);
+  printf("\n");
+  r.samples.jitter.Print();
+  printf("\n");
+  r.lines.jitter.Print();
+  printf("\n");
+  r.margins.Print();
+
+  /* The first sample comes a period after the start */
+  uint64_t expected = Now() / SAMPLE_PERIOD;
+  uint64_t least = (expected > missedLimit + 1) ? (expected - missedLimit - 1) : 0;
+  bool failed = (stop != Stop::Deadline)
+    || (std::fabs((double)r.drift / MS) > driftLimitMs)
+    || (r.samples.missed > missedLimit) || (r.lines.missed > missedLimit)
+    || (r.samples.count < least) || (r.lines.count < least);
+  printf("\n%s\n", (failed) ? "FAILED" : "PASSED");
+  return ((failed) ? 1 : 0);
+}
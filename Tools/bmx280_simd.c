@@ -0,0 +1,120 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_simd.c
+  * Description        : Host SIMD builds of the batch integer compensation.
+  *                      The kernel is written once on GCC vector types, 8
+  *                      samples a step, and is built for SSE4.1 and AVX2 by
+  *                      target attributes. Operations wrap as on the target,
+  *                      the file is built with -fwrapv. There is no vector
+  *                      integer division, the unsigned one goes through
+  *                      doubles: for 32-bit operands the truncated double
+  *                      quotient is exact. A tail under 8 samples is left to
+  *                      the portable batch.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <string.h>
+
+#include "bmx280_simd.h"
+
+typedef int32_t  v8si __attribute__((vector_size(32)));
+typedef uint32_t v8su __attribute__((vector_size(32)));
+typedef double   v8df __attribute__((vector_size(64)));
+
+#define LANES   8
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+static inline __attribute__((always_inline))
+void Batch(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count) {
+  const int32_t T1 = cal->T1, T2 = cal->T2, T3 = cal->T3;
+  const int32_t P1 = cal->P1, P2 = cal->P2, P3 = cal->P3, P5 = cal->P5;
+  const int32_t P6 = cal->P6, P7 = cal->P7, P8 = cal->P8, P9 = cal->P9;
+  const int32_t P4 = (int32_t)((uint32_t)(int32_t)cal->P4 << 16);
+  uint32_t i = 0;
+
+  for (; i + LANES <= count; i += LANES) {
+    v8si adc, var1, var2, tFine, temp;
+    memcpy(&adc, t + i, sizeof(adc));
+
+    var1 = (((adc >> 3) - (T1 << 1)) * T2) >> 11;
+    var2 = (adc >> 4) - T1;
+    var2 = (((var2 * var2) >> 12) * T3) >> 14;
+    tFine = var1 + var2;
+    temp = (tFine * 5 + 128) >> 8;
+    memcpy(t + i, &temp, sizeof(temp));
+
+    if (!p) continue;
+
+    v8si sq;
+    v8su pres, num, quo, big;
+    memcpy(&adc, p + i, sizeof(adc));
+
+    var1 = (tFine >> 1) - 64000;
+    sq = (var1 >> 2) * (var1 >> 2);
+    var2 = (sq >> 11) * P6;
+    var2 = var2 + ((var1 * P5) << 1);
+    var2 = (var2 >> 2) + P4;
+    var1 = (((P3 * (sq >> 13)) >> 3) + ((P2 * var1) >> 1)) >> 18;
+    var1 = ((32768 + var1) * P1) >> 15;
+
+    pres = ((v8su)(1048576 - adc) - (v8su)(var2 >> 12)) * 3125U;
+    big = (v8su)((v8si)pres < 0);
+    num = (pres & big) | ((pres << 1) & ~big);
+    quo = __builtin_convertvector(__builtin_convertvector(num, v8df) / __builtin_convertvector((v8su)var1, v8df), v8su);
+    pres = ((quo << 1) & big) | (quo & ~big);
+
+    var2 = (P9 * (v8si)(((pres >> 3) * (pres >> 3)) >> 13)) >> 12;
+    var2 = var2 + (((v8si)(pres >> 2) * P8) >> 13);
+    pres = (v8su)((v8si)pres + ((var2 + P7) >> 4));
+    pres &= ~(v8su)(var1 == 0);
+    memcpy(p + i, &pres, sizeof(pres));
+  }
+
+  if (i < count) bmp280_compensate_TP_int32_batch(cal, t + i, (p) ? (p + i) : 0, count - i);
+}
+
+
+
+
+
+__attribute__((target("sse4.1")))
+void bmp280_compensate_TP_int32_batch_sse41(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count) {
+  Batch(cal, t, p, count);
+}
+
+__attribute__((target("avx2")))
+void bmp280_compensate_TP_int32_batch_avx2(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count) {
+  Batch(cal, t, p, count);
+}
+
+
+
+
+
+void bmp280_compensate_TP_int32_batch_host(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count) {
+  if (__builtin_cpu_supports("avx2")) {
+    bmp280_compensate_TP_int32_batch_avx2(cal, t, p, count);
+  } else if (__builtin_cpu_supports("sse4.1")) {
+    bmp280_compensate_TP_int32_batch_sse41(cal, t, p, count);
+  } else {
+    bmp280_compensate_TP_int32_batch(cal, t, p, count);
+  }
+}
+
+const char* bmp280_compensate_host_isa(void) {
+  if (__builtin_cpu_supports("avx2")) return "avx2";
+  if (__builtin_cpu_supports("sse4.1")) return "sse4.1";
+  return "portable";
+}
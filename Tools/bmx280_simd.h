@@ -0,0 +1,32 @@
+/**
+  ******************************************************************************
+  * File Name          : bmx280_simd.h
+  * Description        : Host SSE4.1 and AVX2 builds of the batch integer
+  *                      compensation, bit for bit as
+  *                      bmp280_compensate_TP_int32_batch().
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __BMX280_SIMD_H
+#define __BMX280_SIMD_H
+
+#include "../Core/Inc/bmx280_comp.h"
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+void bmp280_compensate_TP_int32_batch_sse41(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count);
+void bmp280_compensate_TP_int32_batch_avx2(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count);
+
+/* The widest build the CPU runs, the portable one otherwise */
+void bmp280_compensate_TP_int32_batch_host(const bmx280_t *cal, BMP280_S32_t *t, BMP280_U32_t *p, uint32_t count);
+const char* bmp280_compensate_host_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* __BMX280_SIMD_H */
@@ -0,0 +1,650 @@
+/**
+  ******************************************************************************
+  * File Name          : compcheck.cpp
+  * Description        : Host conformance and throughput check of the BMx280
+  *                      compensation kernels, Core/Src/bmx280_comp.c. Every
+  *                      kernel is compared bit for bit with the Bosch
+  *                      datasheet formulas over the whole 20-bit ADC range,
+  *                      pressure at a grid of t_fine values, for every
+  *                      calibration set. The int32 references wrap like the
+  *                      Cortex-M0 does, the kernels are built with -fwrapv.
+  *                      Batch kernels take temperature and pressure
+  *                      together, over the whole adc_T range with a ramp of
+  *                      adc_P and over the pressure grid, SIMD builds are
+  *                      checked when the CPU runs them. The worked example
+  *                      of the datasheet is checked first, it anchors the
+  *                      reference formulas. Work is spread over all cores.
+  *
+  *                      compcheck [-c corpus.txt] [-r count] [-S seed]
+  *                                [-s step] [-j threads] [-n]
+  *
+  *                      -c  more calibration sets, a line of T1 T2 T3
+  *                          P1 .. P9 each, '#' starts a comment. The
+  *                          corpus of Tools/calib.txt, found next to the
+  *                          build directory, is always checked.
+  *                      -r  random calibration sets over the full register
+  *                          ranges, 8 by default, -S seeds them, 1 by
+  *                          default, so the default run is repeatable
+  *                      -s  adc_T step of the pressure t_fine grid, 16384
+  *                          by default, 1 makes it exhaustive
+  *                      -j  threads, all cores by default
+  *                      -n  throughput only
+  *
+  *                      Exit status is 1 on any mismatch.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+#include "../Core/Inc/bmx280_comp.h"
+#include "bmx280_simd.h"
+
+/* Checked-in corpus of device calibrations, relative to the executable */
+static const char CORPUS[] = "../calib.txt";
+
+static const int32_t ADC_RANGE = 1 << 20;
+static const unsigned MISMATCH_SHOWN = 5;
+
+/* Kernel outputs are compared as bit patterns */
+typedef uint64_t (*TempFunc)(const bmx280_t *cal, int32_t adc, int32_t *tFine);
+typedef uint64_t (*PressFunc)(const bmx280_t *cal, int32_t adc, int32_t tFine);
+
+struct Kernel {
+  const char  *name;
+  TempFunc    temp;         // One of temp and press is set
+  PressFunc   press;
+  TempFunc    refTemp;
+  PressFunc   refPress;
+  bool        isDouble;
+};
+
+/* Batch kernels compensate arrays of adc_T and adc_P in place */
+typedef void (*BatchFunc)(const bmx280_t *cal, int32_t *t, uint32_t *p, uint32_t count);
+
+struct BatchKernel {
+  const char  *name;
+  BatchFunc   batch;
+  bool        (*supported)(void);   // CPU runs it, null for always
+};
+
+static uint64_t Bits(double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Bosch datasheet formulas, BMP280 section 8.2 and 8.1. Every int32
+// operation wraps as two's complement, shifts of negatives are arithmetic.
+
+static inline int32_t W(int64_t value) {
+  return (int32_t)(uint32_t)(uint64_t)value;
+}
+
+static uint64_t RefTempInt32(const bmx280_t *c, int32_t adc, int32_t *tFine) {
+  int32_t var1 = W(W((int64_t)(adc >> 3) - ((int32_t)c->T1 << 1)) * (int64_t)c->T2) >> 11;
+  int32_t d = W((int64_t)(adc >> 4) - c->T1);
+  int32_t var2 = W((int64_t)(W((int64_t)d * d) >> 12) * c->T3) >> 14;
+  *tFine = W((int64_t)var1 + var2);
+  return (uint32_t)(W(W((int64_t)*tFine * 5) + 128LL) >> 8);
+}
+
+static uint64_t RefPressInt32(const bmx280_t *c, int32_t adc, int32_t tFine) {
+  int32_t var1, var2;
+  uint32_t p;
+
+  var1 = W((int64_t)(tFine >> 1) - 64000);
+  var2 = W((int64_t)(W((int64_t)(var1 >> 2) * (var1 >> 2)) >> 11) * c->P6);
+  var2 = W((int64_t)var2 + (int32_t)((uint32_t)W((int64_t)var1 * c->P5) << 1));
+  var2 = W((int64_t)(var2 >> 2) + (int32_t)((uint32_t)(int32_t)c->P4 << 16));
+  var1 = W((int64_t)(W((int64_t)c->P3 * (W((int64_t)(var1 >> 2) * (var1 >> 2)) >> 13)) >> 3)
+    + (W((int64_t)c->P2 * var1) >> 1)) >> 18;
+  var1 = W((int64_t)W(32768LL + var1) * c->P1) >> 15;
+  if (var1 == 0) return 0;
+
+  p = ((uint32_t)W(1048576LL - adc) - (uint32_t)(var2 >> 12)) * 3125U;
+  if (p < 0x80000000U) p = (p << 1) / (uint32_t)var1;
+  else p = (p / (uint32_t)var1) * 2;
+  var1 = W((int64_t)c->P9 * (int32_t)(((p >> 3) * (p >> 3)) >> 13)) >> 12;
+  var2 = W((int64_t)(int32_t)(p >> 2) * c->P8) >> 13;
+  return (uint32_t)W((int64_t)(int32_t)p + (W((int64_t)var1 + var2 + c->P7) >> 4));
+}
+
+/* 64-bit operations wrap as well, the kernel is built with -fwrapv */
+static inline int64_t W64(uint64_t value) {
+  return (int64_t)value;
+}
+
+static uint64_t RefPressInt64(const bmx280_t *c, int32_t adc, int32_t tFine) {
+  int64_t var1, var2, p;
+
+  var1 = (int64_t)tFine - 128000;
+  var2 = W64((uint64_t)var1 * (uint64_t)var1 * (uint64_t)(int64_t)c->P6);
+  var2 = W64((uint64_t)var2 + (((uint64_t)var1 * (uint64_t)(int64_t)c->P5) << 17));
+  var2 = W64((uint64_t)var2 + ((uint64_t)(int64_t)c->P4 << 35));
+  var1 = W64((uint64_t)(W64((uint64_t)var1 * (uint64_t)var1 * (uint64_t)(int64_t)c->P3) >> 8)
+    + (((uint64_t)var1 * (uint64_t)(int64_t)c->P2) << 12));
+  var1 = W64(((1ULL << 47) + (uint64_t)var1) * (uint64_t)c->P1) >> 33;
+  if (var1 == 0) return 0;
+
+  p = 1048576 - (int64_t)adc;
+  p = W64(((uint64_t)p << 31) - (uint64_t)var2);
+  p = W64((uint64_t)p * 3125U) / var1;
+  var1 = W64((uint64_t)(int64_t)c->P9 * (uint64_t)(p >> 13) * (uint64_t)(p >> 13)) >> 25;
+  var2 = W64((uint64_t)(int64_t)c->P8 * (uint64_t)p) >> 19;
+  p = W64((uint64_t)(W64((uint64_t)p + (uint64_t)var1 + (uint64_t)var2) >> 8) + ((uint64_t)(int64_t)c->P7 << 4));
+  return (uint32_t)p;
+}
+
+static uint64_t RefTempDouble(const bmx280_t *c, int32_t adc, int32_t *tFine) {
+  double var1 = (((double)adc) / 16384.0 - ((double)c->T1) / 1024.0) * ((double)c->T2);
+  double var2 = ((((double)adc) / 131072.0 - ((double)c->T1) / 8192.0)
+    * (((double)adc) / 131072.0 - ((double)c->T1) / 8192.0)) * ((double)c->T3);
+  *tFine = (int32_t)(var1 + var2);
+  return Bits((var1 + var2) / 5120.0);
+}
+
+static uint64_t RefPressDouble(const bmx280_t *c, int32_t adc, int32_t tFine) {
+  double var1 = ((double)tFine / 2.0) - 64000.0;
+  double var2 = var1 * var1 * ((double)c->P6) / 32768.0;
+  var2 = var2 + var1 * ((double)c->P5) * 2.0;
+  var2 = (var2 / 4.0) + (((double)c->P4) * 65536.0);
+  var1 = (((double)c->P3) * var1 * var1 / 524288.0 + ((double)c->P2) * var1) / 524288.0;
+  var1 = (1.0 + var1 / 32768.0) * ((double)c->P1);
+  if (var1 == 0.0) return Bits(0.0);
+  double p = 1048576.0 - (double)adc;
+  p = (p - (var2 / 4096.0)) * 6250.0 / var1;
+  var1 = ((double)c->P9) * p * p / 2147483648.0;
+  var2 = p * ((double)c->P8) / 32768.0;
+  return Bits(p + (var1 + var2 + ((double)c->P7)) / 16.0);
+}
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Kernels under check, a new implementation gets its line here
+
+static const Kernel kernels[] = {
+  { "bmp280_compensate_T_int32",
+    [](const bmx280_t *c, int32_t adc, int32_t *t) -> uint64_t { return (uint32_t)bmp280_compensate_T_int32(c, adc, t); },
+    nullptr, RefTempInt32, nullptr, false },
+  { "bmp280_compensate_P_int32",
+    nullptr, [](const bmx280_t *c, int32_t adc, int32_t t) -> uint64_t { return bmp280_compensate_P_int32(c, adc, t); },
+    nullptr, RefPressInt32, false },
+  { "bmp280_compensate_P_int64",
+    nullptr, [](const bmx280_t *c, int32_t adc, int32_t t) -> uint64_t { return bmp280_compensate_P_int64(c, adc, t); },
+    nullptr, RefPressInt64, false },
+  { "bmp280_compensate_T_double",
+    [](const bmx280_t *c, int32_t adc, int32_t *t) -> uint64_t { return Bits(bmp280_compensate_T_double(c, adc, t)); },
+    nullptr, RefTempDouble, nullptr, true },
+  { "bmp280_compensate_P_double",
+    nullptr, [](const bmx280_t *c, int32_t adc, int32_t t) -> uint64_t { return Bits(bmp280_compensate_P_double(c, adc, t)); },
+    nullptr, RefPressDouble, true },
+};
+static const unsigned KERNEL_COUNT = sizeof(kernels) / sizeof(kernels[0]);
+
+static const BatchKernel batchKernels[] = {
+  { "bmp280_compensate_TP_int32_batch", bmp280_compensate_TP_int32_batch, nullptr },
+  { "..._batch_sse41", bmp280_compensate_TP_int32_batch_sse41,
+    []() -> bool { return __builtin_cpu_supports("sse4.1"); } },
+  { "..._batch_avx2", bmp280_compensate_TP_int32_batch_avx2,
+    []() -> bool { return __builtin_cpu_supports("avx2"); } },
+};
+static const unsigned BATCH_KERNEL_COUNT = sizeof(batchKernels) / sizeof(batchKernels[0]);
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct Result {
+  std::atomic<uint64_t> checked{0};
+  std::atomic<uint64_t> mismatches{0};
+  std::mutex            lock;
+  std::vector<std::string> shown;
+  double                rate = 0;
+};
+
+static std::vector<bmx280_t> sets;
+static std::vector<std::vector<int32_t>> grids;   // t_fine grid of every set
+
+/**
+  * @brief  Path of the checked-in corpus, Tools/calib.txt when the tool
+  *         runs from Tools/build, wherever the tree is.
+  */
+static std::string CorpusPath(void) {
+  char exe[4096];
+  ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+
+  if (len <= 0) return "calib.txt";
+  std::string path(exe, (size_t)len);
+  return path.substr(0, path.rfind('/') + 1) + CORPUS;
+}
+
+
+
+
+
+/**
+  * @brief  Loads calibration sets of a corpus file. Lines printed by the
+  *         "calib" console command are taken with their prefix.
+  */
+static bool LoadCorpus(const char *path) {
+  std::ifstream f(path);
+  std::string line;
+
+  if (!f) {
+    fprintf(stderr, "can't open %s\n", path);
+    return false;
+  }
+  while (std::getline(f, line)) {
+    line = line.substr(0, line.find('#'));
+    if (line.compare(0, 6, "calib:") == 0) line.erase(0, 6);
+    std::istringstream in(line);
+    long v[12];
+    int n = 0;
+    while ((n < 12) && (in >> v[n])) n++;
+    if (!n) continue;
+    if (n != 12) {
+      fprintf(stderr, "%s: a set needs 12 values: %s\n", path, line.c_str());
+      return false;
+    }
+    bmx280_t c = {};
+    c.T1 = (uint16_t)v[0]; c.T2 = (int16_t)v[1]; c.T3 = (int16_t)v[2];
+    c.P1 = (uint16_t)v[3]; c.P2 = (int16_t)v[4]; c.P3 = (int16_t)v[5];
+    c.P4 = (int16_t)v[6]; c.P5 = (int16_t)v[7]; c.P6 = (int16_t)v[8];
+    c.P7 = (int16_t)v[9]; c.P8 = (int16_t)v[10]; c.P9 = (int16_t)v[11];
+    sets.push_back(c);
+  }
+  return true;
+}
+
+
+
+
+
+/**
+  * @brief  The worked example of the datasheet: 25.08 DegC and 100653.27 Pa
+  *         out of adc_T 519888 and adc_P 415148. It anchors the
+  *         transcriptions above, which are checked against each other only.
+  */
+static bool DatasheetExample(void) {
+  bmx280_t c = {};
+  int32_t tFine;
+
+  c.T1 = 27504; c.T2 = 26435; c.T3 = -1000;
+  c.P1 = 36477; c.P2 = -10685; c.P3 = 3024; c.P4 = 2855; c.P5 = 140;
+  c.P6 = -7; c.P7 = 15500; c.P8 = -14600; c.P9 = 6000;
+
+  int32_t t = bmp280_compensate_T_int32(&c, 519888, &tFine);
+  uint32_t p64 = (bmp280_compensate_P_int64(&c, 415148, tFine) + 128) >> 8;
+  bool ok = (t == 2508) && (p64 == 100653);
+
+  printf("datasheet example: %" PRId32 " (0.01 DegC), %" PRIu32 " Pa by the int64 kernel %s\n\n",
+    t, p64, (ok) ? "ok" : "MISMATCH");
+  return ok;
+}
+
+
+
+
+
+/**
+  * @brief  Runs a job per index over the threads.
+  */
+template <typename Job>
+static void Parallel(unsigned threads, uint64_t jobs, Job job) {
+  std::atomic<uint64_t> next{0};
+  std::vector<std::thread> pool;
+
+  for (unsigned t = 0; t < threads; t++) {
+    pool.emplace_back([&]() {
+      for (uint64_t i; (i = next++) < jobs; ) job(i);
+    });
+  }
+  for (auto &th : pool) th.join();
+}
+
+
+
+
+
+static void Mismatch(Result &r, const Kernel &k, size_t set, int32_t adc, int32_t tFine,
+                     uint64_t got, uint64_t want, int32_t gotFine, int32_t wantFine) {
+  if (r.mismatches++ >= MISMATCH_SHOWN) return;
+
+  char where[64];
+  char text[256];
+  if (k.temp) snprintf(where, sizeof(where), "set %zu adc_T %" PRId32, set, adc);
+  else snprintf(where, sizeof(where), "set %zu adc_P %" PRId32 " t_fine %" PRId32, set, adc, tFine);
+
+  if (k.isDouble) {
+    double g, w;
+    memcpy(&g, &got, sizeof(g));
+    memcpy(&w, &want, sizeof(w));
+    snprintf(text, sizeof(text), "%s: %.17g, expected %.17g", where, g, w);
+  } else if (k.temp) {
+    snprintf(text, sizeof(text), "%s: %" PRId32 ", expected %" PRId32, where, (int32_t)got, (int32_t)want);
+  } else {
+    snprintf(text, sizeof(text), "%s: %" PRIu64 ", expected %" PRIu64, where, got, want);
+  }
+  if (gotFine != wantFine) {
+    size_t len = strlen(text);
+    snprintf(text + len, sizeof(text) - len, ", t_fine %" PRId32 ", expected %" PRId32, gotFine, wantFine);
+  }
+  std::lock_guard<std::mutex> guard(r.lock);
+  r.shown.push_back(text);
+}
+
+
+
+
+
+/**
+  * @brief  Temperature kernels over the whole ADC range of every set, a job
+  *         is a set and a 64k slice of the range.
+  */
+static void CheckTemp(const Kernel &k, Result &r, unsigned threads) {
+  const uint64_t slices = ADC_RANGE >> 16;
+
+  Parallel(threads, sets.size() * slices, [&](uint64_t job) {
+    size_t s = job / slices;
+    int32_t base = (int32_t)((job % slices) << 16);
+    const bmx280_t *c = &sets[s];
+    for (int32_t adc = base; adc < base + (1 << 16); adc++) {
+      int32_t gotFine = 0, wantFine = 0;
+      uint64_t got = k.temp(c, adc, &gotFine);
+      uint64_t want = k.refTemp(c, adc, &wantFine);
+      if ((got != want) || (gotFine != wantFine)) Mismatch(r, k, s, adc, 0, got, want, gotFine, wantFine);
+    }
+    r.checked += 1 << 16;
+  });
+}
+
+
+
+
+
+/**
+  * @brief  Pressure kernels over the whole ADC range at every t_fine of
+  *         the grid, a job is a set and a t_fine.
+  */
+static void CheckPress(const Kernel &k, Result &r, unsigned threads) {
+  std::vector<std::pair<size_t, int32_t>> jobs;
+  for (size_t s = 0; s < sets.size(); s++) {
+    for (int32_t tFine : grids[s]) jobs.push_back({ s, tFine });
+  }
+
+  Parallel(threads, jobs.size(), [&](uint64_t job) {
+    size_t s = jobs[job].first;
+    int32_t tFine = jobs[job].second;
+    const bmx280_t *c = &sets[s];
+    for (int32_t adc = 0; adc < ADC_RANGE; adc++) {
+      uint64_t got = k.press(c, adc, tFine);
+      uint64_t want = k.refPress(c, adc, tFine);
+      if (got != want) Mismatch(r, k, s, adc, tFine, got, want, 0, 0);
+    }
+    r.checked += ADC_RANGE;
+  });
+}
+
+
+
+
+
+/**
+  * @brief  Kernel alone over the range, samples per second of all threads.
+  */
+static double Throughput(const Kernel &k, unsigned threads) {
+  const uint64_t passes = 8;
+  std::atomic<uint64_t> sink{0};
+  const bmx280_t *c = &sets[0];
+  int32_t tFine = grids[0][grids[0].size() / 2];
+
+  auto start = std::chrono::steady_clock::now();
+  Parallel(threads, passes * threads, [&](uint64_t job) {
+    uint64_t acc = 0;
+    int32_t fine = 0;
+    (void)job;
+    if (k.temp) {
+      for (int32_t adc = 0; adc < ADC_RANGE; adc++) acc += k.temp(c, adc, &fine);
+    } else {
+      for (int32_t adc = 0; adc < ADC_RANGE; adc++) acc += k.press(c, adc, tFine);
+    }
+    sink += acc + (uint32_t)fine;
+  });
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return (double)(passes * threads * ADC_RANGE) / elapsed.count();
+}
+
+
+
+
+
+/**
+  * @brief  Batch kernels against the references, a job is a 64k block of
+  *         samples. Temperature blocks cover the whole adc_T range with
+  *         adc_P running along, grid blocks hold a t_fine and the whole
+  *         adc_P range. Odd block lengths leave a tail to the portable code.
+  */
+static void CheckBatch(const BatchKernel &k, Result &r, unsigned threads) {
+  const uint32_t block = (1 << 16) - 3;
+  const uint64_t blocks = (ADC_RANGE + block - 1) / block;
+  std::vector<std::pair<size_t, int32_t>> jobs;
+
+  for (size_t s = 0; s < sets.size(); s++) {
+    jobs.push_back({ s, -1 });
+    for (int32_t adcT : grids[s]) jobs.push_back({ s, adcT });
+  }
+
+  Parallel(threads, jobs.size() * blocks, [&](uint64_t job) {
+    size_t s = jobs[job / blocks].first;
+    int32_t gridT = jobs[job / blocks].second;
+    int32_t base = (int32_t)((job % blocks) * block);
+    uint32_t count = (uint32_t)std::min<int64_t>(block, ADC_RANGE - base);
+    const bmx280_t *c = &sets[s];
+    std::vector<int32_t> t(count);
+    std::vector<uint32_t> p(count);
+
+    for (uint32_t i = 0; i < count; i++) {
+      t[i] = (gridT < 0) ? (base + (int32_t)i) : gridT;
+      p[i] = (uint32_t)(base + (int32_t)i) ^ ((gridT < 0) ? 0x5a5a5 : 0);
+    }
+    k.batch(c, t.data(), p.data(), count);
+
+    for (uint32_t i = 0; i < count; i++) {
+      int32_t adcT = (gridT < 0) ? (base + (int32_t)i) : gridT;
+      int32_t adcP = (int32_t)((uint32_t)(base + (int32_t)i) ^ ((gridT < 0) ? 0x5a5a5 : 0));
+      int32_t tFine;
+      uint32_t wantT = (uint32_t)RefTempInt32(c, adcT, &tFine);
+      uint32_t wantP = (uint32_t)RefPressInt32(c, adcP, tFine);
+      if (((uint32_t)t[i] != wantT) || (p[i] != wantP)) {
+        if (r.mismatches++ >= MISMATCH_SHOWN) continue;
+        char text[160];
+        snprintf(text, sizeof(text), "set %zu adc_T %" PRId32 " adc_P %" PRId32 ": %" PRId32 " %" PRIu32
+          ", expected %" PRId32 " %" PRIu32, s, adcT, adcP, t[i], p[i], (int32_t)wantT, wantP);
+        std::lock_guard<std::mutex> guard(r.lock);
+        r.shown.push_back(text);
+      }
+    }
+    r.checked += count;
+  });
+}
+
+
+
+
+
+/**
+  * @brief  Batch kernel throughput in blocks that stay in the cache, the
+  *         raw samples are copied in before every block.
+  */
+static double ThroughputBatch(const BatchKernel &k, unsigned threads) {
+  const uint64_t passes = 8;
+  const uint32_t block = 4096;
+  std::atomic<uint64_t> sink{0};
+  const bmx280_t *c = &sets[0];
+  std::vector<int32_t> rawT(ADC_RANGE);
+  std::vector<uint32_t> rawP(ADC_RANGE);
+
+  for (int32_t i = 0; i < ADC_RANGE; i++) {
+    rawT[i] = i;
+    rawP[i] = (uint32_t)i ^ 0x5a5a5;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  Parallel(threads, passes * threads, [&](uint64_t job) {
+    std::vector<int32_t> t(block);
+    std::vector<uint32_t> p(block);
+    uint64_t acc = 0;
+    (void)job;
+    for (int32_t base = 0; base < ADC_RANGE; base += block) {
+      memcpy(t.data(), &rawT[base], block * sizeof(int32_t));
+      memcpy(p.data(), &rawP[base], block * sizeof(uint32_t));
+      k.batch(c, t.data(), p.data(), block);
+      acc += (uint32_t)t[block - 1] + p[block - 1];
+    }
+    sink += acc;
+  });
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  return (double)(passes * threads * ADC_RANGE) / elapsed.count();
+}
+
+
+
+
+
+static void Usage(void) {
+  fprintf(stderr, "usage: compcheck [-c corpus.txt] [-r count] [-S seed] [-s step] [-j threads] [-n]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::thread::hardware_concurrency();
+  unsigned randomSets = 8;
+  unsigned seed = 1;
+  int32_t step = 16384;
+  bool check = true;
+  int opt;
+
+  if (!LoadCorpus(CorpusPath().c_str())) return 2;
+  while ((opt = getopt(argc, argv, "c:r:S:s:j:n")) != -1) {
+    switch (opt) {
+      case 'c': if (!LoadCorpus(optarg)) return 2; break;
+      case 'r': randomSets = (unsigned)atoi(optarg); break;
+      case 'S': seed = (unsigned)atoi(optarg); break;
+      case 's': step = atoi(optarg); break;
+      case 'j': threads = (unsigned)atoi(optarg); break;
+      case 'n': check = false; break;
+      default: Usage();
+    }
+  }
+  if ((step < 1) || (step > ADC_RANGE)) Usage();
+  if (!threads) threads = 1;
+
+  std::mt19937 rng(seed);
+  for (unsigned i = 0; i < randomSets; i++) {
+    std::uniform_int_distribution<int> u16(0, 65535), s16(-32768, 32767);
+    bmx280_t c = {};
+    c.T1 = (uint16_t)u16(rng); c.T2 = (int16_t)s16(rng); c.T3 = (int16_t)s16(rng);
+    c.P1 = (uint16_t)u16(rng); c.P2 = (int16_t)s16(rng); c.P3 = (int16_t)s16(rng);
+    c.P4 = (int16_t)s16(rng); c.P5 = (int16_t)s16(rng); c.P6 = (int16_t)s16(rng);
+    c.P7 = (int16_t)s16(rng); c.P8 = (int16_t)s16(rng); c.P9 = (int16_t)s16(rng);
+    sets.push_back(c);
+  }
+
+  if (sets.empty()) {
+    fprintf(stderr, "no calibration sets\n");
+    return 2;
+  }
+
+  /* Pressure is checked at the t_fine values of an adc_T grid */
+  for (const bmx280_t &c : sets) {
+    std::vector<int32_t> grid;
+    for (int32_t adc = 0; adc < ADC_RANGE; adc += step) {
+      int32_t tFine;
+      RefTempInt32(&c, adc, &tFine);
+      grid.push_back(tFine);
+    }
+    grids.push_back(grid);
+  }
+
+  bool failed = check && !DatasheetExample();
+
+  printf("%zu calibration sets, %d temperature and %d x %zu pressure points a set, %u threads\n\n",
+    sets.size(), ADC_RANGE, ADC_RANGE, grids[0].size(), threads);
+  printf("%-34s %14s %12s %12s\n", "kernel", "checked", "mismatches", "Msamples/s");
+
+  for (unsigned i = 0; i < KERNEL_COUNT; i++) {
+    const Kernel &k = kernels[i];
+    Result r;
+
+    if (check) {
+      if (k.temp) CheckTemp(k, r, threads);
+      else CheckPress(k, r, threads);
+    }
+    r.rate = Throughput(k, threads);
+
+    printf("%-34s %14" PRIu64 " %12" PRIu64 " %12.1f\n", k.name, r.checked.load(), r.mismatches.load(), r.rate / 1e6);
+    for (const std::string &line : r.shown) printf("  %s\n", line.c_str());
+    if (r.mismatches) failed = true;
+  }
+
+  /* Temperature and pressure of a sample together */
+  for (unsigned i = 0; i < BATCH_KERNEL_COUNT; i++) {
+    const BatchKernel &k = batchKernels[i];
+    Result r;
+
+    if (k.supported && !k.supported()) {
+      printf("%-34s %14s\n", k.name, "no CPU support");
+      continue;
+    }
+    if (check) CheckBatch(k, r, threads);
+    r.rate = ThroughputBatch(k, threads);
+
+    printf("%-34s %14" PRIu64 " %12" PRIu64 " %12.1f\n", k.name, r.checked.load(), r.mismatches.load(), r.rate / 1e6);
+    for (const std::string &line : r.shown) printf("  %s\n", line.c_str());
+    if (r.mismatches) failed = true;
+  }
+
+  if (check) printf("\n%s\n", (failed) ? "FAILED" : "PASSED");
+  return (failed) ? 1 : 0;
+}
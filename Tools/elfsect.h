@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * File Name          : elfsect.h
+  * Description        : Minimal ELF32/ELF64 little-endian section reader
+  *                      for the host tools.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __ELFSECT_H
+#define __ELFSECT_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/**
+  * @brief  Reads contents of the named section.
+  * @param  path: ELF file path.
+  * @param  name: section name.
+  * @param  data: where the section contents to be placed.
+  * @retval true when the section has been found.
+  */
+inline bool ElfSection_Read(const char *path, const char *name, std::vector<uint8_t> &data) {
+  std::ifstream f(path, std::ios::binary);
+  std::vector<uint8_t> elf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+
+  if ((elf.size() < 52) || memcmp(elf.data(), "\x7f" "ELF", 4) || (elf[5] != 1)) return false;
+
+  bool is64 = (elf[4] == 2);
+  auto rd = [&](size_t off, size_t len) -> uint64_t {
+    uint64_t v = 0;
+    if (off + len > elf.size()) return 0;
+    for (size_t i = 0; i < len; i++) v |= (uint64_t)elf[off + i] << (8 * i);
+    return v;
+  };
+
+  uint64_t shoff  = is64 ? rd(0x28, 8) : rd(0x20, 4);
+  size_t shentsize = rd(is64 ? 0x3a : 0x2e, 2);
+  size_t shnum     = rd(is64 ? 0x3c : 0x30, 2);
+  size_t shstrndx  = rd(is64 ? 0x3e : 0x32, 2);
+
+  auto sect = [&](size_t idx, uint32_t &nameOff, uint64_t &off, uint64_t &size) {
+    size_t sh = shoff + (idx * shentsize);
+    nameOff = (uint32_t)rd(sh, 4);
+    off  = is64 ? rd(sh + 0x18, 8) : rd(sh + 0x10, 4);
+    size = is64 ? rd(sh + 0x20, 8) : rd(sh + 0x14, 4);
+  };
+
+  if (shstrndx >= shnum) return false;
+  uint32_t nameOff;
+  uint64_t strOff, strSize;
+  sect(shstrndx, nameOff, strOff, strSize);
+
+  for (size_t i = 0; i < shnum; i++) {
+    uint64_t off, size;
+    sect(i, nameOff, off, size);
+    if ((strOff + nameOff >= elf.size()) || (off + size > elf.size())) continue;
+    if (strcmp((const char*)&elf[strOff + nameOff], name)) continue;
+    data.assign(elf.begin() + off, elf.begin() + off + size);
+    return true;
+  }
+
+  return false;
+}
+
+#endif /* __ELFSECT_H */
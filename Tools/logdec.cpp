@@ -0,0 +1,161 @@
+/**
+  ******************************************************************************
+  * File Name          : logdec.cpp
+  * Description        : Host decoder of the deferred log frames. Format
+  *                      strings are taken from the .logstr section of
+  *                      the firmware ELF, plain text is passed through,
+  *                      SPI capture frames are skipped.
+  *
+  *                      logdec <firmware.elf> [capture.bin]
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "elfsect.h"
+#include "../Core/Inc/spi_capture.h"
+
+/* Must match Core/Inc/log.h */
+static const uint8_t LOG_SYNC      = 0xf0;
+static const uint8_t LOG_SYNC_MASK = 0xf8;
+static const uint8_t LOG_MAX_ARGS  = 6;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Formats a message like the target printf() would do it,
+  *         every argument is a 32-bit word.
+  */
+static std::string Format(const char *fmt, const uint32_t *args, unsigned nargs) {
+  std::string out;
+  unsigned argn = 0;
+  char tmp[64];
+
+  while (*fmt) {
+    if (*fmt != '%') {
+      out += *fmt++;
+      continue;
+    }
+
+    /* Copy flags, width and precision, skip length modifiers */
+    std::string spec = "%";
+    fmt++;
+    while (*fmt && strchr("-+ #0123456789.", *fmt)) spec += *fmt++;
+    while (*fmt && strchr("hlLqjzt", *fmt)) fmt++;
+
+    char conv = *fmt;
+    if (!conv) break;
+    fmt++;
+
+    if (conv == '%') {
+      out += '%';
+      continue;
+    }
+
+    uint32_t arg = (argn < nargs) ? args[argn] : 0;
+    argn++;
+
+    switch (conv) {
+      case 'd':
+      case 'i':
+        snprintf(tmp, sizeof(tmp), (spec + "l" + conv).c_str(), (long)(int32_t)arg);
+        break;
+
+      case 'u':
+      case 'x':
+      case 'X':
+      case 'o':
+        snprintf(tmp, sizeof(tmp), (spec + "l" + conv).c_str(), (unsigned long)arg);
+        break;
+
+      case 'c':
+        snprintf(tmp, sizeof(tmp), (spec + conv).c_str(), (int)(uint8_t)arg);
+        break;
+
+      case 'p':
+        snprintf(tmp, sizeof(tmp), "0x%08lx", (unsigned long)arg);
+        break;
+
+      default:
+        snprintf(tmp, sizeof(tmp), "<%%%c?>", conv);
+        break;
+    }
+    out += tmp;
+  }
+
+  return out;
+}
+
+
+
+
+
+int main(int argc, char **argv) {
+  if ((argc < 2) || (argc > 3)) {
+    fprintf(stderr, "usage: %s <firmware.elf> [capture.bin]\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> strings;
+  if (!ElfSection_Read(argv[1], ".logstr", strings)) {
+    fprintf(stderr, "%s: no .logstr section\n", argv[1]);
+    return 1;
+  }
+  strings.push_back(0);
+
+  FILE *in = (argc == 3) ? fopen(argv[2], "rb") : stdin;
+  if (!in) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  int ch;
+  while ((ch = fgetc(in)) != EOF) {
+    if ((ch & SPI_CAPTURE_SYNC_MASK) == SPI_CAPTURE_READ) {
+      uint8_t header[SPI_CAPTURE_HEADER_LEN - 1];
+      if (fread(header, 1, sizeof(header), in) != sizeof(header)) break;
+      for (unsigned i = 0; i < header[1]; i++) fgetc(in);
+      continue;
+    }
+    if ((ch & LOG_SYNC_MASK) != LOG_SYNC) {
+      if (ch != '\r') fputc(ch, stdout);
+      continue;
+    }
+
+    unsigned nargs = ch & ~LOG_SYNC_MASK;
+    uint8_t frame[2 + (LOG_MAX_ARGS * 4)];
+    size_t len = 2 + (nargs * 4);
+    if ((nargs > LOG_MAX_ARGS) || (fread(frame, 1, len, in) != len)) break;
+
+    uint16_t id = (uint16_t)(frame[0] | (frame[1] << 8));
+    uint32_t args[LOG_MAX_ARGS];
+    for (unsigned i = 0; i < nargs; i++) {
+      const uint8_t *a = &frame[2 + (i * 4)];
+      args[i] = (uint32_t)a[0] | ((uint32_t)a[1] << 8) | ((uint32_t)a[2] << 16) | ((uint32_t)a[3] << 24);
+    }
+
+    if (id >= strings.size() - 1) {
+      printf("<log id %u?>\n", id);
+      continue;
+    }
+    fputs(Format((const char*)&strings[id], args, nargs).c_str(), stdout);
+  }
+
+  if (in != stdin) fclose(in);
+  return 0;
+}
@@ -0,0 +1,38 @@
+/**
+  ******************************************************************************
+  * File Name          : records.h
+  * Description        : Typed sample records of the host tools. textparse
+  *                      writes them as a header, then records, little
+  *                      endian, samplestore keeps them in columns.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __RECORDS_H
+#define __RECORDS_H
+
+#include <cstdint>
+
+#define RECORDS_MAGIC       "SREC"
+#define RECORDS_VERSION     1
+
+/* A sample as the firmware prints it, pressure 0 when it's missing */
+struct SampleRecord {
+  int64_t   time;           // us
+  uint32_t  device;
+  int32_t   temperature;    // 0.01 DegC
+  uint32_t  pressure;       // Pa
+  uint32_t  reserved;
+};
+static_assert(sizeof(SampleRecord) == 24, "record layout");
+
+struct RecordsHeader {
+  char      magic[4];
+  uint16_t  version;
+  uint16_t  recordSize;
+};
+static_assert(sizeof(RecordsHeader) == 8, "header layout");
+
+#endif /* __RECORDS_H */
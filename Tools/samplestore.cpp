@@ -0,0 +1,814 @@
+/**
+  ******************************************************************************
+  * File Name          : samplestore.cpp
+  * Description        : Columnar store of the samples of many devices. The
+  *                      text output of the devices is ingested by the
+  *                      parser of textparse, records files of textparse
+  *                      and serialagg -o as they are. The records are cut
+  *                      into chunks
+  *                      of one device, and each chunk keeps time,
+  *                      temperature and pressure as separate columns. A
+  *                      column is coded as deltas, deltas of deltas or XOR
+  *                      with the previous value, whichever is the shortest,
+  *                      in zigzag LEB128 varints. Once a second samples take
+  *                      about 3 bytes instead of 24.
+  *
+  *                      The chunk index at the end of the file holds the
+  *                      time span, the column offsets and the count, sum,
+  *                      min and max of both values per chunk. Queries map
+  *                      the file, pick the chunks by the index and decode
+  *                      only those the range cuts, aggregates of whole
+  *                      chunks come from the index.
+  *
+  *                      samplestore ingest [-n records] [-T seconds]
+  *                                         [-D names] [-j threads]
+  *                                         store capture ..
+  *                      samplestore info store
+  *                      samplestore query [-d device] [-f seconds]
+  *                                        [-t seconds] store
+  *                      samplestore stats [-d device] [-f seconds]
+  *                                        [-t seconds] [-b seconds] store
+  *
+  *                      ingest  appends captures, the device is the file
+  *                              name without its extension. A records file
+  *                              (records.h) is taken by its header, its
+  *                              devices are named by -D, a comma separated
+  *                              list in the order of the command line that
+  *                              wrote it, or <file name>.<index>. -n sets the
+  *                              records per chunk, 4096 by default, -T adds
+  *                              an offset to the record times, e.g. the
+  *                              start of an unstamped capture. A device
+  *                              can't get records before its last stored one
+  *                      info    lists the devices and the column sizes
+  *                      query   writes the records in [-f, -t) as CSV
+  *                      stats   writes the count, min, mean and max of
+  *                              temperature and pressure per device, and
+  *                              per -b time bucket
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "records.h"
+#include "textlines.h"
+
+#define STORE_MAGIC         "SSTO"
+#define STORE_VERSION       1
+
+enum Column { COL_TIME, COL_TEMP, COL_PRESS, COLUMNS };
+
+enum Encoding : uint8_t {
+  ENC_DELTA = 1,            // Zigzag delta from the previous value
+  ENC_DELTA2,               // Zigzag delta from the previous delta
+  ENC_XOR,                  // Bits XOR the previous value
+  ENC_LAST = ENC_XOR
+};
+
+static const char *encodingNames[] = { "", "delta", "delta2", "xor" };
+static const char *columnNames[COLUMNS] = { "time", "temp", "press" };
+
+struct StoreHeader {
+  char      magic[4];
+  uint16_t  version;
+  uint16_t  reserved;
+  uint32_t  devices;        // Names follow the index, length byte and text
+  uint32_t  chunks;
+  uint64_t  indexOffset;
+};
+static_assert(sizeof(StoreHeader) == 24, "header layout");
+
+/* Index entry of a chunk, pressure 0 is missing and out of the aggregates */
+struct ChunkIndex {
+  uint32_t  device;
+  uint32_t  count;
+  int64_t   first;          // us
+  int64_t   last;
+  uint64_t  offset;         // Column data, the columns in order
+  uint32_t  size[COLUMNS];
+  uint8_t   encoding[COLUMNS];
+  uint8_t   reserved;
+  uint32_t  pressures;
+  int64_t   sumT;
+  int32_t   minT;
+  int32_t   maxT;
+  uint64_t  sumP;
+  uint32_t  minP;
+  uint32_t  maxP;
+};
+static_assert(sizeof(ChunkIndex) == 88, "index layout");
+
+/* A store as read for ingest, or mapped for queries */
+struct Store {
+  StoreHeader header = {};
+  std::vector<std::string> names;
+  const ChunkIndex *index = nullptr;
+  std::vector<ChunkIndex> ownIndex;
+  const uint8_t *data = nullptr;
+  size_t    size = 0;
+};
+
+/* Aggregates of a device or a bucket */
+struct Stats {
+  uint64_t  count = 0;
+  int64_t   sumT = 0;
+  int32_t   minT = INT32_MAX;
+  int32_t   maxT = INT32_MIN;
+  uint64_t  pressures = 0;
+  uint64_t  sumP = 0;
+  uint32_t  minP = UINT32_MAX;
+  uint32_t  maxP = 0;
+};
+
+static const int64_t TIME_MIN = INT64_MIN;
+static const int64_t TIME_MAX = INT64_MAX;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+static void PutVarint(std::vector<uint8_t> &out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back((uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((uint8_t)value);
+}
+
+static uint64_t GetVarint(const uint8_t *&p, const uint8_t *end) {
+  uint64_t value = 0;
+  for (unsigned shift = 0; (p < end) && (shift < 64); shift += 7) {
+    uint8_t byte = *p++;
+    value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) break;
+  }
+  return (value);
+}
+
+static uint64_t Zigzag(int64_t value) {
+  return (((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static int64_t Unzigzag(uint64_t value) {
+  return ((int64_t)(value >> 1) ^ -(int64_t)(value & 1));
+}
+
+
+
+
+
+/**
+  * @brief  Codes a column, the arithmetic wraps as the values are bits.
+  */
+static void Encode(const std::vector<int64_t> &values, Encoding encoding, std::vector<uint8_t> &out) {
+  uint64_t prev = 0;
+  uint64_t prevDelta = 0;
+
+  for (int64_t v : values) {
+    uint64_t value = (uint64_t)v;
+    uint64_t delta = value - prev;
+    switch (encoding) {
+      case ENC_DELTA:  PutVarint(out, Zigzag((int64_t)delta)); break;
+      case ENC_DELTA2: PutVarint(out, Zigzag((int64_t)(delta - prevDelta))); break;
+      case ENC_XOR:    PutVarint(out, value ^ prev); break;
+    }
+    prevDelta = delta;
+    prev = value;
+  }
+}
+
+static void Decode(const uint8_t *p, const uint8_t *end, Encoding encoding, uint32_t count, int64_t *values) {
+  uint64_t prev = 0;
+  uint64_t prevDelta = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint64_t code = GetVarint(p, end);
+    uint64_t value = 0;
+    switch (encoding) {
+      case ENC_DELTA:  value = prev + (uint64_t)Unzigzag(code); break;
+      case ENC_DELTA2: value = prev + prevDelta + (uint64_t)Unzigzag(code); break;
+      case ENC_XOR:    value = prev ^ code; break;
+    }
+    prevDelta = value - prev;
+    prev = value;
+    values[i] = (int64_t)value;
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Codes a column by each encoding and keeps the shortest.
+  */
+static Encoding EncodeBest(const std::vector<int64_t> &values, std::vector<uint8_t> &out) {
+  std::vector<uint8_t> best;
+  std::vector<uint8_t> coded;
+  Encoding bestEncoding = ENC_DELTA;
+
+  for (unsigned e = ENC_DELTA; e <= ENC_LAST; e++) {
+    coded.clear();
+    Encode(values, (Encoding)e, coded);
+    if ((e == ENC_DELTA) || (coded.size() < best.size())) {
+      best.swap(coded);
+      bestEncoding = (Encoding)e;
+    }
+  }
+  out.insert(out.end(), best.begin(), best.end());
+  return (bestEncoding);
+}
+
+
+
+
+
+static void Add(Stats &stats, int32_t temperature, uint32_t pressure) {
+  stats.count++;
+  stats.sumT += temperature;
+  stats.minT = std::min(stats.minT, temperature);
+  stats.maxT = std::max(stats.maxT, temperature);
+  if (pressure) {
+    stats.pressures++;
+    stats.sumP += pressure;
+    stats.minP = std::min(stats.minP, pressure);
+    stats.maxP = std::max(stats.maxP, pressure);
+  }
+}
+
+static void Add(Stats &stats, const ChunkIndex &chunk) {
+  stats.count += chunk.count;
+  stats.sumT += chunk.sumT;
+  stats.minT = std::min(stats.minT, chunk.minT);
+  stats.maxT = std::max(stats.maxT, chunk.maxT);
+  if (chunk.pressures) {
+    stats.pressures += chunk.pressures;
+    stats.sumP += chunk.sumP;
+    stats.minP = std::min(stats.minP, chunk.minP);
+    stats.maxP = std::max(stats.maxP, chunk.maxP);
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Reads the names after the index.
+  */
+static bool ReadNames(const uint8_t *p, const uint8_t *end, uint32_t count, std::vector<std::string> &names) {
+  names.clear();
+  for (uint32_t i = 0; i < count; i++) {
+    if ((p >= end) || ((size_t)(end - p) < 1u + *p)) return (false);
+    names.emplace_back((const char*)p + 1, *p);
+    p += 1 + *p;
+  }
+  return (true);
+}
+
+static bool CheckHeader(const StoreHeader &header, size_t size, const char *path) {
+  if (memcmp(header.magic, STORE_MAGIC, sizeof(header.magic)) || (header.version != STORE_VERSION)) {
+    fprintf(stderr, "%s: not a sample store\n", path);
+    return (false);
+  }
+  if ((header.indexOffset < sizeof(header)) || (header.indexOffset > size)
+      || ((size - header.indexOffset) / sizeof(ChunkIndex) < header.chunks)) {
+    fprintf(stderr, "%s: index out of the file\n", path);
+    return (false);
+  }
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Maps a store for queries, the index is used in place.
+  */
+static bool Map(const char *path, Store &store) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+
+  if ((fd < 0) || (fstat(fd, &st) < 0)) {
+    perror(path);
+    if (fd >= 0) close(fd);
+    return (false);
+  }
+  store.size = (size_t)st.st_size;
+  if (store.size < sizeof(StoreHeader)) {
+    fprintf(stderr, "%s: not a sample store\n", path);
+    close(fd);
+    return (false);
+  }
+  void *data = mmap(nullptr, store.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror(path);
+    return (false);
+  }
+  store.data = (const uint8_t*)data;
+
+  memcpy(&store.header, store.data, sizeof(store.header));
+  if (!CheckHeader(store.header, store.size, path)) return (false);
+  store.index = (const ChunkIndex*)(store.data + store.header.indexOffset);
+  const uint8_t *names = (const uint8_t*)(store.index + store.header.chunks);
+  if (!ReadNames(names, store.data + store.size, store.header.devices, store.names)) {
+    fprintf(stderr, "%s: bad device names\n", path);
+    return (false);
+  }
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Reads the header, index and names of a store to append to it.
+  * @retval false on a bad store, a missing one is empty
+  */
+static bool Load(FILE *file, const char *path, Store &store) {
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  if (size <= 0) {
+    memcpy(store.header.magic, STORE_MAGIC, sizeof(store.header.magic));
+    store.header.version = STORE_VERSION;
+    store.header.indexOffset = sizeof(StoreHeader);
+    return (true);
+  }
+
+  std::vector<uint8_t> tail;
+  rewind(file);
+  if ((size < (long)sizeof(StoreHeader)) || (fread(&store.header, sizeof(store.header), 1, file) != 1)) {
+    fprintf(stderr, "%s: not a sample store\n", path);
+    return (false);
+  }
+  if (!CheckHeader(store.header, (size_t)size, path)) return (false);
+  tail.resize((size_t)size - store.header.indexOffset);
+  fseek(file, (long)store.header.indexOffset, SEEK_SET);
+  if (fread(tail.data(), 1, tail.size(), file) != tail.size()) {
+    perror(path);
+    return (false);
+  }
+  store.ownIndex.resize(store.header.chunks);
+  memcpy(store.ownIndex.data(), tail.data(), store.ownIndex.size() * sizeof(ChunkIndex));
+  const uint8_t *names = tail.data() + store.ownIndex.size() * sizeof(ChunkIndex);
+  if (!ReadNames(names, tail.data() + tail.size(), store.header.devices, store.names)) {
+    fprintf(stderr, "%s: bad device names\n", path);
+    return (false);
+  }
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Codes the records of one device from first to last as a chunk.
+  */
+static ChunkIndex Pack(const SampleRecord *records, uint32_t count, uint64_t offset,
+                       std::vector<uint8_t> &out) {
+  ChunkIndex chunk = {};
+  std::vector<int64_t> columns[COLUMNS];
+  Stats stats;
+
+  for (uint32_t i = 0; i < count; i++) {
+    columns[COL_TIME].push_back(records[i].time);
+    columns[COL_TEMP].push_back(records[i].temperature);
+    columns[COL_PRESS].push_back(records[i].pressure);
+    Add(stats, records[i].temperature, records[i].pressure);
+  }
+
+  chunk.device = records[0].device;
+  chunk.count = count;
+  chunk.first = records[0].time;
+  chunk.last = records[count - 1].time;
+  chunk.offset = offset;
+  for (unsigned c = 0; c < COLUMNS; c++) {
+    size_t start = out.size();
+    chunk.encoding[c] = EncodeBest(columns[c], out);
+    chunk.size[c] = (uint32_t)(out.size() - start);
+  }
+  chunk.pressures = (uint32_t)stats.pressures;
+  chunk.sumT = stats.sumT;
+  chunk.minT = stats.minT;
+  chunk.maxT = stats.maxT;
+  chunk.sumP = stats.sumP;
+  chunk.minP = (stats.pressures) ? stats.minP : 0;
+  chunk.maxP = stats.maxP;
+  return (chunk);
+}
+
+
+
+
+
+/**
+  * @brief  Decodes the records of a chunk.
+  * @retval false when a column runs out of the file
+  */
+static bool Unpack(const Store &store, const ChunkIndex &chunk, std::vector<SampleRecord> &records) {
+  std::vector<int64_t> columns[COLUMNS];
+  uint64_t offset = chunk.offset;
+
+  for (unsigned c = 0; c < COLUMNS; c++) {
+    if ((offset + chunk.size[c] > store.header.indexOffset) || !chunk.encoding[c] || (chunk.encoding[c] > ENC_LAST)) {
+      return (false);
+    }
+    columns[c].resize(chunk.count);
+    const uint8_t *p = store.data + offset;
+    Decode(p, p + chunk.size[c], (Encoding)chunk.encoding[c], chunk.count, columns[c].data());
+    offset += chunk.size[c];
+  }
+
+  records.resize(chunk.count);
+  for (uint32_t i = 0; i < chunk.count; i++) {
+    records[i].time = columns[COL_TIME][i];
+    records[i].device = chunk.device;
+    records[i].temperature = (int32_t)columns[COL_TEMP][i];
+    records[i].pressure = (uint32_t)columns[COL_PRESS][i];
+    records[i].reserved = 0;
+  }
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Finds the chunks of a device that may hold the range, chunks
+  *         of a device are in time order in the index.
+  */
+static std::pair<size_t, size_t> Chunks(const Store &store, uint32_t device, int64_t from, int64_t to) {
+  const ChunkIndex *begin = store.index;
+  const ChunkIndex *end = store.index + store.header.chunks;
+
+  const ChunkIndex *first = std::lower_bound(begin, end, device,
+    [from](const ChunkIndex &c, uint32_t d) { return (c.device < d) || ((c.device == d) && (c.last < from)); });
+  const ChunkIndex *last = std::lower_bound(first, end, device,
+    [to](const ChunkIndex &c, uint32_t d) { return (c.device < d) || ((c.device == d) && (c.first < to)); });
+  return { (size_t)(first - begin), (size_t)(last - begin) };
+}
+
+static int64_t Seconds(const char *arg) {
+  return ((int64_t)llround(atof(arg) * 1e6));
+}
+
+static int64_t Floor(int64_t value, int64_t step) {
+  int64_t q = value / step;
+  if ((value % step) && (value < 0)) q--;
+  return (q * step);
+}
+
+
+
+
+
+static void Usage(void) {
+  fprintf(stderr,
+    "usage: samplestore ingest [-n records] [-T seconds] [-D names] [-j threads] store capture ..\n"
+    "       samplestore info store\n"
+    "       samplestore query [-d device] [-f seconds] [-t seconds] store\n"
+    "       samplestore stats [-d device] [-f seconds] [-t seconds] [-b seconds] store\n");
+  exit(2);
+}
+
+/**
+  * @brief  Takes the records of a records file, their device is the index
+  *         in the file, named by names or after the file.
+  * @retval false when the header doesn't fit
+  */
+static bool LoadRecords(const char *path, const TextCapture &file, const std::vector<std::string> &names,
+                        std::vector<std::string> &devices, std::vector<SampleRecord> &records) {
+  RecordsHeader header;
+
+  memcpy(&header, file.data, sizeof(header));
+  if ((header.version != RECORDS_VERSION) || (header.recordSize != sizeof(SampleRecord))
+      || ((file.size - sizeof(header)) % sizeof(SampleRecord))) {
+    fprintf(stderr, "%s: records file version %u, record size %u, not taken\n", path,
+      header.version, header.recordSize);
+    return (false);
+  }
+
+  size_t count = (file.size - sizeof(header)) / sizeof(SampleRecord);
+  size_t first = records.size();
+  std::vector<uint32_t> map;
+  records.resize(first + count);
+  memcpy(&records[first], file.data + sizeof(header), count * sizeof(SampleRecord));
+  for (size_t i = first; i < records.size(); i++) {
+    uint32_t device = records[i].device;
+    if (device >= map.size()) map.resize(device + 1, UINT32_MAX);
+    if (map[device] == UINT32_MAX) {
+      std::string name = (device < names.size()) ? names[device] : file.name + "." + std::to_string(device);
+      auto known = std::find(devices.begin(), devices.end(), name);
+      map[device] = (uint32_t)(known - devices.begin());
+      if (known == devices.end()) devices.push_back(name);
+    }
+    records[i].device = map[device];
+  }
+  return (true);
+}
+
+static int Ingest(int argc, char **argv) {
+  uint32_t chunkRecords = 4096;
+  int64_t offset = 0;
+  unsigned threads = std::thread::hardware_concurrency();
+  std::vector<std::string> names;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:T:D:j:")) != -1) {
+    switch (opt) {
+      case 'n': chunkRecords = (uint32_t)atoi(optarg); break;
+      case 'T': offset = Seconds(optarg); break;
+      case 'D':
+        for (const char *p = optarg; ; p++) {
+          const char *comma = strchr(p, ',');
+          names.push_back(std::string(p, (comma) ? (size_t)(comma - p) : strlen(p)));
+          if (!comma) break;
+          p = comma;
+        }
+      break;
+      case 'j': threads = (unsigned)atoi(optarg); break;
+      default: Usage();
+    }
+  }
+  if ((argc - optind < 2) || !chunkRecords) Usage();
+  const char *path = argv[optind];
+
+  auto start = std::chrono::steady_clock::now();
+
+  /* Records files go as they are, text captures through the parser */
+  std::vector<TextCapture> captures;
+  std::vector<TextCapture> recordFiles;
+  std::vector<std::string> recordDevices;
+  std::vector<SampleRecord> fileRecords;
+  for (int i = optind + 1; i < argc; i++) {
+    TextCapture file;
+    if (!MapCapture(argv[i], file)) return (1);
+    if ((file.size >= sizeof(RecordsHeader)) && !memcmp(file.data, RECORDS_MAGIC, 4)) {
+      if (!LoadRecords(argv[i], file, names, recordDevices, fileRecords)) return (1);
+      recordFiles.push_back(file);
+    } else {
+      captures.push_back(file);
+    }
+  }
+  std::vector<SampleRecord> records;
+  TextCounts counts;
+  if (!captures.empty()) ParseCaptures(captures, threads, 64u << 20, records, counts);
+  counts.records += fileRecords.size();
+
+  FILE *file = fopen(path, "r+b");
+  if (!file) file = fopen(path, "w+b");
+  Store store;
+  if (!file) {
+    perror(path);
+    return (1);
+  }
+  if (!Load(file, path, store)) return (1);
+
+  /* Captures of a device name go to its device in the store */
+  std::vector<uint32_t> devices;
+  for (const TextCapture &capture : captures) {
+    auto known = std::find(store.names.begin(), store.names.end(), capture.name);
+    if (capture.name.size() > 255) {
+      fprintf(stderr, "%s: device name too long\n", capture.name.c_str());
+      return (1);
+    }
+    devices.push_back((uint32_t)(known - store.names.begin()));
+    if (known == store.names.end()) store.names.push_back(capture.name);
+  }
+  for (SampleRecord &record : records) record.device = devices[record.device];
+  for (const std::string &name : recordDevices) {
+    auto known = std::find(store.names.begin(), store.names.end(), name);
+    if (name.size() > 255) {
+      fprintf(stderr, "%s: device name too long\n", name.c_str());
+      return (1);
+    }
+    devices.push_back((uint32_t)(known - store.names.begin()));
+    if (known == store.names.end()) store.names.push_back(name);
+  }
+  for (SampleRecord record : fileRecords) {
+    record.device = devices[captures.size() + record.device];
+    records.push_back(record);
+  }
+  for (SampleRecord &record : records) record.time += offset;
+  std::stable_sort(records.begin(), records.end(), [](const SampleRecord &a, const SampleRecord &b) {
+    return (a.device < b.device) || ((a.device == b.device) && (a.time < b.time)); });
+
+  std::vector<int64_t> lastTime(store.names.size(), TIME_MIN);
+  for (const ChunkIndex &chunk : store.ownIndex) lastTime[chunk.device] = std::max(lastTime[chunk.device], chunk.last);
+
+  /* New chunks overwrite the old index, which is written again after them */
+  std::vector<uint8_t> data;
+  uint64_t dataOffset = store.header.indexOffset;
+  size_t oldChunks = store.ownIndex.size();
+  for (size_t i = 0; i < records.size(); ) {
+    size_t n = 1;
+    while ((i + n < records.size()) && (records[i + n].device == records[i].device) && (n < chunkRecords)) n++;
+    if ((lastTime[records[i].device] != TIME_MIN) && (records[i].time <= lastTime[records[i].device])) {
+      fprintf(stderr, "%s: records at %.6f s and earlier are in the store already, see -T\n",
+        store.names[records[i].device].c_str(), records[i].time / 1e6);
+      return (1);
+    }
+    store.ownIndex.push_back(Pack(&records[i], (uint32_t)n, dataOffset + data.size(), data));
+    i += n;
+  }
+  std::stable_sort(store.ownIndex.begin(), store.ownIndex.end(), [](const ChunkIndex &a, const ChunkIndex &b) {
+    return (a.device < b.device) || ((a.device == b.device) && (a.first < b.first)); });
+
+  std::vector<uint8_t> tail(store.ownIndex.size() * sizeof(ChunkIndex));
+  memcpy(tail.data(), store.ownIndex.data(), tail.size());
+  for (const std::string &name : store.names) {
+    tail.push_back((uint8_t)name.size());
+    tail.insert(tail.end(), name.begin(), name.end());
+  }
+  while ((dataOffset + data.size()) % 8) data.push_back(0);
+
+  store.header.devices = (uint32_t)store.names.size();
+  store.header.chunks = (uint32_t)store.ownIndex.size();
+  store.header.indexOffset = dataOffset + data.size();
+  fseek(file, (long)dataOffset, SEEK_SET);
+  bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size())
+    && (fwrite(tail.data(), 1, tail.size(), file) == tail.size());
+  long end = ftell(file);
+  ok = ok && !fflush(file) && !ftruncate(fileno(file), end);
+  /* The header goes last, a failed write leaves the old index pointed to */
+  rewind(file);
+  ok = ok && (fwrite(&store.header, sizeof(store.header), 1, file) == 1);
+  if ((fclose(file) != 0) || !ok) {
+    perror(path);
+    return (1);
+  }
+  for (TextCapture &capture : captures) UnmapCapture(capture);
+  for (TextCapture &file : recordFiles) UnmapCapture(file);
+
+  double took = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  fprintf(stderr, "%llu records in %zu chunks, %zu bytes, %.2f bytes per record, %llu orphan pressure lines, %.3f s\n",
+    (unsigned long long)counts.records, store.ownIndex.size() - oldChunks, data.size(),
+    (records.size()) ? (double)data.size() / records.size() : 0.0,
+    (unsigned long long)counts.orphans, took);
+  return (0);
+}
+
+static int Info(int argc, char **argv) {
+  Store store;
+  if ((argc != 2) || !Map(argv[1], store)) Usage();
+
+  struct Device { uint64_t records = 0; uint32_t chunks = 0; int64_t first = TIME_MAX; int64_t last = TIME_MIN; };
+  std::vector<Device> devices(store.names.size());
+  uint64_t bytes[COLUMNS] = {};
+  uint32_t encodings[COLUMNS][ENC_LAST + 1] = {};
+  uint64_t records = 0;
+
+  for (uint32_t i = 0; i < store.header.chunks; i++) {
+    const ChunkIndex &chunk = store.index[i];
+    Device &device = devices.at(chunk.device);
+    device.records += chunk.count;
+    device.chunks++;
+    device.first = std::min(device.first, chunk.first);
+    device.last = std::max(device.last, chunk.last);
+    records += chunk.count;
+    for (unsigned c = 0; c < COLUMNS; c++) {
+      bytes[c] += chunk.size[c];
+      if (chunk.encoding[c] <= ENC_LAST) encodings[c][chunk.encoding[c]]++;
+    }
+  }
+
+  printf("%-24s %12s %8s %18s %18s\n", "device", "records", "chunks", "first s", "last s");
+  for (size_t d = 0; d < devices.size(); d++) {
+    if (!devices[d].chunks) continue;
+    printf("%-24s %12llu %8u %18.6f %18.6f\n", store.names[d].c_str(),
+      (unsigned long long)devices[d].records, devices[d].chunks, devices[d].first / 1e6, devices[d].last / 1e6);
+  }
+  printf("\n%-8s %14s %10s  %s\n", "column", "bytes", "per record", "chunks by encoding");
+  for (unsigned c = 0; c < COLUMNS; c++) {
+    printf("%-8s %14llu %10.3f ", columnNames[c], (unsigned long long)bytes[c],
+      (records) ? (double)bytes[c] / records : 0.0);
+    for (unsigned e = ENC_DELTA; e <= ENC_LAST; e++) printf(" %s %u", encodingNames[e], encodings[c][e]);
+    printf("\n");
+  }
+  printf("\n%llu records, %zu bytes file, %.3f bytes per record\n", (unsigned long long)records, store.size,
+    (records) ? (double)store.size / records : 0.0);
+  return (0);
+}
+
+static int Query(int argc, char **argv, bool stats) {
+  const char *name = nullptr;
+  int64_t from = TIME_MIN;
+  int64_t to = TIME_MAX;
+  int64_t bucket = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, (stats) ? "d:f:t:b:" : "d:f:t:")) != -1) {
+    switch (opt) {
+      case 'd': name = optarg; break;
+      case 'f': from = Seconds(optarg); break;
+      case 't': to = Seconds(optarg); break;
+      case 'b': bucket = Seconds(optarg); break;
+      default: Usage();
+    }
+  }
+  Store store;
+  if ((argc - optind != 1) || (bucket < 0) || !Map(argv[optind], store)) Usage();
+
+  std::vector<uint32_t> devices;
+  for (uint32_t d = 0; d < store.names.size(); d++) {
+    if (!name || (store.names[d] == name)) devices.push_back(d);
+  }
+  if (devices.empty()) {
+    fprintf(stderr, "%s: no such device\n", name);
+    return (1);
+  }
+
+  std::map<std::pair<uint32_t, int64_t>, Stats> buckets;
+  std::vector<SampleRecord> records;
+  uint64_t decoded = 0;
+  uint64_t indexed = 0;
+
+  if (!stats) printf("device,time_us,temp,press\n");
+  for (uint32_t device : devices) {
+    auto range = Chunks(store, device, from, to);
+    for (size_t i = range.first; i < range.second; i++) {
+      const ChunkIndex &chunk = store.index[i];
+
+      /* A whole chunk in the range and in one bucket needs no decoding */
+      if (stats && (chunk.first >= from) && (chunk.last < to)
+          && (!bucket || (Floor(chunk.first, bucket) == Floor(chunk.last, bucket)))) {
+        Add(buckets[{ device, (bucket) ? Floor(chunk.first, bucket) : 0 }], chunk);
+        indexed++;
+        continue;
+      }
+
+      if (!Unpack(store, chunk, records)) {
+        fprintf(stderr, "%s: chunk %zu is damaged\n", argv[optind], i);
+        return (1);
+      }
+      decoded++;
+      for (const SampleRecord &r : records) {
+        if ((r.time < from) || (r.time >= to)) continue;
+        if (stats) {
+          Add(buckets[{ device, (bucket) ? Floor(r.time, bucket) : 0 }], r.temperature, r.pressure);
+        } else {
+          printf("%s,%lld,%d,%u\n", store.names[device].c_str(), (long long)r.time, r.temperature, r.pressure);
+        }
+      }
+    }
+  }
+
+  if (stats) {
+    printf("device,%scount,temp_min,temp_mean,temp_max,press_count,press_min,press_mean,press_max\n",
+      (bucket) ? "bucket_s," : "");
+    for (const auto &b : buckets) {
+      const Stats &s = b.second;
+      printf("%s,", store.names[b.first.first].c_str());
+      if (bucket) printf("%.6f,", b.first.second / 1e6);
+      printf("%llu,%d,%.2f,%d,%llu,", (unsigned long long)s.count, s.minT, (double)s.sumT / s.count, s.maxT,
+        (unsigned long long)s.pressures);
+      if (s.pressures) {
+        printf("%u,%.2f,%u\n", s.minP, (double)s.sumP / s.pressures, s.maxP);
+      } else {
+        printf(",,\n");
+      }
+    }
+  }
+  fprintf(stderr, "%llu chunks decoded, %llu taken from the index\n",
+    (unsigned long long)decoded, (unsigned long long)indexed);
+  return (0);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) Usage();
+  std::string command = argv[1];
+
+  if (command == "ingest") return (Ingest(argc - 1, argv + 1));
+  if (command == "info") return (Info(argc - 1, argv + 1));
+  if (command == "query") return (Query(argc - 1, argv + 1, false));
+  if (command == "stats") return (Query(argc - 1, argv + 1, true));
+  Usage();
+  return (2);
+}
@@ -0,0 +1,620 @@
+/**
+  ******************************************************************************
+  * File Name          : serialagg.cpp
+  * Description        : Aggregator of the serial output of many devices in
+  *                      one epoll loop on one core. Every stream reads into
+  *                      its own ring, mapped twice back to back, so lines
+  *                      and frames are parsed in place even when they wrap.
+  *                      Text lines go through the parser of textparse, SPI
+  *                      capture and deferred LOG frames between lines are
+  *                      skipped. Records are handed over in batches to the
+  *                      records file and the stamped per-device logs,
+  *                      samplestore ingests either.
+  *
+  *                      serialagg [-b baud] [-o records.bin] [-l dir]
+  *                                [-n records] [-B ms] [-r seconds]
+  *                                [-t seconds] device ..
+  *                      serialagg -P units [-R samples/s] [-t seconds] ..
+  *
+  *                      -b  baud rate of tty devices, 115200 by default
+  *                      -o  appends the records to a records file, see
+  *                          records.h, the device is the argument index
+  *                      -l  appends the lines of every device with a
+  *                          "[seconds] " receive stamp to dir/<device>.log
+  *                      -n  records per batch, 4096 by default
+  *                      -B  longest time a record waits for its batch,
+  *                          100 ms by default
+  *                      -r  prints the device table every given seconds,
+  *                          only at the end by default
+  *                      -t  stops after the given seconds
+  *                      -P  opens the given number of pseudo terminals in
+  *                          place of devices and feeds them with the text
+  *                          output of the firmware from a child process,
+  *                          at -R samples per second each, 1 by default,
+  *                          for -t seconds, 10 by default
+  *
+  *                      The device table has the traffic, the records,
+  *                      ring overruns and the peak ring fill per device,
+  *                      the lag from a temperature line read to its batch
+  *                      written, and the age of the last record. The run
+  *                      ends when all streams are closed, on -t, SIGINT or
+  *                      SIGTERM.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "records.h"
+#include "textlines.h"
+#include "../Core/Inc/spi_capture.h"
+
+/* Must match Core/Inc/log.h */
+static const uint8_t LOG_SYNC      = 0xf0;
+static const uint8_t LOG_SYNC_MASK = 0xf8;
+static const uint8_t LOG_MAX_ARGS  = 6;
+
+/* Ring of a stream, a power of two of pages */
+static const size_t RING_SIZE = 64 << 10;
+
+static const uint32_t SIGNAL_EVENT = UINT32_MAX;
+
+struct Stream {
+  std::string name;
+  int       fd = -1;
+  uint8_t   *ring = nullptr;    // RING_SIZE mapped twice
+  uint64_t  head = 0;
+  uint64_t  tail = 0;
+  bool      resync = false;     // Ring dropped, skip up to the next line end
+  bool      pending = false;    // Temperature line waiting for its pressure
+  SampleRecord record = {};
+  int64_t   received = 0;
+  int       logFd = -1;
+  std::string log;              // Stamped lines of the batch
+
+  uint64_t  bytes = 0;
+  uint64_t  lines = 0;
+  uint64_t  records = 0;
+  uint64_t  orphans = 0;
+  uint64_t  frames = 0;
+  uint64_t  overruns = 0;
+  size_t    peak = 0;
+  int64_t   lastRecord = 0;
+  int64_t   lagSum = 0;
+  int64_t   lagMax = 0;
+};
+
+struct Batch {
+  std::vector<SampleRecord> records;
+  std::vector<int64_t> received;  // Temperature line read
+  int64_t   opened = 0;           // Oldest line of the batch read
+  bool      open = false;
+};
+
+static std::vector<Stream> streams;
+static Batch batch;
+static FILE *recordsFile = nullptr;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+static int64_t Now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static double CpuSeconds(void) {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6);
+}
+
+
+
+
+
+/**
+  * @brief  Maps a ring twice back to back, a read or a line that wraps is
+  *         contiguous in the second mapping.
+  */
+static uint8_t *MapRing(void) {
+  int fd = memfd_create("serialagg", 0);
+  if ((fd < 0) || (ftruncate(fd, RING_SIZE) < 0)) {
+    if (fd >= 0) close(fd);
+    return (nullptr);
+  }
+
+  uint8_t *base = (uint8_t*)mmap(nullptr, 2 * RING_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  bool ok = (base != MAP_FAILED)
+    && (mmap(base, RING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED)
+    && (mmap(base + RING_SIZE, RING_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED);
+  close(fd);
+  return ((ok) ? base : nullptr);
+}
+
+
+
+
+
+/**
+  * @brief  Sets a tty raw, no echo and no CR/LF translation.
+  */
+static bool SetRaw(int fd, uint32_t baud) {
+  static const struct { uint32_t baud; speed_t speed; } speeds[] = {
+    { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 },
+    { 115200, B115200 }, { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 },
+    { 1000000, B1000000 }, { 2000000, B2000000 }, { 3000000, B3000000 } };
+  struct termios tio;
+
+  if (tcgetattr(fd, &tio) < 0) return (false);
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  for (const auto &s : speeds) {
+    if (s.baud == baud) {
+      cfsetispeed(&tio, s.speed);
+      cfsetospeed(&tio, s.speed);
+    }
+  }
+  return (tcsetattr(fd, TCSANOW, &tio) == 0);
+}
+
+static bool Open(const char *path, const std::string &name, uint32_t baud) {
+  Stream stream;
+  stream.name = name;
+  stream.fd = open(path, O_RDONLY | O_NONBLOCK | O_NOCTTY);
+  if (stream.fd < 0) {
+    perror(path);
+    return (false);
+  }
+  if (isatty(stream.fd) && !SetRaw(stream.fd, baud)) {
+    perror(path);
+    return (false);
+  }
+  stream.ring = MapRing();
+  if (!stream.ring) {
+    perror("ring");
+    return (false);
+  }
+  streams.push_back(std::move(stream));
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Writes the batch to the records file and the device logs.
+  */
+static void Flush(int64_t now) {
+  if (recordsFile && batch.records.size()) {
+    fwrite(batch.records.data(), sizeof(SampleRecord), batch.records.size(), recordsFile);
+    fflush(recordsFile);
+  }
+  for (Stream &s : streams) {
+    if ((s.logFd >= 0) && s.log.size()) {
+      if (write(s.logFd, s.log.data(), s.log.size()) < 0) perror(s.name.c_str());
+    }
+    s.log.clear();
+  }
+
+  for (size_t i = 0; i < batch.records.size(); i++) {
+    Stream &s = streams[batch.records[i].device];
+    int64_t lag = now - batch.received[i];
+    s.lagSum += lag;
+    s.lagMax = std::max(s.lagMax, lag);
+  }
+  batch.records.clear();
+  batch.received.clear();
+  batch.open = false;
+}
+
+static void Hold(int64_t now) {
+  if (!batch.open) {
+    batch.opened = now;
+    batch.open = true;
+  }
+}
+
+static void Emit(Stream &s, uint32_t device, int64_t now) {
+  s.record.device = device;
+  batch.records.push_back(s.record);
+  batch.received.push_back(s.received);
+  Hold(now);
+  s.records++;
+  s.lastRecord = now;
+  s.pending = false;
+}
+
+
+
+
+
+/**
+  * @brief  Takes a line, with its end excluded, into the stream state.
+  */
+static void Line(Stream &s, uint32_t device, const char *begin, const char *end, int64_t now) {
+  int64_t time;
+  int64_t value = 0;
+
+  s.lines++;
+  if (s.logFd >= 0) {
+    char stamp[32];
+    const char *text = ((end > begin) && (end[-1] == '\r')) ? end - 1 : end;
+    int len = snprintf(stamp, sizeof(stamp), "[%.6f] ", now / 1e6);
+    s.log.append(stamp, (size_t)len);
+    s.log.append(begin, (size_t)(text - begin));
+    s.log += '\n';
+    Hold(now);
+  }
+
+  switch (ParseLine(begin, end, time, value)) {
+    case TextLine::Temp:
+      if (s.pending) Emit(s, device, now);
+      s.record.time = (time == TEXT_NO_TIME) ? now : time;
+      s.received = now;
+      s.record.temperature = (int32_t)value;
+      s.record.pressure = 0;
+      s.pending = true;
+      break;
+    case TextLine::Press:
+      if (s.pending) {
+        s.record.pressure = (uint32_t)value;
+        Emit(s, device, now);
+      } else {
+        s.orphans++;
+      }
+      break;
+    case TextLine::Minute:
+    case TextLine::Other:
+      break;
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Parses the complete lines and frames in the ring in place.
+  */
+static void Extract(Stream &s, uint32_t device, int64_t now) {
+  const uint8_t *start = s.ring + (s.tail & (RING_SIZE - 1));
+  const uint8_t *p = start;
+  const uint8_t *end = start + (s.head - s.tail);
+
+  while (p < end) {
+    if (s.resync) {
+      const uint8_t *eol = (const uint8_t*)memchr(p, '\n', (size_t)(end - p));
+      p = (eol) ? eol + 1 : end;
+      s.resync = !eol;
+      continue;
+    }
+
+    size_t len = 0;
+    if ((*p & SPI_CAPTURE_SYNC_MASK) == SPI_CAPTURE_READ) {
+      if ((size_t)(end - p) < SPI_CAPTURE_HEADER_LEN) break;
+      len = SPI_CAPTURE_HEADER_LEN + p[2];
+    } else if (((*p & LOG_SYNC_MASK) == LOG_SYNC) && ((*p & ~LOG_SYNC_MASK) <= LOG_MAX_ARGS)) {
+      len = 3 + 4 * (*p & ~LOG_SYNC_MASK);
+    }
+    if (len) {
+      if ((size_t)(end - p) < len) break;
+      s.frames++;
+      p += len;
+      continue;
+    }
+
+    const uint8_t *eol = (const uint8_t*)memchr(p, '\n', (size_t)(end - p));
+    if (!eol) break;
+    Line(s, device, (const char*)p, (const char*)eol, now);
+    p = eol + 1;
+  }
+  s.tail += (uint64_t)(p - start);
+}
+
+
+
+
+
+/**
+  * @brief  Reads once into the ring, a ring full of one line is dropped.
+  * @retval false when the stream is closed
+  */
+static bool Read(Stream &s, uint32_t device, int64_t now) {
+  if (s.head - s.tail == RING_SIZE) {
+    s.tail = s.head;
+    s.overruns++;
+    s.resync = true;
+  }
+
+  size_t room = RING_SIZE - (size_t)(s.head - s.tail);
+  ssize_t n = read(s.fd, s.ring + (s.head & (RING_SIZE - 1)), room);
+  if (n < 0) return ((errno == EAGAIN) || (errno == EINTR));
+  if (!n) return (false);
+
+  s.head += (uint64_t)n;
+  s.bytes += (uint64_t)n;
+  s.peak = std::max(s.peak, (size_t)(s.head - s.tail));
+  Extract(s, device, now);
+  return (true);
+}
+
+static void Close(Stream &s, int epoll) {
+  if (s.fd < 0) return;
+  epoll_ctl(epoll, EPOLL_CTL_DEL, s.fd, nullptr);
+  close(s.fd);
+  s.fd = -1;
+}
+
+
+
+
+
+static void Report(int64_t now, double elapsed, double cpu) {
+  uint64_t records = 0;
+
+  fprintf(stderr, "%-16s %10s %8s %8s %7s %6s %8s %6s %9s %9s %8s\n", "device", "bytes", "lines",
+    "records", "orphans", "frames", "overruns", "peak%", "lag ms", "max ms", "age s");
+  for (const Stream &s : streams) {
+    char age[16] = "-";
+    if (s.lastRecord) snprintf(age, sizeof(age), "%.1f", (now - s.lastRecord) / 1e6);
+    fprintf(stderr, "%-16s %10llu %8llu %8llu %7llu %6llu %8llu %6.1f %9.2f %9.2f %8s%s\n", s.name.c_str(),
+      (unsigned long long)s.bytes, (unsigned long long)s.lines, (unsigned long long)s.records,
+      (unsigned long long)s.orphans, (unsigned long long)s.frames, (unsigned long long)s.overruns,
+      100.0 * s.peak / RING_SIZE, (s.records) ? s.lagSum / 1e3 / s.records : 0.0, s.lagMax / 1e3,
+      age, (s.fd < 0) ? " closed" : "");
+    records += s.records;
+  }
+  fprintf(stderr, "%zu devices, %llu records, %.1f records/s, %.1f%% of a core\n", streams.size(),
+    (unsigned long long)records, (elapsed > 0) ? records / elapsed : 0.0,
+    (elapsed > 0) ? 100.0 * cpu / elapsed : 0.0);
+}
+
+
+
+
+
+/**
+  * @brief  Writes the sample lines of the firmware to the pseudo terminal
+  *         masters, the units are spread over the sample period.
+  */
+static void Feed(const std::vector<int> &masters, double rate, double seconds) {
+  int64_t period = (int64_t)(1e6 / rate);
+  int64_t start = Now();
+  int64_t stop = start + (int64_t)(seconds * 1e6);
+  std::vector<int64_t> due(masters.size());
+  std::vector<uint64_t> count(masters.size());
+  uint64_t fed = 0;
+
+  for (size_t i = 0; i < masters.size(); i++) due[i] = start + period * (int64_t)i / (int64_t)masters.size();
+
+  for (;;) {
+    int64_t now = Now();
+    int64_t next = stop;
+    for (size_t i = 0; i < masters.size(); i++) {
+      while ((due[i] <= now) && (due[i] < stop)) {
+        char text[96];
+        uint64_t n = count[i]++;
+        int len = snprintf(text, sizeof(text), "temp: %li\r\npress: %li\r\n%s",
+          2000L + (long)((n * 7 + i) % 900), 95000L + (long)((n * 13 + i * 3) % 9000),
+          ((n % 60) == 59) ? "A minute left.\r\n" : "");
+        if (write(masters[i], text, (size_t)len) == len) fed++;
+        due[i] += period;
+      }
+      next = std::min(next, due[i]);
+    }
+    if (now >= stop) break;
+    if (next > now) usleep((useconds_t)std::min<int64_t>(next - now, 100000));
+  }
+
+  /* The slave side hangs up with the master, give the reader its last lines */
+  usleep(300000);
+  fprintf(stderr, "fed %llu samples to %zu units in %.1f s\n", (unsigned long long)fed,
+    masters.size(), seconds);
+}
+
+
+
+
+
+static void Usage(void) {
+  fprintf(stderr,
+    "usage: serialagg [-b baud] [-o records.bin] [-l dir] [-n records] [-B ms] [-r seconds] [-t seconds] device ..\n"
+    "       serialagg -P units [-R samples/s] [-t seconds] ..\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  uint32_t baud = 115200;
+  const char *output = nullptr;
+  const char *logDir = nullptr;
+  size_t batchRecords = 4096;
+  int64_t batchTime = 100 * 1000;
+  double reportEvery = 0;
+  double seconds = 0;
+  unsigned units = 0;
+  double rate = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "b:o:l:n:B:r:t:P:R:")) != -1) {
+    switch (opt) {
+      case 'b': baud = (uint32_t)atoi(optarg); break;
+      case 'o': output = optarg; break;
+      case 'l': logDir = optarg; break;
+      case 'n': batchRecords = (size_t)atoi(optarg); break;
+      case 'B': batchTime = (int64_t)(atof(optarg) * 1000); break;
+      case 'r': reportEvery = atof(optarg); break;
+      case 't': seconds = atof(optarg); break;
+      case 'P': units = (unsigned)atoi(optarg); break;
+      case 'R': rate = atof(optarg); break;
+      default: Usage();
+    }
+  }
+  if ((units ? (optind != argc) : (optind == argc)) || !batchRecords || (rate <= 0)) Usage();
+
+  /* Pseudo terminals stand in for the devices, the slaves are set raw
+     before the feeder writes */
+  std::vector<int> masters;
+  for (unsigned i = 0; i < units; i++) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master < 0) || (grantpt(master) < 0) || (unlockpt(master) < 0)) {
+      perror("pty");
+      return (1);
+    }
+    masters.push_back(master);
+    if (!Open(ptsname(master), "pty" + std::to_string(i), baud)) return (1);
+  }
+  for (int i = optind; i < argc; i++) {
+    std::string name = argv[i];
+    size_t slash = name.find_last_of('/');
+    if (slash != std::string::npos) name.erase(0, slash + 1);
+    if (!Open(argv[i], name, baud)) return (1);
+  }
+
+  if (units) {
+    if (!seconds) seconds = 10;
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return (1);
+    }
+    if (!pid) {
+      for (Stream &s : streams) close(s.fd);
+      Feed(masters, rate, seconds);
+      _exit(0);
+    }
+    for (int master : masters) close(master);
+    /* The reader outlives the feeder by its hang up delay */
+    seconds += 1;
+  }
+
+  if (output) {
+    recordsFile = fopen(output, "ab");
+    if (!recordsFile) {
+      perror(output);
+      return (1);
+    }
+    if (!ftell(recordsFile)) {
+      RecordsHeader header = {};
+      memcpy(header.magic, RECORDS_MAGIC, sizeof(header.magic));
+      header.version = RECORDS_VERSION;
+      header.recordSize = sizeof(SampleRecord);
+      fwrite(&header, sizeof(header), 1, recordsFile);
+    }
+  }
+  if (logDir) {
+    for (Stream &s : streams) {
+      std::string path = std::string(logDir) + "/" + s.name + ".log";
+      s.logFd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+      if (s.logFd < 0) {
+        perror(path.c_str());
+        return (1);
+      }
+    }
+  }
+
+  int epoll = epoll_create1(0);
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, nullptr);
+  int sigFd = signalfd(-1, &signals, 0);
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u32 = SIGNAL_EVENT;
+  epoll_ctl(epoll, EPOLL_CTL_ADD, sigFd, &event);
+  for (uint32_t i = 0; i < streams.size(); i++) {
+    event.data.u32 = i;
+    if (epoll_ctl(epoll, EPOLL_CTL_ADD, streams[i].fd, &event) < 0) {
+      perror(streams[i].name.c_str());
+      return (1);
+    }
+  }
+
+  int64_t start = Now();
+  double cpuStart = CpuSeconds();
+  int64_t stop = (seconds > 0) ? start + (int64_t)(seconds * 1e6) : INT64_MAX;
+  int64_t nextReport = (reportEvery > 0) ? start + (int64_t)(reportEvery * 1e6) : INT64_MAX;
+  size_t active = streams.size();
+  bool quit = false;
+  std::vector<struct epoll_event> events(std::min<size_t>(streams.size() + 1, 1024));
+
+  while (active && !quit) {
+    int64_t now = Now();
+    int64_t wake = std::min(stop, nextReport);
+    if (batch.open) wake = std::min(wake, batch.opened + batchTime);
+    int timeout = (wake == INT64_MAX) ? -1 : (int)std::max<int64_t>(0, (wake - now + 999) / 1000);
+
+    int n = epoll_wait(epoll, events.data(), (int)events.size(), timeout);
+    if ((n < 0) && (errno != EINTR)) {
+      perror("epoll");
+      break;
+    }
+    now = Now();
+    for (int i = 0; i < n; i++) {
+      uint32_t id = events[i].data.u32;
+      if (id == SIGNAL_EVENT) {
+        quit = true;
+        continue;
+      }
+      Stream &s = streams[id];
+      if (!Read(s, id, now)) {
+        if (s.pending) Emit(s, id, now);
+        Close(s, epoll);
+        active--;
+      }
+    }
+
+    if (batch.open && ((batch.records.size() >= batchRecords) || (now >= batch.opened + batchTime))) Flush(now);
+    if (now >= nextReport) {
+      Report(now, (now - start) / 1e6, CpuSeconds() - cpuStart);
+      nextReport += (int64_t)(reportEvery * 1e6);
+    }
+    if (now >= stop) break;
+  }
+
+  int64_t now = Now();
+  Flush(now);
+  Report(now, (now - start) / 1e6, CpuSeconds() - cpuStart);
+  if (recordsFile) fclose(recordsFile);
+  for (Stream &s : streams) {
+    Close(s, epoll);
+    if (s.logFd >= 0) close(s.logFd);
+  }
+  if (units) wait(nullptr);
+  return (0);
+}
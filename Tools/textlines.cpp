@@ -0,0 +1,364 @@
+/**
+  ******************************************************************************
+  * File Name          : textlines.cpp
+  * Description        : Parser of the text sample output of the firmware.
+  *                      Capture files are memory mapped and cut into line
+  *                      aligned chunks, which are parsed on a thread pool.
+  *                      "temp: " and "press: " line pairs become records,
+  *                      "A minute left." lines are counted, CR LF and LF
+  *                      endings are both taken. A "[seconds] " stamp in
+  *                      front of a line, as Host/sim -s writes it, is the
+  *                      record time, records without one are a second apart
+  *                      from the file start. A temperature line without its
+  *                      pressure line is kept with pressure 0, a pressure
+  *                      line without one is counted as orphan.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "textlines.h"
+
+/* A line aligned part of a capture and what came out of it */
+struct Chunk {
+  uint32_t  device = 0;
+  const char *begin = nullptr;
+  const char *end = nullptr;
+
+  std::vector<SampleRecord> records;
+  TextCounts counts;
+  /* Pairs cut by the chunk edges, joined once all chunks are done */
+  bool      leadingPress = false;   // Pressure line before any temperature
+  uint32_t  leadingValue = 0;
+  bool      trailingTemp = false;   // Temperature line the chunk ended with
+  SampleRecord trailing = {};
+};
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Parses a decimal number that runs up to the line end.
+  * @retval false on anything else than digits after the sign
+  */
+static bool ParseValue(const char *p, const char *end, int64_t &value) {
+  bool negative = (p < end) && (*p == '-');
+  if (negative) p++;
+  if (p == end) return (false);
+
+  int64_t v = 0;
+  for (; p < end; p++) {
+    unsigned digit = (unsigned)(*p - '0');
+    if ((digit > 9) || (v > (INT64_MAX / 10))) return (false);
+    v = v * 10 + digit;
+  }
+  value = (negative) ? -v : v;
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Takes the "[seconds] " stamp off the line if there is one.
+  * @retval stamp in us or TEXT_NO_TIME
+  */
+static int64_t ParseStamp(const char *&p, const char *end) {
+  if ((p == end) || (*p != '[')) return (TEXT_NO_TIME);
+
+  const char *s = p + 1;
+  while ((s < end) && (*s == ' ')) s++;
+  int64_t sec = 0;
+  int64_t frac = 0;
+  int64_t scale = 1000000;
+  const char *digits = s;
+  for (; (s < end) && ((unsigned)(*s - '0') <= 9); s++) sec = sec * 10 + (*s - '0');
+  if (s == digits) return (TEXT_NO_TIME);
+  if ((s < end) && (*s == '.')) {
+    for (s++; (s < end) && ((unsigned)(*s - '0') <= 9); s++) {
+      if (scale > 1) {
+        scale /= 10;
+        frac += (*s - '0') * scale;
+      }
+    }
+  }
+  if ((s == end) || (*s != ']')) return (TEXT_NO_TIME);
+  s++;
+  if ((s < end) && (*s == ' ')) s++;
+  p = s;
+  return (sec * 1000000 + frac);
+}
+
+
+
+
+
+/**
+  * @brief  Tells a line apart, the line end is excluded, a CR before it is
+  *         taken off. time is the stamp or TEXT_NO_TIME, value is the number
+  *         of a sample line.
+  */
+TextLine ParseLine(const char *p, const char *end, int64_t &time, int64_t &value) {
+  if ((end > p) && (end[-1] == '\r')) end--;
+  time = ParseStamp(p, end);
+  size_t len = (size_t)(end - p);
+
+  if ((len > 6) && !memcmp(p, "temp: ", 6)) {
+    if (ParseValue(p + 6, end, value) && (value >= INT32_MIN) && (value <= INT32_MAX)) return (TextLine::Temp);
+  } else if ((len > 7) && !memcmp(p, "press: ", 7)) {
+    if (ParseValue(p + 7, end, value) && (value >= 0) && (value <= UINT32_MAX)) return (TextLine::Press);
+  } else if ((len == 14) && !memcmp(p, "A minute left.", 14)) {
+    return (TextLine::Minute);
+  }
+  return (TextLine::Other);
+}
+
+
+
+
+
+/**
+  * @brief  Parses the lines of a chunk into its records.
+  */
+static void Parse(Chunk &chunk) {
+  const char *p = chunk.begin;
+  bool pending = false;     // Temperature line waiting for its pressure
+  bool seen = false;        // Any sample line so far
+  SampleRecord record = {};
+
+  record.device = chunk.device;
+  chunk.records.reserve((size_t)(chunk.end - chunk.begin) / 24);
+
+  while (p < chunk.end) {
+    const char *eol = (const char*)memchr(p, '\n', (size_t)(chunk.end - p));
+    const char *next = (eol) ? eol + 1 : chunk.end;
+    if (!eol) eol = chunk.end;
+    chunk.counts.lines++;
+
+    int64_t time;
+    int64_t value = 0;
+    switch (ParseLine(p, eol, time, value)) {
+      case TextLine::Temp:
+        if (pending) chunk.records.push_back(record);
+        record.time = time;
+        record.temperature = (int32_t)value;
+        record.pressure = 0;
+        pending = true;
+        seen = true;
+        break;
+      case TextLine::Press:
+        if (pending) {
+          record.pressure = (uint32_t)value;
+          chunk.records.push_back(record);
+          pending = false;
+        } else if (!seen) {
+          chunk.leadingPress = true;
+          chunk.leadingValue = (uint32_t)value;
+        } else {
+          chunk.counts.orphans++;
+        }
+        seen = true;
+        break;
+      case TextLine::Minute:
+        chunk.counts.minutes++;
+        break;
+      case TextLine::Other:
+        chunk.counts.other++;
+        break;
+    }
+    p = next;
+  }
+
+  if (pending) {
+    chunk.trailingTemp = true;
+    chunk.trailing = record;
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Maps a capture file, an empty one gets no mapping.
+  */
+bool MapCapture(const char *path, TextCapture &capture) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+
+  if ((fd < 0) || (fstat(fd, &st) < 0)) {
+    perror(path);
+    if (fd >= 0) close(fd);
+    return (false);
+  }
+
+  capture.size = (size_t)st.st_size;
+  if (capture.size) {
+    void *data = mmap(nullptr, capture.size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    if (data == MAP_FAILED) {
+      perror(path);
+      close(fd);
+      return (false);
+    }
+    madvise(data, capture.size, MADV_SEQUENTIAL);
+    capture.data = (const char*)data;
+  }
+  close(fd);
+
+  std::string name = path;
+  size_t slash = name.find_last_of('/');
+  if (slash != std::string::npos) name.erase(0, slash + 1);
+  size_t dot = name.find_last_of('.');
+  if ((dot != std::string::npos) && dot) name.erase(dot);
+  capture.name = name;
+  return (true);
+}
+
+
+
+
+
+/**
+  * @brief  Cuts a capture into chunks of about the given size, at line ends.
+  */
+static void Split(const TextCapture &capture, uint32_t device, size_t chunkSize, std::vector<Chunk> &chunks) {
+  const char *p = capture.data;
+  const char *end = capture.data + capture.size;
+
+  while (p < end) {
+    const char *cut = ((size_t)(end - p) > chunkSize) ? p + chunkSize : end;
+    if (cut < end) {
+      const char *eol = (const char*)memchr(cut, '\n', (size_t)(end - cut));
+      cut = (eol) ? eol + 1 : end;
+    }
+    Chunk chunk;
+    chunk.device = device;
+    chunk.begin = p;
+    chunk.end = cut;
+    chunks.push_back(std::move(chunk));
+    p = cut;
+  }
+}
+
+
+
+
+
+/**
+  * @brief  Joins the pairs cut by chunk edges and puts the records of a
+  *         device in order, unstamped ones get their ordinal second.
+  */
+static void Merge(std::vector<Chunk> &chunks, size_t first, size_t last,
+                  std::vector<SampleRecord> &out, TextCounts &counts) {
+  bool carry = false;
+  SampleRecord carried = {};
+  int64_t ordinal = 0;
+
+  auto Put = [&](SampleRecord record) {
+    if (record.time == TEXT_NO_TIME) record.time = ordinal * 1000000;
+    ordinal++;
+    out.push_back(record);
+    counts.records++;
+  };
+
+  for (size_t i = first; i < last; i++) {
+    Chunk &chunk = chunks[i];
+
+    if (chunk.leadingPress) {
+      if (carry) {
+        carried.pressure = chunk.leadingValue;
+        Put(carried);
+        carry = false;
+      } else {
+        counts.orphans++;
+      }
+    } else if (carry && (chunk.records.size() || chunk.trailingTemp)) {
+      /* The next sample line is a temperature, the carried one stays alone */
+      Put(carried);
+      carry = false;
+    }
+
+    for (const SampleRecord &record : chunk.records) Put(record);
+    counts.lines += chunk.counts.lines;
+    counts.orphans += chunk.counts.orphans;
+    counts.minutes += chunk.counts.minutes;
+    counts.other += chunk.counts.other;
+
+    if (chunk.trailingTemp) {
+      if (carry) Put(carried);
+      carried = chunk.trailing;
+      carry = true;
+    }
+    std::vector<SampleRecord>().swap(chunk.records);
+  }
+  if (carry) Put(carried);
+}
+
+
+
+
+
+void UnmapCapture(TextCapture &capture) {
+  if (capture.data) munmap((void*)capture.data, capture.size);
+  capture.data = nullptr;
+  capture.size = 0;
+}
+
+
+
+
+
+/**
+  * @brief  Parses the captures on a pool of threads, the device of a record
+  *         is the index of its capture.
+  * @param  threads: threads to run, it's cut down to the chunk count
+  * @retval number of chunks
+  */
+size_t ParseCaptures(const std::vector<TextCapture> &captures, unsigned &threads, size_t chunkSize,
+                     std::vector<SampleRecord> &records, TextCounts &counts) {
+  std::vector<Chunk> chunks;
+  std::vector<size_t> firstChunk;
+
+  for (size_t i = 0; i < captures.size(); i++) {
+    firstChunk.push_back(chunks.size());
+    Split(captures[i], (uint32_t)i, chunkSize, chunks);
+  }
+  firstChunk.push_back(chunks.size());
+
+  /* Chunks are taken by the threads as they get free */
+  std::atomic<size_t> nextChunk(0);
+  auto Worker = [&]() {
+    for (size_t i; (i = nextChunk.fetch_add(1)) < chunks.size(); ) Parse(chunks[i]);
+  };
+  std::vector<std::thread> pool;
+  if (!threads) threads = 1;
+  if (threads > chunks.size()) threads = (chunks.size()) ? chunks.size() : 1;
+  for (unsigned t = 1; t < threads; t++) pool.emplace_back(Worker);
+  Worker();
+  for (std::thread &thread : pool) thread.join();
+
+  size_t expected = records.size();
+  for (const Chunk &chunk : chunks) expected += chunk.records.size() + 1;
+  records.reserve(expected);
+  for (size_t i = 0; i < captures.size(); i++) {
+    Merge(chunks, firstChunk[i], firstChunk[i + 1], records, counts);
+  }
+  return (chunks.size());
+}
@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * File Name          : textlines.h
+  * Description        : Parser of the text sample output of the firmware,
+  *                      shared by textparse, samplestore
+  *                      and serialagg.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#ifndef __TEXTLINES_H
+#define __TEXTLINES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "records.h"
+
+/* Line without a stamp, records get the ordinal second then */
+static const int64_t TEXT_NO_TIME = INT64_MIN;
+
+enum class TextLine { Temp, Press, Minute, Other };
+
+/* A mapped capture file, the name is the file name without its extension */
+struct TextCapture {
+  std::string   name;
+  const char    *data = nullptr;
+  size_t        size = 0;
+};
+
+struct TextCounts {
+  uint64_t  lines = 0;
+  uint64_t  records = 0;
+  uint64_t  orphans = 0;
+  uint64_t  minutes = 0;
+  uint64_t  other = 0;
+};
+
+TextLine ParseLine(const char *begin, const char *end, int64_t &time, int64_t &value);
+bool MapCapture(const char *path, TextCapture &capture);
+void UnmapCapture(TextCapture &capture);
+size_t ParseCaptures(const std::vector<TextCapture> &captures, unsigned &threads, size_t chunkSize,
+                     std::vector<SampleRecord> &records, TextCounts &counts);
+
+#endif /* __TEXTLINES_H */
@@ -0,0 +1,108 @@
+/**
+  ******************************************************************************
+  * File Name          : textparse.cpp
+  * Description        : Parser of the text sample output of many devices,
+  *                      a capture file per device, into typed records
+  *                      (records.h). The files are parsed on all cores by
+  *                      textlines.cpp.
+  *
+  *                      textparse [-o records.bin] [-c] [-j threads]
+  *                                [-C chunk MB] capture ..
+  *
+  *                      -o  writes the records in binary, see records.h,
+  *                          the device is the file index on the command line
+  *                      -c  writes the records as CSV to stdout
+  *                      -j  parser threads, all cores by default
+  *                      -C  chunk size in MB, 64 by default
+  *
+  *                      A summary goes to stderr.
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+#include "textlines.h"
+
+static void Usage(void) {
+  fprintf(stderr, "usage: textparse [-o records.bin] [-c] [-j threads] [-C chunk MB] capture ..\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *output = nullptr;
+  bool csv = false;
+  unsigned threads = std::thread::hardware_concurrency();
+  size_t chunkSize = 64u << 20;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "o:cj:C:")) != -1) {
+    switch (opt) {
+      case 'o': output = optarg; break;
+      case 'c': csv = true; break;
+      case 'j': threads = (unsigned)atoi(optarg); break;
+      case 'C': chunkSize = (size_t)(atof(optarg) * (1 << 20)); break;
+      default: Usage();
+    }
+  }
+  if ((optind == argc) || !chunkSize) Usage();
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<TextCapture> captures(argc - optind);
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < captures.size(); i++) {
+    if (!MapCapture(argv[optind + i], captures[i])) return (1);
+    bytes += captures[i].size;
+  }
+
+  std::vector<SampleRecord> records;
+  TextCounts counts;
+  size_t chunks = ParseCaptures(captures, threads, chunkSize, records, counts);
+
+  double parsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (output) {
+    FILE *out = fopen(output, "wb");
+    if (!out) {
+      perror(output);
+      return (1);
+    }
+    RecordsHeader header = {};
+    memcpy(header.magic, RECORDS_MAGIC, sizeof(header.magic));
+    header.version = RECORDS_VERSION;
+    header.recordSize = sizeof(SampleRecord);
+    bool ok = (fwrite(&header, sizeof(header), 1, out) == 1)
+      && (fwrite(records.data(), sizeof(SampleRecord), records.size(), out) == records.size());
+    if ((fclose(out) != 0) || !ok) {
+      perror(output);
+      return (1);
+    }
+  }
+
+  if (csv) {
+    printf("device,time_us,temp,press\n");
+    for (const SampleRecord &r : records) {
+      printf("%s,%lld,%d,%u\n", captures[r.device].name.c_str(), (long long)r.time,
+        r.temperature, r.pressure);
+    }
+  }
+
+  fprintf(stderr, "%zu files, %llu bytes, %zu chunks, %u threads\n", captures.size(),
+    (unsigned long long)bytes, chunks, threads);
+  fprintf(stderr, "%llu lines: %llu records, %llu orphan pressure lines, %llu minute lines, %llu other\n",
+    (unsigned long long)counts.lines, (unsigned long long)counts.records,
+    (unsigned long long)counts.orphans, (unsigned long long)counts.minutes,
+    (unsigned long long)counts.other);
+  fprintf(stderr, "parsed in %.3f s, %.2f GB/s\n", parsed, (parsed > 0) ? bytes / parsed / 1e9 : 0.0);
+
+  for (TextCapture &capture : captures) UnmapCapture(capture);
+  return (0);
+}
@@ -0,0 +1,179 @@
+/**
+  ******************************************************************************
+  * File Name          : tracejson.cpp
+  * Description        : Host converter of the binary trace dumps into
+  *                      Chrome trace JSON, it opens in Perfetto UI or
+  *                      chrome://tracing. Dumps are searched in a raw
+  *                      capture, the text around them is skipped. The
+  *                      32-bit microsecond timestamps are unwrapped.
+  *
+  *                      tracejson [capture.bin] > trace.json
+  ******************************************************************************
+  * @attention
+  *
+  ******************************************************************************
+  */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../Core/Inc/trace_events.h"
+
+/* Longest dump accepted, the target ring is much shorter */
+static const unsigned TRACE_MAX_RECORDS = 4096;
+static const unsigned TRACE_RECORD_LEN  = 8;
+
+struct EventInfo {
+  const char *name;
+  const char *track;
+  char        phase;
+};
+
+#define TRACE_INFO(id, name, track, phase)   { name, track, phase },
+static const EventInfo events[TRACE_EVENT_COUNT] = {
+  TRACE_EVENTS(TRACE_INFO)
+};
+#undef TRACE_INFO
+
+static std::vector<std::string> tracks;
+
+
+
+
+
+
+
+
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+  * @brief  Returns the thread id of a track, tracks are numbered as met.
+  */
+static unsigned Track(const char *name) {
+  for (unsigned i = 0; i < tracks.size(); i++) {
+    if (tracks[i] == name) return i + 1;
+  }
+  tracks.push_back(name);
+  return tracks.size();
+}
+
+
+
+
+
+/**
+  * @brief  Writes a record as a JSON trace event.
+  */
+static void Emit(const uint8_t *rec, uint64_t ts, bool &first) {
+  uint8_t event = rec[4];
+  uint8_t arg = rec[5];
+  uint16_t value = (uint16_t)(rec[6] | (rec[7] << 8));
+  char name[32];
+  char args[64];
+
+  if (event >= TRACE_EVENT_COUNT) {
+    fprintf(stderr, "unknown event %u at %llu us\n", event, (unsigned long long)ts);
+    return;
+  }
+  const EventInfo &info = events[event];
+
+  switch (event) {
+    case TRACE_SPI_BEGIN:
+      snprintf(name, sizeof(name), "%s", info.name);
+      snprintf(args, sizeof(args), "{\"len\":%u,\"cmd\":\"0x%02x\"}", arg, value & 0xff);
+      break;
+
+    case TRACE_UART_QUEUED:
+      snprintf(name, sizeof(name), "%s", info.name);
+      snprintf(args, sizeof(args), "{\"len\":%u}", value);
+      break;
+
+    case TRACE_TASK_BEGIN:
+    case TRACE_TASK_END:
+      snprintf(name, sizeof(name), "%s %u", info.name, arg);
+      snprintf(args, sizeof(args), "{\"prio\":%u}", value);
+      break;
+
+    default:
+      snprintf(name, sizeof(name), "%s", info.name);
+      snprintf(args, sizeof(args), "{}");
+      break;
+  }
+
+  printf("%s\n  {\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",%s\"ts\":%llu,\"pid\":1,\"tid\":%u,\"args\":%s}",
+    first ? "" : ",", name, info.track, info.phase, (info.phase == 'i') ? "\"s\":\"t\"," : "",
+    (unsigned long long)ts, Track(info.track), args);
+  first = false;
+}
+
+
+
+
+
+int main(int argc, char **argv) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [capture.bin]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *in = (argc == 2) ? fopen(argv[1], "rb") : stdin;
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+    data.insert(data.end(), chunk, chunk + got);
+  }
+  if (in != stdin) fclose(in);
+
+  bool first = true;
+  unsigned dumps = 0;
+  uint32_t last = 0;
+  uint64_t epoch = 0;
+
+  printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  for (size_t pos = 0; pos + TRACE_HEADER_LEN <= data.size(); pos++) {
+    const uint8_t *hdr = &data[pos];
+    if (memcmp(hdr, TRACE_MAGIC, 3) || (hdr[3] != TRACE_VERSION)) continue;
+
+    unsigned count = hdr[4] | (hdr[5] << 8);
+    unsigned lost = hdr[6] | (hdr[7] << 8);
+    size_t len = TRACE_HEADER_LEN + (size_t)count * TRACE_RECORD_LEN;
+    if ((count > TRACE_MAX_RECORDS) || (pos + len > data.size())) continue;
+
+    if (lost) fprintf(stderr, "dump %u: %u records overwritten\n", dumps, lost);
+
+    for (unsigned i = 0; i < count; i++) {
+      const uint8_t *rec = &data[pos + TRACE_HEADER_LEN + (i * TRACE_RECORD_LEN)];
+      uint32_t time = (uint32_t)rec[0] | ((uint32_t)rec[1] << 8) | ((uint32_t)rec[2] << 16) | ((uint32_t)rec[3] << 24);
+
+      /* Unwrap, a small step forward over the 32-bit range is a wrap */
+      if ((time < last) && ((int32_t)(time - last) >= 0)) epoch += 0x100000000ULL;
+      last = time;
+
+      Emit(rec, epoch + time, first);
+    }
+
+    dumps++;
+    pos += len - 1;
+  }
+
+  for (unsigned i = 0; i < tracks.size(); i++) {
+    printf("%s\n  {\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+      first ? "" : ",", i + 1, tracks[i].c_str());
+    first = false;
+  }
+  printf("\n]}\n");
+
+  fprintf(stderr, "%u dumps\n", dumps);
+  return (dumps) ? 0 : 1;
+}